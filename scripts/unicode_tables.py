@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# Generates src/base/UnicodeTables.h from the Unicode Character Database that ships with Python.
+#
+#   python3 scripts/unicode_tables.py > src/base/UnicodeTables.h
+
+import sys
+import unicodedata as ud
+
+LIMIT = 0x110000
+
+
+def scalar(c):
+    return not 0xD800 <= c < 0xE000
+
+
+def single(s):
+    return ord(s) if len(s) == 1 else None
+
+
+def fold(c):
+    # Simple case folding: the full folding where it is one code point, and the lowercase otherwise.
+    s = chr(c)
+    f = single(s.casefold())
+    return f if f is not None else single(s.lower())
+
+
+def upper(c):
+    return single(chr(c).upper())
+
+
+def case_ranges(mapping):
+    """Compresses a code point mapping into (first, last, delta, stride) runs."""
+    items = [(c, mapping(c) - c) for c in range(LIMIT) if scalar(c) and mapping(c) not in (None, c)]
+    runs = []
+    i = 0
+
+    while i < len(items):
+        c, delta = items[i]
+        dense = sparse = i
+        while dense + 1 < len(items) and items[dense + 1] == (items[dense][0] + 1, delta):
+            dense += 1
+        while sparse + 1 < len(items) and items[sparse + 1] == (items[sparse][0] + 2, delta):
+            sparse += 1
+
+        if dense >= sparse:
+            runs.append((c, items[dense][0], delta, 1))
+            i = dense + 1
+        else:
+            runs.append((c, items[sparse][0], delta, 2))
+            i = sparse + 1
+
+    return runs
+
+
+def property_ranges(value):
+    """Compresses a code point property into (first, last, value) runs of nonzero values."""
+    runs = []
+    for c in range(LIMIT):
+        v = value(c)
+        if not v:
+            continue
+        if runs and runs[-1][1] == c - 1 and runs[-1][2] == v:
+            runs[-1][1] = c
+        else:
+            runs.append([c, c, v])
+
+    return runs
+
+
+def decompositions():
+    table = []
+    for c in range(LIMIT):
+        if 0xAC00 <= c < 0xD7A4:
+            continue  # Hangul syllables decompose algorithmically
+        d = ud.decomposition(chr(c))
+        if not d or d.startswith('<'):
+            continue
+
+        parts = [int(x, 16) for x in d.split()]
+        second = parts[1] if len(parts) == 2 else 0
+        composes = second != 0 and ud.normalize('NFC', chr(parts[0]) + chr(second)) == chr(c)
+        table.append((c, parts[0], second, composes))
+
+    return table
+
+
+def extends(c):
+    # Grapheme_Extend and SpacingMark, approximately: marks, joiners, emoji modifiers, tags and conjoining jamo.
+    return int(
+        ud.category(chr(c)) in ('Mn', 'Me', 'Mc')
+        or c in (0x200C, 0x200D)
+        or 0x1F3FB <= c <= 0x1F3FF
+        or 0xE0020 <= c <= 0xE007F
+        or 0x1160 <= c <= 0x11FF)
+
+
+def rows(entries, per_line):
+    lines = []
+    for i in range(0, len(entries), per_line):
+        lines.append('  ' + ' '.join(e + ',' for e in entries[i:i + per_line]))
+    return '\n'.join(lines)
+
+
+def main():
+    out = sys.stdout
+    folds = case_ranges(fold)
+    uppers = case_ranges(upper)
+    decomposed = decompositions()
+    classes = property_ranges(lambda c: ud.combining(chr(c)))
+    extending = property_ranges(extends)
+
+    case = lambda r: '{0x%04X, 0x%04X, %d, %d}' % r
+
+    out.write(f'''
+#ifndef PQ_UNICODE_TABLES_H_
+#define PQ_UNICODE_TABLES_H_
+
+// Generated by scripts/unicode_tables.py from the Unicode Character Database {ud.unidata_version}. Do not edit.
+
+#include <cstdint>
+
+/**
+ *  Code points first to last, every stride-th of them, map to themselves plus delta.
+ */ 
+struct CaseRange
+{{
+  char32_t first;
+  char32_t last;
+  int32_t  delta;
+  uint8_t  stride;
+}};
+
+/**
+ *  Code points first to last share a value.
+ */ 
+struct PropertyRange
+{{
+  char32_t first;
+  char32_t last;
+  uint8_t  value;
+}};
+
+/**
+ *  The canonical decomposition of a code point into one or two others, and whether NFC composes them back.
+ */ 
+struct Decomposition
+{{
+  char32_t composite;
+  char32_t first;
+  char32_t second;
+  bool     composes;
+}};
+
+/**
+ *  Simple case folding, by first code point.
+ */ 
+constexpr CaseRange case_folding[] =
+{{
+{rows([case(r) for r in folds], 4)}
+}};
+
+/**
+ *  Simple uppercase mapping, by first code point.
+ */ 
+constexpr CaseRange uppercase[] =
+{{
+{rows([case(r) for r in uppers], 4)}
+}};
+
+/**
+ *  Canonical decompositions, by composite, other than those of Hangul syllables.
+ */ 
+constexpr Decomposition canonical_decompositions[] =
+{{
+{rows(['{0x%04X, 0x%04X, 0x%04X, %d}' % d for d in decomposed], 4)}
+}};
+
+/**
+ *  Nonzero canonical combining classes, by first code point.
+ */ 
+constexpr PropertyRange combining_classes[] =
+{{
+{rows(['{0x%04X, 0x%04X, %d}' % tuple(r) for r in classes], 5)}
+}};
+
+/**
+ *  Code points that extend the grapheme cluster before them, by first code point.
+ */ 
+constexpr PropertyRange grapheme_extenders[] =
+{{
+{rows(['{0x%04X, 0x%04X, 1}' % tuple(r[:2]) for r in extending], 5)}
+}};
+
+#endif
+''')
+
+
+if __name__ == '__main__':
+    main()
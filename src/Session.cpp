@@ -0,0 +1,1785 @@
+
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include <unistd.h>
+
+#include <Analysis.h>
+#include <Bitmap.h>
+#include <Category.h>
+#include <Corpus.h>
+#include <DefinedRule.h>
+#include <Dictionary.h>
+#include <Error.h>
+#include <Executor.h>
+#include <GuessBatch.h>
+#include <Job.h>
+#include <Logging.h>
+#include <Memory.h>
+#include <RuleCache.h>
+#include <RuleDiff.h>
+#include <Tournament.h>
+#include <Watchdog.h>
+
+#include "Session.h"
+
+namespace
+{
+  constexpr const char * prompt = "=> \033[1;3m";
+
+  constexpr inline uint32_t hash(const char* data, const size_t size) noexcept
+  {
+      uint32_t hash = 5381;
+
+      for(const char *c = data; c < data + size; ++c)
+          hash = ((hash << 5) + hash) + (unsigned char) *c;
+
+      return hash;
+  }
+
+  constexpr inline unsigned int operator "" _(const char * p, size_t s)
+  {
+    return hash(p, s);
+  }
+
+  uint32_t hash(const std::string & s) noexcept
+  {
+      uint32_t hash = 5381;
+
+      for(char c : s)
+          hash = ((hash << 5) + hash) + c;
+
+      return hash;
+  }
+
+  void cmd_analyze(const Rule & rule, const History & history, std::ostream & out)
+  {
+    if (Watchdog::instance().quarantined(rule))
+    {
+      U_LOGE("'", rule.name(), "' is quarantined for overrunning its budget; use `release ", rule.name(), "` first.");
+      return;
+    }
+
+    Analysis analysis {Analysis::Settings {.seed = history.seed()}};
+    if (! analysis.run(rule, history))
+    {
+      U_LOGE("Stopped analyzing '", rule.name(), "', which was quarantined for overrunning its budget.");
+      return;
+    }
+
+    analysis.format(out) << std::endl;
+  }
+
+  void cmd_budget(const std::vector<std::string> & cmdline)
+  {
+    Watchdog & watchdog = Watchdog::instance();
+
+    try
+    {
+      if (cmdline.size() > 1) watchdog.budget(std::chrono::microseconds {(int64_t) (std::stod(cmdline[1]) * 1000)});
+      if (cmdline.size() > 2) watchdog.strikes(std::stoul(cmdline[2]));
+    }
+    catch (std::exception & e)
+    {
+      U_LOGI("Usage: budget [ms] [strikes]");
+      return;
+    }
+
+    if (watchdog.budget().count() == 0)
+    {
+      U_LOGI("The watchdog is off; rule calls run without a budget.");
+    }
+    else
+    {
+      U_LOGI(
+          "Each rule call has ", watchdog.budget().count() / 1000.0, " ms; rules are quarantined after ",
+          watchdog.strikes(), watchdog.strikes() == 1 ? " overrun." : " overruns.");
+    }
+  }
+
+  void cmd_categories(const std::vector<std::string> & cmdline)
+  {
+    const Dictionary & dictionary = Dictionary::instance();
+    const CategoryIndex & index = dictionary.category_index();
+
+    if (cmdline.size() > 2)
+    {
+      U_LOGI("Usage: categories [name]");
+      return;
+    }
+
+    if (index.categories().empty())
+    {
+      U_LOGI("There are no word categories; add files such as 'colors.txt', one word per line, to '",
+          index.directory().empty() ? "categories" : index.directory(), "'.");
+      return;
+    }
+
+    if (cmdline.size() == 1)
+    {
+      U_LOGI("Word categories in '", index.directory(), "':");
+      std::cout
+        << std::setw(16) << std::left << "NAME:" << " | "
+        << std::setw(8) << std::right << "WORDS" << " | "
+        << std::setw(8) << "UNKNOWN" << " | "
+        << std::setw(8) << "BYTES"
+        << "\n";
+
+      for (const auto & [name, category] : index.categories())
+      {
+        std::cout
+          << std::setw(16) << std::left << name << " | "
+          << std::setw(8) << std::right << category.words.count() << " | "
+          << std::setw(8) << category.unknown << " | "
+          << std::setw(8) << category.words.bytes()
+          << "\n";
+      }
+
+      std::cout << std::endl;
+      return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const WordSet * words = index.resolve(cmdline[1]);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (! words)
+    {
+      U_LOGE("Unknown word category in '", cmdline[1], "'.");
+      return;
+    }
+
+    std::vector<uint32_t> ids = words->ids();
+    U_LOGI(
+        "'", cmdline[1], "' holds ", ids.size(), " words in ", words->bytes(), " bytes (resolved in ",
+        std::fixed, std::setprecision(2), ms, " ms):");
+
+    for (size_t i = 0; i < std::min<size_t>(ids.size(), 20); i++)
+    {
+      std::cout << "  " << dictionary.word(ids[i]) << "\n";
+    }
+
+    if (ids.size() > 20) std::cout << "  ...\n";
+    std::cout << std::endl;
+  }
+
+  void cmd_clear()
+  {
+    std::cout << "\033[2J\033[1;1H";
+  }
+
+  void cmd_diff(const std::map<std::string, const Rule *> & table, const std::vector<std::string> & cmdline, uint64_t seed,
+      std::ostream & out)
+  {
+    if (cmdline.size() != 3)
+    {
+      U_LOGI("Usage: diff <rule> <rule>");
+      return;
+    }
+
+    const Rule * rules[2] {};
+    for (int side = 0; side < 2; side++)
+    {
+      auto it = table.find(cmdline[1 + side]);
+      if (it == table.end())
+      {
+        U_LOGE("Unknown rule '", cmdline[1 + side], "'.");
+        return;
+      }
+
+      rules[side] = it->second;
+      if (Watchdog::instance().quarantined(* rules[side]))
+      {
+        U_LOGE("'", rules[side]->name(), "' is quarantined for overrunning its budget; use `release ",
+            rules[side]->name(), "` first.");
+        return;
+      }
+    }
+
+    RuleDiff diff {RuleDiff::Settings {.seed = seed}};
+    if (! diff.run(* rules[0], * rules[1]))
+    {
+      U_LOGE("Stopped comparing, since a rule was quarantined for overrunning its budget.");
+      return;
+    }
+
+    diff.format(out) << std::endl;
+  }
+
+  void cmd_help()
+  {
+    std::string helptext =
+      "analyze [rule]"
+      "\n\tbreaks down what a rule (by default the active one) accepts over the dictionary by word features"
+      "\n"
+      "\nbranch  [name]"
+      "\n\taliases: 'b'"
+      "\n\tforks the game at this point into a new branch, or lists the branches"
+      "\n"
+      "\nbudget  [ms] [strikes]"
+      "\n\tshows or sets the time budget of each rule call (0 turns it off) and the overruns before quarantine"
+      "\n"
+      "\ncancel  [job]"
+      "\n\tasks a background job (by default every one) to stop"
+      "\n"
+      "\ncategories [name]"
+      "\n\tlists the word categories, or the words of one; names combine with '|', '&' and '-', as in 'colors|animals'"
+      "\n"
+      "\ncheckout <branch>"
+      "\n\taliases: 'co'"
+      "\n\tswitches to the given branch, keeping this one as it is"
+      "\n"
+      "\nclear"
+      "\n\taliases: 'cls'"
+      "\n\tclears the screen"
+      "\n"
+      "\ndefine  <name> <expression>"
+      "\n\tdefines a rule from an expression over the word and the history, e.g. 'sum_a1z26(word) % 7 == len(last)'"
+      "\n"
+      "\ndescription"
+      "\n\taliases: 'd', 'desc'"
+      "\n\texplains the active rule"
+      "\n"
+      "\ndiff    <rule> <rule>"
+      "\n\tcompares two rules over the dictionary and sampled histories, and shows the shortest words telling them apart"
+      "\n"
+      "\nguess   <word> [word...]"
+      "\n\taliases: 'g'"
+      "\n\tguesses a word with respect to the active rule; several words are guessed in order, and their verdicts shown"
+      "\n"
+      "\nhint    [count]"
+      "\n\tshows unguessed words the active rule accepts and rejects; instant for pure rules, whose decisions are cached"
+      "\n"
+      "\nhistory"
+      "\n\taliases: 'h'"
+      "\n\tshows this game's guesses in chronological order"
+      "\n"
+      "\njobs"
+      "\n\tlists the background jobs with their progress"
+      "\n"
+      "\nlist"
+      "\n\taliases: 'l', 'ls'"
+      "\n\tlists all available rules"
+      "\n"
+      "\nmem"
+      "\n\tshows the memory held by each subsystem (when built with PQ_MEMORY_ACCOUNTING) and by the process"
+      "\n"
+      "\nmultigame"
+      "\n\taliases: 'mg'"
+      "\n\tstarts a new game of every rule at once, for probing"
+      "\n"
+      "\nnewgame <rule>"
+      "\n\taliases: 'ng', 'new'"
+      "\n\tloads the given rule and starts a new game"
+      "\n"
+      "\nprobe   <word>"
+      "\n\taliases: 'p'"
+      "\n\tguesses a word in the games of every rule and shows which accept it"
+      "\n"
+      "\nquit"
+      "\n\taliases: 'q'"
+      "\n\tquits pquirks"
+      "\n"
+      "\nrecord  [file]"
+      "\n\trecords every following command into a trace file, or stops recording"
+      "\n"
+      "\nreload-dict [path]"
+      "\n\tloads a word list (by default the current one again) in the background and switches to it once its"
+      "\n\tindexes are built; commands already running finish with the old one"
+      "\n"
+      "\nrelease <rule>"
+      "\n\tlets a quarantined rule back into sweeps and probes"
+      "\n"
+      "\nrestart"
+      "\n\taliases: 'rs'"
+      "\n\tclears the history; can be undone"
+      "\n"
+      "\nscan    <rule> <file> [sequential]"
+      "\n\truns a rule over every word of a text file and reports what it accepts; 'sequential' plays the words"
+      "\n\tas one game in order, for rules that look at the history"
+      "\n"
+      "\nseed    [number]"
+      "\n\tshows the game's random seed, or sets it so that probabilistic rules replay the same way"
+      "\n"
+      "\nslow"
+      "\n\tshows the latency of every rule evaluated so far, slowest first, and which are quarantined"
+      "\n"
+      "\nstate"
+      "\n\taliases: 's'"
+      "\n\tshows the state"
+      "\n"
+      "\nstream"
+      "\n\tguesses the words on the following lines in order, as fast as they come, until a line holding only '.'"
+      "\n"
+      "\nsweep   [rule]"
+      "\n\taliases: 'sw'"
+      "\n\truns a rule (by default the active one) over the whole dictionary and reports what it accepts"
+      "\n"
+      "\ntournament [games] [max-guesses] [streak]"
+      "\n\taliases: 'tn'"
+      "\n\tplays simulated guessers against every rule and reports how many guesses each needs"
+      "\n"
+      "\nundo    [count]"
+      "\n\taliases: 'u'"
+      "\n\ttakes back the last guesses or restart on this branch"
+      "\n"
+      "\nwait    [job]"
+      "\n\twaits for a background job (by default every one) to finish"
+      "\n"
+      "\n?"
+      "\n\tshows this help menu"
+      "\n"
+      "\nanalyze, diff, scan, sweep and tournament run in the background when followed by '&', so that play can go on meanwhile."
+      "\n";
+
+    U_LOGI("Available commands:");
+    std::cout << helptext << std::endl;
+  }
+
+  void cmd_ls (const std::map<std::string, const Rule *> & table)
+  {
+    U_LOGI("Available rules:");
+
+    for (auto entry : table)
+    {
+      std::cout
+        << "\033[1;4m\"" + entry.first + "\"\033[0m\n\n"
+        << "\033[3m" << entry.second->description() << "\033[0m\n\n";
+    }
+  }
+
+  void cmd_mem()
+  {
+    U_LOGI("Memory:");
+    Memory::format(std::cout) << std::endl;
+  }
+
+  std::vector<std::string> cmd_parse(const std::string & line, size_t & nargs)
+  {
+    std::stringstream ss {line};
+    std::string fragment;
+    std::vector<std::string> cmdline;
+
+    while (ss >> fragment)
+    {
+      cmdline.push_back(fragment);
+    }
+
+    nargs = cmdline.size();
+    return cmdline;
+  }
+
+  /**
+   *  Returns the command line after its first n arguments, with its spacing intact.
+   */ 
+  std::string cmd_rest(const std::string & line, size_t n)
+  {
+    size_t at = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+      at = line.find_first_not_of(" \t", at);
+      at = line.find_first_of(" \t", at);
+    }
+
+    at = line.find_first_not_of(" \t", at);
+    return at == std::string::npos ? "" : line.substr(at);
+  }
+
+  void cmd_define(const std::string & line, const std::vector<std::string> & cmdline)
+  {
+    std::string source = cmd_rest(line, 2);
+    if (cmdline.size() < 3 || source.empty())
+    {
+      U_LOGI("Usage: define <name> <expression>");
+      return;
+    }
+
+    try
+    {
+      const DefinedRule & rule = DefinedRule::define(cmdline[1], source);
+      U_LOGI("Defined rule '", rule.name(), "' in ", rule.expr().size(), " instructions.");
+      U_LOGD("Bytecode:\n", rule.expr().disassemble());
+    }
+    catch (Error & e)
+    {
+      e.print();
+    }
+  }
+
+  void cmd_scan(const std::map<std::string, const Rule *> & table, const std::vector<std::string> & cmdline, uint64_t seed,
+      std::ostream & out)
+  {
+    if (cmdline.size() < 3 || (cmdline.size() > 3 && cmdline[3] != "sequential"))
+    {
+      U_LOGI("Usage: scan <rule> <file> [sequential]");
+      return;
+    }
+
+    auto it = table.find(cmdline[1]);
+    if (it == table.end())
+    {
+      U_LOGE("Unknown rule '", cmdline[1], "'.");
+      return;
+    }
+
+    const Rule & rule = * it->second;
+    if (Watchdog::instance().quarantined(rule))
+    {
+      U_LOGE("'", rule.name(), "' is quarantined for overrunning its budget; use `release ", rule.name(), "` first.");
+      return;
+    }
+
+    Corpus::Settings settings {};
+    settings.sequential = cmdline.size() > 3;
+    settings.seed = seed;
+
+    std::unique_ptr<Corpus> corpus {};
+    try
+    {
+      corpus = std::make_unique<Corpus>(cmdline[2]);
+    }
+    catch (Error & e)
+    {
+      e.print();
+      return;
+    }
+
+    Corpus::Result result = corpus->scan(rule, settings);
+
+    if (result.aborted)
+    {
+      U_LOGE("Stopped scanning with '", rule.name(), "', which was quarantined for overrunning its budget.");
+      return;
+    }
+
+    U_LOGI(
+        "'", rule.name(), "' accepts ", result.accepted, " of ", result.tokens, " words (", std::fixed,
+        std::setprecision(1), 100.0 * result.accepted / std::max<uint64_t>(1, result.tokens), "%) in '",
+        corpus->path(), "', scanned in ", result.seconds * 1000, " ms (", result.bytes / 1e6 / std::max(result.seconds, 1e-9),
+        " MB/s, ", std::setprecision(0), result.tokens / std::max(result.seconds, 1e-9), " words/s).");
+
+    if (result.restarts)
+    {
+      U_LOGI("The game started over ", result.restarts, result.restarts == 1 ? " time" : " times", " to bound its history.");
+    }
+
+    if (result.accepted == 0)
+    {
+      out << std::endl;
+      return;
+    }
+
+    out << "first:    ";
+    for (size_t i = 0; i < result.examples.size(); i++)
+    {
+      out << (i ? ", " : "") << result.examples[i];
+    }
+
+    out << "\nfrequent: ";
+    for (size_t i = 0; i < result.frequent.size(); i++)
+    {
+      out << (i ? ", " : "") << result.frequent[i].first << " (" << result.frequent[i].second << ")";
+    }
+
+    out << "\n" << std::endl;
+  }
+
+  void cmd_sweep(const Rule & rule, const History & history, std::ostream & out)
+  {
+    Watchdog & watchdog = Watchdog::instance();
+    if (watchdog.quarantined(rule))
+    {
+      U_LOGE("'", rule.name(), "' is quarantined for overrunning its budget; use `release ", rule.name(), "` first.");
+      return;
+    }
+
+    // Pure rules decide the same way in every game, so their bitmaps come from the cache, which computes and
+    // saves them the first time.
+
+    const Dictionary & dictionary = Dictionary::instance();
+    RuleCache & cache = RuleCache::instance();
+    bool cached = cache.find(rule) != nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    std::optional<Bitmap> swept {};
+
+    if (rule.pure())
+    {
+      const Bitmap * bitmap = cache.accepted(rule);
+      if (bitmap) swept = * bitmap;
+    }
+    else
+    {
+      swept = RuleCache::sweep(rule, history);
+    }
+
+    if (! swept)
+    {
+      U_LOGE("Stopped sweeping '", rule.name(), "', which was quarantined for overrunning its budget.");
+      return;
+    }
+
+    const Bitmap & accepted = * swept;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t count = accepted.count();
+
+    U_LOGI(
+        "'", rule.name(), "' accepts ", count, " of ", dictionary.size(), " words (",
+        std::fixed, std::setprecision(1), 100.0 * count / std::max<size_t>(1, dictionary.size()), "%), ",
+        cached ? "looked up in " : "swept in ", seconds * 1000, " ms",
+        cached ? "" : " (" + std::to_string((uint64_t) (dictionary.size() / std::max(seconds, 1e-9))) + " words/s)",
+        ".");
+
+    size_t shown = 0;
+    for (size_t id = accepted.next(0); id < accepted.size() && shown < 10; id = accepted.next(id + 1), shown++)
+    {
+      out << (shown ? ", " : "") << dictionary.word(id);
+    }
+
+    out << (shown == 10 ? ", ..." : "") << "\n" << std::endl;
+  }
+
+  void cmd_tournament(const std::map<std::string, const Rule *> & table, const std::vector<std::string> & cmdline,
+      std::ostream & out)
+  {
+    Tournament::Settings settings {};
+
+    try
+    {
+      if (cmdline.size() > 1) settings.games = std::stoul(cmdline[1]);
+      if (cmdline.size() > 2) settings.max_guesses = std::stoul(cmdline[2]);
+      if (cmdline.size() > 3) settings.streak = std::stoul(cmdline[3]);
+    }
+    catch (std::exception & e)
+    {
+      U_LOGI("Usage: tournament [games] [max-guesses] [streak]");
+      return;
+    }
+
+    Tournament tournament {settings};
+    tournament.run(table);
+    tournament.format(out);
+  }
+
+  const char * job_state(Job::State state)
+  {
+    switch (state)
+    {
+      case Job::State::QUEUED:    return "queued";
+      case Job::State::RUNNING:   return "running";
+      case Job::State::DONE:      return "finished";
+      case Job::State::CANCELLED: return "cancelled";
+      case Job::State::FAILED:    return "failed";
+    }
+
+    return "?";
+  }
+
+  /**
+   *  Splits the bytes read from a file descriptor into lines, without blocking once the descriptor is readable.
+   */ 
+  class LineReader
+  {
+    public:
+
+      explicit LineReader(int fd)
+        : m_fd {fd}
+      {}
+
+      /**
+       *  Determines whether the input ended.
+       */ 
+      bool eof() const
+      {
+        return m_eof;
+      }
+
+      /**
+       *  Reads whatever input is available; call once the descriptor is readable.
+       */ 
+      void fill()
+      {
+        char chunk[65536];
+        ssize_t n = read(m_fd, chunk, sizeof(chunk));
+
+        if (n > 0) m_buffer.append(chunk, n);
+        else if (n == 0 || (errno != EINTR && errno != EAGAIN)) m_eof = true;
+      }
+
+      /**
+       *  Returns the next complete line, or the unterminated rest of the input once it ended.
+       */ 
+      std::optional<std::string> next()
+      {
+        size_t end = m_buffer.find('\n', m_start);
+        if (end == std::string::npos && ! (m_eof && m_start < m_buffer.size()))
+        {
+          m_buffer.erase(0, m_start);
+          m_start = 0;
+          return std::nullopt;
+        }
+
+        end = std::min(end, m_buffer.size());
+        std::string line = m_buffer.substr(m_start, end - m_start);
+        m_start = std::min(end + 1, m_buffer.size());
+        return line;
+      }
+
+    private:
+
+      int         m_fd;
+      std::string m_buffer;
+      size_t      m_start {0};
+      bool        m_eof   {false};
+  };
+
+  /**
+   *  Determines whether the line ends a stream of guesses.
+   */ 
+  bool ends_stream(const std::string & line)
+  {
+    std::istringstream ss {line};
+    std::string first {};
+    std::string second {};
+
+    return ss >> first && first == "." && ! (ss >> second);
+  }
+
+  /**
+   *  Mutes logging and standard output for as long as it lives.
+   */ 
+  class Muted
+  {
+    public:
+
+      Muted()
+        : m_buffer {std::cout.rdbuf(nullptr)}
+      {
+        log_muted() = true;
+      }
+
+      ~Muted()
+      {
+        std::cout.rdbuf(m_buffer);
+        std::cout.clear();
+        log_muted() = false;
+      }
+
+      Muted(const Muted &) = delete;
+      Muted & operator=(const Muted &) = delete;
+
+    private:
+
+      std::streambuf * m_buffer;
+  };
+}
+
+Session::Session(const std::map<std::string, const Rule *> & table)
+  : m_table {table}
+{}
+
+void Session::cmd_branch(const std::vector<std::string> & cmdline)
+{
+  if (cmdline.size() < 2)
+  {
+    U_LOGI("Branches:");
+    m_branches[m_current] = m_active;
+
+    for (auto & [name, branch] : m_branches)
+    {
+      std::cout
+        << (name == m_current ? "* " : "  ") << name
+        << " (" << branch.history.count() << " guesses)\n";
+    }
+
+    std::cout << std::endl;
+  }
+  else if (m_branches.count(cmdline[1]) > 0 || cmdline[1] == m_current)
+  {
+    U_LOGE("There is already a branch named '", cmdline[1], "'.");
+  }
+  else
+  {
+    m_branches[cmdline[1]] = m_active;
+    U_LOGI("Created branch '", cmdline[1], "' at guess ", m_active.history.count(), ".");
+  }
+}
+
+void Session::cmd_cancel(const std::vector<std::string> & cmdline)
+{
+  if (cmdline.size() < 2)
+  {
+    for (auto & [id, job] : m_jobs)
+    {
+      job->cancel();
+    }
+
+    U_LOGI("Cancelled ", m_jobs.size(), m_jobs.size() == 1 ? " job." : " jobs.");
+    return;
+  }
+
+  size_t id = 0;
+  try
+  {
+    id = std::stoul(cmdline[1]);
+  }
+  catch (std::exception & e)
+  {
+    U_LOGI("Usage: cancel [job]");
+    return;
+  }
+
+  auto it = m_jobs.find(id);
+  if (it == m_jobs.end())
+  {
+    U_LOGE("There is no job ", id, " running.");
+    return;
+  }
+
+  it->second->cancel();
+  U_LOGI("Cancelled job ", id, "; it stops at its next checkpoint.");
+}
+
+void Session::cmd_checkout(const std::vector<std::string> & cmdline)
+{
+  if (cmdline.size() < 2)
+  {
+    U_LOGI("Usage: checkout <branch>");
+  }
+  else if (cmdline[1] == m_current)
+  {
+    U_LOGW("Already on branch '", m_current, "'.");
+  }
+  else if (m_branches.count(cmdline[1]) == 0)
+  {
+    U_LOGE("There is no branch named '", cmdline[1], "'; use `branch ", cmdline[1], "` to create it.");
+  }
+  else
+  {
+    m_branches[m_current] = m_active;
+    m_active = m_branches[cmdline[1]];
+    m_current = cmdline[1];
+    U_LOGI("Switched to branch '", m_current, "' at guess ", m_active.history.count(), ".");
+  }
+}
+
+void Session::cmd_guess(const std::vector<std::string> & cmdline)
+{
+  if (! m_in_effect)
+  {
+    U_LOGE("There is no rule in effect.");
+  }
+  else if (cmdline.size() < 2)
+  {
+    U_LOGI("Usage: guess <word> [word...]");
+  }
+  else if (cmdline.size() > 2)
+  {
+    play(std::vector<std::string> (cmdline.begin() + 1, cmdline.end()));
+  }
+  else
+  {
+    try
+    {
+      History & history = m_active.history;
+      std::optional<Verdict> verdict = Watchdog::instance().evaluate(* m_in_effect, cmdline[1], history);
+      if (! verdict)
+      {
+        U_LOGE(
+            "'", m_in_effect->name(), "' did not decide on '", cmdline[1], "' within its budget; "
+            "the guess was not counted.");
+        return;
+      }
+
+      m_active.undo.push_back(history);
+      history.push(Guess {cmdline[1], verdict->accepted}, verdict->delta);
+      observe(cmdline[1], verdict->accepted);
+    }
+    catch (Error & e)
+    {
+      e.print();
+    }
+  }
+}
+
+void Session::cmd_hint(const std::vector<std::string> & cmdline)
+{
+  size_t n = 3;
+  try
+  {
+    if (cmdline.size() > 1) n = std::stoul(cmdline[1]);
+  }
+  catch (std::exception & e)
+  {
+    U_LOGI("Usage: hint [count]");
+    return;
+  }
+
+  if (! m_in_effect)
+  {
+    U_LOGE("There is no rule in effect.");
+    return;
+  }
+
+  const Dictionary & dictionary = Dictionary::instance();
+  const History & history = m_active.history;
+  std::mt19937_64 rng {std::random_device {}()};
+
+  std::set<Dictionary::Id> chosen {};
+  std::vector<std::string> hints[2] {};
+
+  const Bitmap * bitmap = RuleCache::instance().accepted(* m_in_effect);
+  if (bitmap)
+  {
+    // Start from random words and move on to the next one of the wanted kind that was not guessed yet.
+
+    for (bool want : {true, false})
+    {
+      for (size_t tries = 0; tries < 16 * n && hints[want].size() < n; tries++)
+      {
+        Dictionary::Id id = rng() % dictionary.size();
+        for (size_t step = 0; step < dictionary.size() && bitmap->test(id) != want; step++)
+        {
+          id = (id + 1) % dictionary.size();
+        }
+
+        std::string word {dictionary.word(id)};
+        if (bitmap->test(id) == want && ! history.guessed(word) && chosen.insert(id).second)
+        {
+          hints[want].push_back(word);
+        }
+      }
+    }
+  }
+  else
+  {
+    Watchdog::Meter meter = Watchdog::instance().meter(* m_in_effect);
+    std::string word {};
+
+    for (size_t tries = 0; tries < 20000 && (hints[0].size() < n || hints[1].size() < n); tries++)
+    {
+      Dictionary::Id id = rng() % dictionary.size();
+      word.assign(dictionary.word(id));
+      if (history.guessed(word) || ! chosen.insert(id).second) continue;
+
+      bool accepted = meter.evaluate(word, history).accepted;
+      if (hints[accepted].size() < n) hints[accepted].push_back(word);
+      if (meter.quarantined()) break;
+    }
+  }
+
+  auto join = [](const std::vector<std::string> & words)
+  {
+    std::string joined {};
+    for (const std::string & word : words)
+    {
+      joined += (joined.empty() ? "" : ", ") + word;
+    }
+
+    return joined.empty() ? "(none found)" : joined;
+  };
+
+  U_LOGI("Hints for '", m_in_effect->name(), "'", bitmap ? ", looked up in its cached bitmap:" : ", by sampling:");
+  std::cout << "accepted: " << join(hints[1]) << "\nrejected: " << join(hints[0]) << "\n" << std::endl;
+}
+
+void Session::cmd_jobs()
+{
+  if (m_jobs.empty())
+  {
+    U_LOGI("No jobs are running.");
+    return;
+  }
+
+  U_LOGI("Jobs:");
+  for (auto & [id, job] : m_jobs)
+  {
+    double progress = job->progress();
+
+    std::cout
+      << "[" << id << "] " << std::left << std::setw(10) << job_state(job->state()) << std::right << std::fixed
+      << std::setprecision(0) << std::setw(4);
+
+    if (progress < 0) std::cout << "-";
+    else std::cout << progress * 100 << "%";
+
+    std::cout
+      << std::setprecision(1) << std::setw(9) << job->elapsed() << " s  " << job->command()
+      << (job->cancelled() ? " (cancelling)" : "") << "\n" << std::defaultfloat;
+  }
+
+  std::cout << std::endl;
+}
+
+void Session::cmd_multigame()
+{
+  m_multi = std::make_unique<MultiGame>(m_table, draw_seed());
+  U_LOGI("Started games of ", m_multi->size(), " rules with seed ", m_multi->seed(), ".");
+}
+
+void Session::cmd_newgame(const std::vector<std::string> & cmdline)
+{
+  if (cmdline.size() < 2)
+  {
+    U_LOGI("Usage: newgame <rule>");
+  }
+  else if (m_table.find(cmdline[1]) != m_table.end())
+  {
+    m_in_effect = m_table.at(cmdline[1]);
+    m_branches.clear();
+    m_current = "main";
+    m_active = {};
+    m_active.history.reseed(draw_seed());
+    m_in_effect->initialize(m_active.history);
+    U_LOGI("Loaded rule '", m_in_effect->name(), "' with seed ", m_active.history.seed(), ".");
+  }
+  else
+  {
+    U_LOGE("Unknown rule '", cmdline[1], "'.");
+  }
+}
+
+void Session::cmd_probe(const std::vector<std::string> & cmdline)
+{
+  if (cmdline.size() < 2)
+  {
+    U_LOGI("Usage: probe <word>");
+    return;
+  }
+
+  if (! m_multi)
+  {
+    cmd_multigame();
+  }
+
+  try
+  {
+    std::vector<std::optional<bool>> accepted = m_multi->probe(cmdline[1]);
+    std::string accepting {};
+    std::string rejecting {};
+    std::string undecided {};
+    size_t count = 0;
+
+    for (size_t i = 0; i < accepted.size(); i++)
+    {
+      if (accepted[i]) observe(cmdline[1], * accepted[i]);
+
+      std::string & names = ! accepted[i] ? undecided : * accepted[i] ? accepting : rejecting;
+      names += (names.empty() ? "" : ", ") + m_multi->rules()[i]->name();
+      count += accepted[i].value_or(false);
+    }
+
+    U_LOGI("'", cmdline[1], "' is accepted by ", count, " of ", accepted.size(), " rules.");
+    std::cout
+      << "accepted: " << (accepting.empty() ? "(none)" : accepting) << "\n"
+      << "rejected: " << (rejecting.empty() ? "(none)" : rejecting) << "\n";
+
+    if (! undecided.empty())
+    {
+      std::cout << "undecided (quarantined or over budget): " << undecided << "\n";
+    }
+
+    std::cout << std::endl;
+  }
+  catch (Error & e)
+  {
+    e.print();
+  }
+}
+
+void Session::cmd_record(const std::vector<std::string> & cmdline)
+{
+  if (m_replay)
+  {
+    return;
+  }
+
+  if (cmdline.size() < 2)
+  {
+    if (m_recorder)
+    {
+      U_LOGI("Stopped recording to '", m_recorder->path(), "'.");
+      m_recorder.reset();
+    }
+    else
+    {
+      U_LOGI("Usage: record <file>");
+    }
+    return;
+  }
+
+  try
+  {
+    record(cmdline[1]);
+    U_LOGI("Recording to '", cmdline[1], "'.");
+  }
+  catch (Error & e)
+  {
+    e.print();
+  }
+}
+
+void Session::cmd_undo(const std::vector<std::string> & cmdline)
+{
+  size_t n = 1;
+  try
+  {
+    if (cmdline.size() > 1) n = std::stoul(cmdline[1]);
+  }
+  catch (std::exception & e)
+  {
+    U_LOGI("Usage: undo [count]");
+    return;
+  }
+
+  if (n == 0 || n > m_active.undo.size())
+  {
+    U_LOGE("Can only undo up to ", m_active.undo.size(), " steps on branch '", m_current, "'.");
+    return;
+  }
+
+  m_active.history = m_active.undo[m_active.undo.size() - n];
+  m_active.undo.resize(m_active.undo.size() - n);
+  U_LOGI("Undid ", n, " step", n == 1 ? "" : "s", "; back at guess ", m_active.history.count(), ".");
+}
+
+void Session::cmd_wait(const std::vector<std::string> & cmdline)
+{
+  Executor & executor = Executor::instance();
+
+  if (cmdline.size() < 2)
+  {
+    executor.run_until([this]() { return m_jobs.empty(); });
+    return;
+  }
+
+  size_t id = 0;
+  try
+  {
+    id = std::stoul(cmdline[1]);
+  }
+  catch (std::exception & e)
+  {
+    U_LOGI("Usage: wait [job]");
+    return;
+  }
+
+  if (m_jobs.count(id) == 0)
+  {
+    U_LOGE("There is no job ", id, " running.");
+    return;
+  }
+
+  executor.run_until([this, id]() { return m_jobs.count(id) == 0; });
+}
+
+bool Session::dispatch(const std::string & line)
+{
+  size_t nargs;
+  std::vector<std::string> cmdline = cmd_parse(line, nargs);
+  if (nargs == 0) return true;
+
+  std::string cmd = cmdline[0];
+  if (m_recorder && (m_streaming || cmd != "record"))
+  {
+    m_recorder->line(line);
+  }
+
+  // Every command sees one dictionary throughout, even if a reload publishes another one meanwhile.
+
+  Dictionary::Pin pin {};
+
+  // While streaming, every line is words to guess, up to the one that ends the stream.
+
+  if (m_streaming)
+  {
+    if (nargs == 1 && cmd == ".")
+    {
+      m_streaming = false;
+      U_LOGI("Streamed ", m_streamed, m_streamed == 1 ? " guess." : " guesses.");
+    }
+    else
+    {
+      play(cmdline);
+    }
+
+    return true;
+  }
+
+  // A trailing '&' asks for the command to run in the background, which analyze, diff, scan, sweep and tournament
+  // can do.
+
+  bool background = nargs > 1 && cmdline.back() == "&";
+  if (background)
+  {
+    cmdline.pop_back();
+    nargs--;
+  }
+
+  std::string command = cmdline[0];
+  for (size_t i = 1; i < nargs; i++)
+  {
+    command += " " + cmdline[i];
+  }
+
+  History & history = m_active.history;
+  bool should_continue = true;
+
+  switch (hash(cmd))
+  {
+    case "analyze"_:
+      {
+        const Rule * rule = m_in_effect;
+        if (nargs > 1)
+        {
+          auto it = m_table.find(cmdline[1]);
+          rule = it == m_table.end() ? nullptr : it->second;
+        }
+
+        if (! rule)
+        {
+          U_LOGE(nargs > 1 ? "Unknown rule '" + cmdline[1] + "'." : "There is no rule in effect.");
+          break;
+        }
+
+        // Like a sweep, analyze against this game if the rule is the active one, and against a new game otherwise.
+
+        History fresh {};
+        if (rule != m_in_effect)
+        {
+          fresh.reseed(history.seed());
+          rule->initialize(fresh);
+        }
+
+        launch(command, background, [rule, history = rule == m_in_effect ? history : fresh](std::ostream & out)
+        {
+          cmd_analyze(* rule, history, out);
+        });
+        break;
+      }
+    case "b"_:
+    case "branch"_:
+      {
+        cmd_branch(cmdline);
+        break;
+      }
+    case "budget"_:
+      {
+        cmd_budget(cmdline);
+        break;
+      }
+    case "cancel"_:
+      {
+        cmd_cancel(cmdline);
+        break;
+      }
+    case "categories"_:
+      {
+        cmd_categories(cmdline);
+        break;
+      }
+    case "co"_:
+    case "checkout"_:
+      {
+        cmd_checkout(cmdline);
+        break;
+      }
+    case "cls"_:
+    case "clear"_:
+      {
+        cmd_clear();
+        break;
+      }
+    case "define"_:
+      {
+        cmd_define(line, cmdline);
+        break;
+      }
+    case "d"_:
+    case "desc"_:
+    case "description"_:
+      {
+        if (m_in_effect)
+        {
+          U_LOGI("Description for ", m_in_effect->name(), ":");
+          std::cout << m_in_effect->description() << std::endl << std::endl;
+        }
+        else
+        {
+          U_LOGE("There is no rule in effect.");
+        }
+        break;
+      }
+    case "diff"_:
+      {
+        launch(command, background, [table = m_table, cmdline, seed = history.seed()](std::ostream & out)
+        {
+          cmd_diff(table, cmdline, seed, out);
+        });
+        break;
+      }
+    case "jobs"_:
+      {
+        cmd_jobs();
+        break;
+      }
+    case "q"_:
+    case "quit"_:
+      {
+        should_continue = false;
+        break;
+      }
+    case "l"_:
+    case "ls"_:
+    case "list"_:
+      {
+        cmd_ls(m_table);
+        break;
+      }
+    case "g"_:
+    case "guess"_:
+      {
+        cmd_guess(cmdline);
+        break;
+      }
+    case "hint"_:
+      {
+        cmd_hint(cmdline);
+        break;
+      }
+    case "h"_:
+    case "history"_:
+      {
+        history.format(std::cout);
+        break;
+      }
+    case "mem"_:
+      {
+        cmd_mem();
+        break;
+      }
+    case "mg"_:
+    case "multigame"_:
+      {
+        cmd_multigame();
+        break;
+      }
+    case "ng"_:
+    case "new"_:
+    case "newgame"_:
+      {
+        cmd_newgame(cmdline);
+        break;
+      }
+    case "p"_:
+    case "probe"_:
+      {
+        cmd_probe(cmdline);
+        break;
+      }
+    case "record"_:
+      {
+        cmd_record(cmdline);
+        break;
+      }
+    case "reload-dict"_:
+      {
+        if (nargs > 2)
+        {
+          U_LOGI("Usage: reload-dict [path]");
+          break;
+        }
+
+        // Reloads always run in the background, since building the indexes takes a while.
+
+        launch(command, true, [path = nargs > 1 ? cmdline[1] : Dictionary::path()](std::ostream & out)
+        {
+          size_t before = Dictionary::instance().size();
+          auto start = std::chrono::steady_clock::now();
+
+          std::shared_ptr<const Dictionary> dictionary = Dictionary::reload(path);
+          double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+          U_LOGI(
+              "Switched to the dictionary at '", path, "' with ", dictionary->size(), " words (", before,
+              " before), loaded and indexed in ", std::fixed, std::setprecision(1), seconds * 1000, " ms.");
+        });
+        break;
+      }
+    case "release"_:
+      {
+        auto it = nargs > 1 ? m_table.find(cmdline[1]) : m_table.end();
+        if (it == m_table.end())
+        {
+          U_LOGI("Usage: release <rule>");
+          break;
+        }
+
+        Watchdog::instance().release(* it->second);
+        U_LOGI("Released '", cmdline[1], "' from quarantine.");
+        break;
+      }
+    case "rs"_:
+    case "restart"_:
+      {
+        uint64_t seed = history.seed();
+        m_active.undo.push_back(history);
+        history = {};
+        history.reseed(seed);
+        if (m_in_effect)
+        {
+          m_in_effect->initialize(history);
+          U_LOGI("Restarting with active rule '", m_in_effect->name(), "'.");
+        }
+        else
+        {
+          U_LOGW("Clearing history, but there is no rule in effect.");
+        }
+        break;
+      }
+    case "scan"_:
+      {
+        launch(command, background, [table = m_table, cmdline, seed = history.seed()](std::ostream & out)
+        {
+          cmd_scan(table, cmdline, seed, out);
+        });
+        break;
+      }
+    case "seed"_:
+      {
+        if (nargs < 2)
+        {
+          U_LOGI("Seed: ", history.seed());
+          break;
+        }
+
+        try
+        {
+          history.reseed(std::stoull(cmdline[1]));
+          U_LOGI("Reseeded with ", history.seed(), ".");
+        }
+        catch (std::exception & e)
+        {
+          U_LOGI("Usage: seed [number]");
+        }
+        break;
+      }
+    case "s"_:
+    case "state"_:
+      {
+        U_LOGI("State:");
+        if (m_in_effect) m_in_effect->print_state(std::cout, history);
+        else history.state_format(std::cout);
+        std::cout << std::endl;
+        break;
+      }
+    case "slow"_:
+      {
+        U_LOGI("Rule latencies:");
+        Watchdog::instance().format(std::cout);
+        std::cout << std::endl;
+        break;
+      }
+    case "stream"_:
+      {
+        if (! m_in_effect)
+        {
+          U_LOGE("There is no rule in effect.");
+          break;
+        }
+
+        m_streaming = true;
+        m_streamed = 0;
+        U_LOGI("Streaming guesses against '", m_in_effect->name(), "'; end with a line holding only '.'.");
+        break;
+      }
+    case "sw"_:
+    case "sweep"_:
+      {
+        const Rule * rule = m_in_effect;
+        if (nargs > 1)
+        {
+          auto it = m_table.find(cmdline[1]);
+          rule = it == m_table.end() ? nullptr : it->second;
+        }
+
+        if (! rule)
+        {
+          U_LOGE(nargs > 1 ? "Unknown rule '" + cmdline[1] + "'." : "There is no rule in effect.");
+          break;
+        }
+
+        // Sweep against this game if the rule is the active one, and against a new game otherwise.
+
+        History fresh {};
+        if (rule != m_in_effect)
+        {
+          fresh.reseed(history.seed());
+          rule->initialize(fresh);
+        }
+
+        launch(command, background, [rule, history = rule == m_in_effect ? history : fresh](std::ostream & out)
+        {
+          cmd_sweep(* rule, history, out);
+        });
+        break;
+      }
+    case "tn"_:
+    case "tournament"_:
+      {
+        launch(command, background, [table = m_table, cmdline](std::ostream & out)
+        {
+          cmd_tournament(table, cmdline, out);
+        });
+        break;
+      }
+    case "u"_:
+    case "undo"_:
+      {
+        cmd_undo(cmdline);
+        break;
+      }
+    case "wait"_:
+      {
+        cmd_wait(cmdline);
+        break;
+      }
+    case "?"_:
+      {
+        cmd_help();
+        break;
+      }
+    default:
+      {
+        U_LOGE("Unknown command '", cmd, "'; type `?` for help.");
+        break;
+      }
+  }
+
+  if (m_recorder)
+  {
+    m_recorder->flush();
+  }
+
+  return should_continue;
+}
+
+uint64_t Session::draw_seed()
+{
+  uint64_t seed = 0;
+
+  if (m_replay && m_cursor < m_replay->size() && (* m_replay)[m_cursor].kind == Trace::SEED)
+  {
+    seed = (* m_replay)[m_cursor++].value;
+  }
+  else
+  {
+    seed = ((uint64_t) std::random_device {}() << 32) | std::random_device {}();
+  }
+
+  if (m_recorder)
+  {
+    m_recorder->seed(seed);
+  }
+
+  return seed;
+}
+
+void Session::launch(const std::string & command, bool background, std::function<void(std::ostream &)> work)
+{
+  // Replays run every job in place, so that they finish in the order they were recorded.
+
+  if (! background || m_replay)
+  {
+    work(std::cout);
+    return;
+  }
+
+  auto job = std::make_shared<Job>(m_next_job++, command);
+  m_jobs[job->id()] = job;
+
+  U_LOGI("[", job->id(), "] Started `", command, "` in the background.");
+  run_job(job, std::move(work));
+}
+
+void Session::observe(const std::string & word, bool accepted)
+{
+  m_guesses++;
+
+  if (m_recorder)
+  {
+    m_recorder->verdict(accepted);
+  }
+
+  if (! m_replay)
+  {
+    return;
+  }
+
+  if (m_cursor < m_replay->size() && (* m_replay)[m_cursor].kind == Trace::VERDICT)
+  {
+    bool expected = (* m_replay)[m_cursor++].value;
+    if (expected != accepted)
+    {
+      m_mismatches.push_back(log_print(
+          "guess ", m_guesses, " '", word, "' was ", expected ? "accepted" : "rejected",
+          " but is now ", accepted ? "accepted" : "rejected"));
+    }
+  }
+  else
+  {
+    m_mismatches.push_back(log_print("guess ", m_guesses, " '", word, "' has no recorded decision"));
+  }
+}
+
+void Session::play(const std::vector<std::string> & words)
+{
+  if (! m_in_effect)
+  {
+    U_LOGE("There is no rule in effect.");
+    return;
+  }
+
+  History & history = m_active.history;
+  std::ostringstream block {};
+  size_t count = 0;
+  size_t accepted = 0;
+  size_t column = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  auto played = [&](const Guess & guess)
+  {
+    m_active.undo.push_back(history);
+    observe(guess.word, guess.accepted);
+    count++;
+    accepted += guess.accepted;
+
+    if (column > 0 && column + guess.word.size() + 2 > 100)
+    {
+      block << "\n";
+      column = 0;
+    }
+
+    block << (column > 0 ? " " : "") << (guess.accepted ? '+' : '-') << guess.word;
+    column += guess.word.size() + 2;
+  };
+
+  bool failed = false;
+  try
+  {
+    GuessBatch {* m_in_effect}.play(words, history, played);
+  }
+  catch (Error & e)
+  {
+    e.print();
+    failed = true;
+  }
+
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  m_streamed += count;
+
+  U_LOGI(
+      "'", m_in_effect->name(), "' accepted ", accepted, " of ", count, count == 1 ? " guess" : " guesses",
+      " (played in ", std::fixed, std::setprecision(2), ms, " ms):");
+  std::cout << block.str() << "\n" << std::endl;
+
+  if (count < words.size())
+  {
+    U_LOGE(
+        "Stopped after ", count, " of ", words.size(), " words, since '", m_in_effect->name(), "' ",
+        failed ? "failed on the next one." : "was quarantined for overrunning its budget.");
+  }
+}
+
+void Session::record(const std::string & path)
+{
+  m_recorder = std::make_unique<Trace::Writer>(path);
+}
+
+Executor::Task Session::repl(int fd)
+{
+  Executor & executor = Executor::instance();
+  LineReader reader {fd};
+  std::optional<std::string> held {};
+
+  while (true)
+  {
+    std::cout << prompt << std::flush;
+    m_prompting = true;
+
+    std::optional<std::string> line = std::exchange(held, std::nullopt);
+    while (! line && ! (line = reader.next()) && ! reader.eof())
+    {
+      co_await executor.readable(fd);
+      reader.fill();
+    }
+
+    // While streaming, the lines already read are played as one batch with this one, which lets GuessBatch
+    // prepare them ahead; the line ending the stream, if among them, is held back for the next round.
+
+    if (line && m_streaming && ! ends_stream(* line))
+    {
+      while ((held = reader.next()) && ! ends_stream(* held))
+      {
+        line->append(" ").append(* held);
+      }
+    }
+
+    m_prompting = false;
+    std::cout << "\033[0m\n";
+
+    // At the end of the input, jobs still running are left to finish; quitting cancels them.
+
+    if (! line)
+    {
+      break;
+    }
+
+    if (! dispatch(* line))
+    {
+      for (auto & [id, job] : m_jobs)
+      {
+        job->cancel();
+      }
+      break;
+    }
+  }
+
+  executor.run_until([this]() { return m_jobs.empty(); });
+  executor.stop();
+}
+
+size_t Session::replay(const std::map<std::string, const Rule *> & table, const std::string & path, std::ostream & out)
+{
+  std::vector<Trace::Event> events = Trace::load(path);
+  Session session {table};
+  session.m_replay = &events;
+
+  // Overruns depend on timing, so replays run without a budget to make the same decisions every time.
+
+  Watchdog & watchdog = Watchdog::instance();
+  std::chrono::microseconds budget = watchdog.budget();
+  watchdog.budget(std::chrono::microseconds {0});
+
+  size_t lines = 0;
+  uint64_t before = Memory::usage(Memory::SUBSYSTEMS).allocations - Memory::usage(Memory::DICTIONARY).allocations;
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    Muted muted {};
+
+    while (session.m_cursor < events.size())
+    {
+      const Trace::Event & event = events[session.m_cursor++];
+      if (event.kind != Trace::LINE)
+      {
+        session.m_mismatches.push_back(log_print(
+            "a recorded ", event.kind == Trace::SEED ? "seed" : "decision", " after command ", lines, " was not used"));
+        continue;
+      }
+
+      lines++;
+      if (! session.dispatch(event.line)) break;
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  watchdog.budget(budget);
+
+  out
+    << "Replayed " << lines << " commands and " << session.m_guesses << " guesses in "
+    << std::fixed << std::setprecision(3) << seconds * 1000 << " ms ("
+    << std::setprecision(0) << lines / std::max(seconds, 1e-9) << " commands/s, "
+    << session.m_guesses / std::max(seconds, 1e-9) << " guesses/s).\n";
+
+  for (size_t i = 0; i < session.m_mismatches.size() && i < 10; i++)
+  {
+    out << "  mismatch: " << session.m_mismatches[i] << "\n";
+  }
+
+  if (session.m_mismatches.size() > 10)
+  {
+    out << "  ... and " << session.m_mismatches.size() - 10 << " more.\n";
+  }
+
+  out
+    << (session.m_mismatches.empty() ? "Every decision matched the trace." : "The replay diverged from the trace.")
+    << std::defaultfloat << "\n";
+
+  // With accounting, allocations per guess show regressions in the hot path that timings are too noisy for.
+  // The dictionary loads and indexes itself in the background meanwhile, so its allocations are left out.
+
+  if (Memory::enabled())
+  {
+    uint64_t allocations =
+      Memory::usage(Memory::SUBSYSTEMS).allocations - Memory::usage(Memory::DICTIONARY).allocations - before;
+    out
+      << allocations << " allocations outside the dictionary during the replay (" << std::fixed << std::setprecision(1)
+      << (double) allocations / std::max<size_t>(1, session.m_guesses) << " per guess)." << std::defaultfloat << "\n";
+    Memory::format(out);
+  }
+
+  out << std::flush;
+
+  return session.m_mismatches.size();
+}
+
+Executor::Task Session::run_job(std::shared_ptr<Job> job, std::function<void(std::ostream &)> work)
+{
+  Executor & executor = Executor::instance();
+  co_await executor.background();
+
+  job->start();
+  Job::State state = Job::State::DONE;
+  {
+    Job::Scope scope {job.get()};
+    Dictionary::Pin pin {};
+    std::ostream * stream = std::exchange(log_stream(), &job->output());
+
+    try
+    {
+      work(job->output());
+    }
+    catch (Job::Cancelled &)
+    {
+      state = Job::State::CANCELLED;
+    }
+    catch (Error & e)
+    {
+      e.print();
+      state = Job::State::FAILED;
+    }
+    catch (std::exception & e)
+    {
+      U_LOGE(e.what());
+      state = Job::State::FAILED;
+    }
+
+    log_stream() = stream;
+  }
+  job->finish(state);
+
+  co_await executor.foreground();
+
+  // Break out of the prompt's style, and restore the prompt after, if the report interrupts it.
+
+  if (m_prompting) std::cout << "\033[0m\n";
+
+  U_LOGI(
+      "[", job->id(), "] ", (char) std::toupper(job_state(state)[0]), job_state(state) + 1, " `", job->command(),
+      "` after ", std::fixed, std::setprecision(1), job->elapsed(), " s", state == Job::State::CANCELLED ? "." : ":");
+
+  if (state != Job::State::CANCELLED)
+  {
+    std::cout << job->output().str() << std::flush;
+  }
+
+  m_jobs.erase(job->id());
+
+  if (m_prompting) std::cout << prompt << std::flush;
+}
@@ -0,0 +1,149 @@
+
+#ifndef PQ_SESSION_H_
+#define PQ_SESSION_H_
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Executor.h>
+#include <History.h>
+#include <Job.h>
+#include <MultiGame.h>
+#include <Rule.h>
+#include <Trace.h>
+
+/**
+ *  One interactive or batch session: the rule in effect, the branches of play, the games of every rule that
+ *  probes are played in, the jobs running in the background, and the trace being recorded or replayed, if any.
+ *  Commands are executed one line at a time by dispatch, whether they come from the terminal or from a trace.
+ *  Long commands followed by '&' run as jobs on the executor's background threads, while the session keeps
+ *  taking commands on the foreground.
+ */ 
+class Session
+{
+  public:
+
+    /**
+     *  Creates a session with no rule in effect over the given rules table.
+     */ 
+    explicit Session(const std::map<std::string, const Rule *> & table);
+
+    Session(const Session &) = delete;
+    Session & operator=(const Session &) = delete;
+
+    /**
+     *  Executes one command line. Returns false once the session should end.
+     */ 
+    bool dispatch(const std::string & line);
+
+    /**
+     *  Starts recording every following command into a trace at the given path; throws an error if the trace
+     *  cannot be created.
+     */ 
+    void record(const std::string & path);
+
+    /**
+     *  Reads command lines from the file descriptor and executes them until the session ends or the input does,
+     *  then waits for the jobs still running and stops the executor. Cooperates with the other coroutines on the
+     *  executor's foreground, so finished jobs report while the prompt waits for input.
+     */ 
+    Executor::Task repl(int fd);
+
+    /**
+     *  Re-executes the trace at the given path in a fresh session as fast as possible, with all output muted,
+     *  then reports to the given stream whether every decision matched the recorded one, and the throughput.
+     *  Returns the number of mismatched decisions; throws an error if the trace cannot be read.
+     */ 
+    static size_t replay(const std::map<std::string, const Rule *> & table, const std::string & path, std::ostream & out);
+
+  private:
+
+    /**
+     *  A line of play: its history, and the history as it was before each of its guesses, for undo. Histories
+     *  share structure, so keeping them all costs little.
+     */ 
+    struct Branch
+    {
+      History              history;
+      std::vector<History> undo;
+    };
+
+    void cmd_branch(const std::vector<std::string> & cmdline);
+
+    void cmd_cancel(const std::vector<std::string> & cmdline);
+
+    void cmd_checkout(const std::vector<std::string> & cmdline);
+
+    void cmd_guess(const std::vector<std::string> & cmdline);
+
+    void cmd_hint(const std::vector<std::string> & cmdline);
+
+    void cmd_jobs();
+
+    void cmd_multigame();
+
+    void cmd_newgame(const std::vector<std::string> & cmdline);
+
+    void cmd_probe(const std::vector<std::string> & cmdline);
+
+    void cmd_record(const std::vector<std::string> & cmdline);
+
+    void cmd_undo(const std::vector<std::string> & cmdline);
+
+    void cmd_wait(const std::vector<std::string> & cmdline);
+
+    /**
+     *  Returns the seed for a new game: the recorded one when replaying, or a fresh random one otherwise.
+     */ 
+    uint64_t draw_seed();
+
+    /**
+     *  Runs a command's work, writing to the given stream, either right away or, when asked to and not replaying,
+     *  as a background job. The work must not refer to anything the foreground may change meanwhile.
+     */ 
+    void launch(const std::string & command, bool background, std::function<void(std::ostream &)> work);
+
+    /**
+     *  Notes the decision made on a guess in the trace being recorded, and checks it against the trace being
+     *  replayed.
+     */ 
+    void observe(const std::string & word, bool accepted);
+
+    /**
+     *  Guesses the words in order against the rule in effect as one batch (see GuessBatch.h), and prints their
+     *  verdicts together.
+     */ 
+    void play(const std::vector<std::string> & words);
+
+    /**
+     *  Runs a job's work in the background, then reports its outcome and output on the foreground.
+     */ 
+    Executor::Task run_job(std::shared_ptr<Job> job, std::function<void(std::ostream &)> work);
+
+    const std::map<std::string, const Rule *> & m_table;
+    const Rule *                                m_in_effect {nullptr};
+
+    std::map<std::string, Branch>               m_branches;
+    std::string                                 m_current   {"main"};
+    Branch                                      m_active;
+
+    std::unique_ptr<MultiGame>                  m_multi;
+
+    std::map<size_t, std::shared_ptr<Job>>      m_jobs;
+    size_t                                      m_next_job  {1};
+    bool                                        m_prompting {false};
+    bool                                        m_streaming {false};
+    size_t                                      m_streamed  {0};
+
+    std::unique_ptr<Trace::Writer>              m_recorder;
+    const std::vector<Trace::Event> *           m_replay    {nullptr};
+    size_t                                      m_cursor    {0};
+    size_t                                      m_guesses   {0};
+    std::vector<std::string>                    m_mismatches;
+};
+
+#endif
@@ -0,0 +1,328 @@
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "Agent.h"
+#include "Error.h"
+
+namespace
+{
+  /**
+   *  Binary word features, laid out as ranges of feature indices.
+   */
+  enum Feature
+  {
+    HAS_LETTER = 0,
+    FIRST_LETTER = HAS_LETTER + 26,
+    LAST_LETTER = FIRST_LETTER + 26,
+    LENGTH = LAST_LETTER + 26,
+    VOWELS = LENGTH + 16,
+    DOUBLE_LETTER = VOWELS + 6,
+    SUM_PARITY = DOUBLE_LETTER + 1,
+    FEATURES = SUM_PARITY + 2
+  };
+
+  /**
+   *  The features present in one word.
+   */
+  struct Features
+  {
+    std::array<uint16_t, 48> indices;
+    size_t                   size {0};
+
+    explicit Features(std::string_view word)
+    {
+      uint32_t letters = 0;
+      unsigned vowels = 0;
+      unsigned sum = 0;
+      bool doubled = false;
+
+      for (size_t i = 0; i < word.size(); i++)
+      {
+        int c = word[i] - 'a';
+        if (c < 0 || c >= 26) continue;
+
+        letters |= uint32_t {1} << c;
+        vowels += (c == 0 || c == 4 || c == 8 || c == 14 || c == 20);
+        sum += c + 1;
+        doubled |= i > 0 && word[i] == word[i - 1];
+      }
+
+      for (int c = 0; c < 26; c++)
+      {
+        if (letters & (uint32_t {1} << c)) add(HAS_LETTER + c);
+      }
+
+      if (! word.empty() && 'a' <= word.front() && word.front() <= 'z') add(FIRST_LETTER + word.front() - 'a');
+      if (! word.empty() && 'a' <= word.back() && word.back() <= 'z') add(LAST_LETTER + word.back() - 'a');
+
+      add(LENGTH + std::min<size_t>(word.size(), 16) - (word.empty() ? 0 : 1));
+      add(VOWELS + std::min(vowels, 5u));
+      if (doubled) add(DOUBLE_LETTER);
+      add(SUM_PARITY + sum % 2);
+    }
+
+    void add(int feature)
+    {
+      indices[size++] = feature;
+    }
+  };
+
+  /**
+   *  Per-feature counts of accepted and rejected guesses.
+   */
+  struct FeatureCounts
+  {
+    std::array<uint32_t, FEATURES> accepted {};
+    std::array<uint32_t, FEATURES> rejected {};
+
+    void observe(std::string_view word, bool accept)
+    {
+      Features features {word};
+      for (size_t i = 0; i < features.size; i++)
+      {
+        (accept ? accepted : rejected)[features.indices[i]]++;
+      }
+    }
+  };
+
+  /**
+   *  Guesses uniformly at random and always predicts the more common decision so far.
+   */
+  class RandomAgent : public Agent
+  {
+    public:
+
+      using Agent::Agent;
+
+      virtual Id choose(std::mt19937_64 & rng) override
+      {
+        return draw(rng);
+      }
+
+      virtual std::string name() const override
+      {
+        return "random";
+      }
+
+      virtual bool predict(Id word) const override
+      {
+        return m_accepted > m_rejected;
+      }
+  };
+
+  /**
+   *  Guesses uniformly at random and predicts with the single feature (or its negation) that best
+   *  explains the decisions seen so far.
+   */
+  class GreedyAgent : public Agent
+  {
+    public:
+
+      using Agent::Agent;
+
+      virtual Id choose(std::mt19937_64 & rng) override
+      {
+        return draw(rng);
+      }
+
+      virtual std::string name() const override
+      {
+        return "greedy";
+      }
+
+      virtual void observe(Id word, bool accepted) override
+      {
+        Agent::observe(word, accepted);
+        m_counts.observe(m_dictionary.word(word), accepted);
+      }
+
+      virtual bool predict(Id word) const override
+      {
+        // Start from the constant hypotheses, then try "accept iff present" and "accept iff absent" per feature.
+
+        size_t best = std::max(m_accepted, m_rejected);
+        int feature = -1;
+        bool present = m_accepted > m_rejected;
+
+        for (int f = 0; f < FEATURES; f++)
+        {
+          size_t when_present = m_counts.accepted[f] + (m_rejected - m_counts.rejected[f]);
+          size_t when_absent = m_counts.rejected[f] + (m_accepted - m_counts.accepted[f]);
+
+          if (when_present > best)
+          {
+            best = when_present;
+            feature = f;
+            present = true;
+          }
+
+          if (when_absent > best)
+          {
+            best = when_absent;
+            feature = f;
+            present = false;
+          }
+        }
+
+        if (feature < 0)
+        {
+          return present;
+        }
+
+        Features features {m_dictionary.word(word)};
+        bool has = std::find(features.indices.begin(), features.indices.begin() + features.size, feature)
+          != features.indices.begin() + features.size;
+
+        return has == present;
+      }
+
+    private:
+
+      FeatureCounts m_counts;
+  };
+
+  /**
+   *  Keeps every hypothesis the greedy agent considers, each weighted by how few decisions it got wrong, and
+   *  predicts by weighted vote. For its first guesses it picks, out of a handful of candidates, the word the
+   *  hypotheses disagree on the most, so that every early guess rules out as many hypotheses as possible.
+   */
+  class EntropyAgent : public Agent
+  {
+    public:
+
+      using Agent::Agent;
+
+      virtual Id choose(std::mt19937_64 & rng) override
+      {
+        if (m_accepted + m_rejected >= 12)
+        {
+          return draw(rng);
+        }
+
+        Id best = draw(rng);
+        double best_margin = std::abs(vote(best) - 0.5);
+
+        for (int i = 1; i < 32; i++)
+        {
+          Id candidate = draw(rng);
+          double margin = std::abs(vote(candidate) - 0.5);
+
+          if (margin < best_margin)
+          {
+            best = candidate;
+            best_margin = margin;
+          }
+        }
+
+        return best;
+      }
+
+      virtual std::string name() const override
+      {
+        return "entropy";
+      }
+
+      virtual void observe(Id word, bool accepted) override
+      {
+        Agent::observe(word, accepted);
+        m_counts.observe(m_dictionary.word(word), accepted);
+      }
+
+      virtual bool predict(Id word) const override
+      {
+        return vote(word) > 0.5;
+      }
+
+    private:
+
+      /**
+       *  Returns the weighted fraction of hypotheses that accept the word.
+       */
+      double vote(Id word) const
+      {
+        Features features {m_dictionary.word(word)};
+        std::array<bool, FEATURES> has {};
+
+        for (size_t i = 0; i < features.size; i++)
+        {
+          has[features.indices[i]] = true;
+        }
+
+        // Hypotheses are "accept always", "reject always", and "accept iff present" and "accept iff absent"
+        // per feature; each is weighted by e^-(errors - fewest errors).
+
+        size_t fewest = std::min(m_accepted, m_rejected);
+        for (int f = 0; f < FEATURES; f++)
+        {
+          fewest = std::min(fewest, errors(f, true));
+          fewest = std::min(fewest, errors(f, false));
+        }
+
+        double accept = std::exp(-(double) (m_rejected - fewest));
+        double total = accept + std::exp(-(double) (m_accepted - fewest));
+
+        for (int f = 0; f < FEATURES; f++)
+        {
+          double present = std::exp(-(double) (errors(f, true) - fewest));
+          double absent = std::exp(-(double) (errors(f, false) - fewest));
+
+          accept += has[f] ? present : absent;
+          total += present + absent;
+        }
+
+        return accept / total;
+      }
+
+      /**
+       *  Returns the number of decisions that "accept iff the feature is present (or absent)" got wrong.
+       */
+      size_t errors(int f, bool present) const
+      {
+        return present
+          ? m_counts.rejected[f] + (m_accepted - m_counts.accepted[f])
+          : m_counts.accepted[f] + (m_rejected - m_counts.rejected[f]);
+      }
+
+      FeatureCounts m_counts;
+  };
+}
+
+Agent::Agent(const Dictionary & dictionary)
+  : m_dictionary {dictionary}
+{}
+
+Agent::Id Agent::draw(std::mt19937_64 & rng) const
+{
+  std::uniform_int_distribution<Id> pick {0, (Id) m_dictionary.size() - 1};
+  Id id = pick(rng);
+
+  while (m_guessed.count(id) > 0 && m_guessed.size() < m_dictionary.size())
+  {
+    id = pick(rng);
+  }
+
+  return id;
+}
+
+std::unique_ptr<Agent> Agent::make(const std::string & name, const Dictionary & dictionary)
+{
+  if (name == "random") return std::make_unique<RandomAgent>(dictionary);
+  if (name == "greedy") return std::make_unique<GreedyAgent>(dictionary);
+  if (name == "entropy") return std::make_unique<EntropyAgent>(dictionary);
+
+  THROW_ERROR("There is no agent named '", name, "'.");
+}
+
+const std::vector<std::string> & Agent::names()
+{
+  static const std::vector<std::string> names_ {"random", "greedy", "entropy"};
+  return names_;
+}
+
+void Agent::observe(Id word, bool accepted)
+{
+  m_guessed.insert(word);
+  (accepted ? m_accepted : m_rejected)++;
+}
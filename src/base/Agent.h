@@ -0,0 +1,75 @@
+
+#ifndef PQ_AGENT_H_
+#define PQ_AGENT_H_
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Dictionary.h"
+
+/**
+ *  A simulated guesser that plays one game against a rule.
+ *
+ *  Each turn the agent chooses an unguessed dictionary word, predicts whether the rule will accept it, and is
+ *  then told the rule's actual decision. A game is solved once the agent has predicted enough decisions in a row.
+ */ 
+class Agent
+{
+  public:
+
+    using Id = Dictionary::Id;
+
+    /**
+     *  Constructs an agent that draws words from the given dictionary.
+     */ 
+    explicit Agent(const Dictionary & dictionary);
+
+    virtual ~Agent() = default;
+
+    /**
+     *  Returns the names of the built-in agents.
+     */ 
+    static const std::vector<std::string> & names();
+
+    /**
+     *  Constructs the built-in agent with the given name; throws an error if there is none.
+     */ 
+    static std::unique_ptr<Agent> make(const std::string & name, const Dictionary & dictionary);
+
+    /**
+     *  Chooses the next word to guess.
+     */ 
+    virtual Id choose(std::mt19937_64 & rng) = 0;
+
+    /**
+     *  Returns a name or identifier for the agent.
+     */ 
+    virtual std::string name() const = 0;
+
+    /**
+     *  Records the rule's decision on a guessed word.
+     */ 
+    virtual void observe(Id word, bool accepted);
+
+    /**
+     *  Predicts whether the rule accepts the word.
+     */ 
+    virtual bool predict(Id word) const = 0;
+
+  protected:
+
+    /**
+     *  Draws a word that has not been guessed yet.
+     */ 
+    Id draw(std::mt19937_64 & rng) const;
+
+    const Dictionary &     m_dictionary;
+    std::unordered_set<Id> m_guessed;
+    size_t                 m_accepted {0};
+    size_t                 m_rejected {0};
+};
+
+#endif
@@ -0,0 +1,332 @@
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <set>
+
+#include "Analysis.h"
+#include "Bitmap.h"
+#include "Dictionary.h"
+#include "Job.h"
+#include "Logging.h"
+#include "Parallel.h"
+#include "RuleCache.h"
+#include "Utf8.h"
+#include "Watchdog.h"
+
+namespace
+{
+  constexpr unsigned sum_width = 20;
+
+  /**
+   *  The histogram bins of every breakdown, laid out as ranges of one flat array.
+   */
+  enum Bin
+  {
+    LENGTH = 0,
+    SUM = LENGTH + 16,
+    FIRST_LETTER = SUM + 16,
+    LAST_LETTER = FIRST_LETTER + 26,
+    HAS_LETTER = LAST_LETTER + 26,
+    VOWELS = HAS_LETTER + 26,
+    BINS = VOWELS + 7
+  };
+
+  /**
+   *  One worker's histograms of all words and of the accepted ones.
+   */
+  struct Tally
+  {
+    std::array<uint32_t, BINS> words    {};
+    std::array<uint32_t, BINS> accepted {};
+
+    void count(std::string_view word, bool accept)
+    {
+      uint32_t letters = 0;
+      unsigned vowels = 0;
+      unsigned sum = 0;
+      int first = -1;
+      int last = -1;
+
+      // Letters with diacritics count as their base letter and lengths in grapheme clusters, as in expressions.
+
+      for (size_t at = 0; at < word.size(); )
+      {
+        bool start = at == 0;
+        char32_t ch = (unsigned char) word[at] < 0x80 ? word[at++] : utf8_base(utf8_decode(word, at));
+        int c = (unsigned) (ch - 'a') < 26 ? ch - 'a' : -1;
+
+        if (start) first = c;
+        last = c;
+        if (c < 0) continue;
+
+        letters |= uint32_t {1} << c;
+        vowels += (c == 0 || c == 4 || c == 8 || c == 14 || c == 20);
+        sum += c + 1;
+      }
+
+      add(LENGTH + std::clamp<size_t>(utf8_clusters(word), 1, 16) - 1, accept);
+      add(SUM + std::min(sum / sum_width, 15u), accept);
+      add(VOWELS + std::min(vowels, 6u), accept);
+
+      if (first >= 0) add(FIRST_LETTER + first, accept);
+      if (last >= 0) add(LAST_LETTER + last, accept);
+
+      for (; letters; letters &= letters - 1)
+      {
+        add(HAS_LETTER + __builtin_ctz(letters), accept);
+      }
+    }
+
+    void add(int bin, bool accept)
+    {
+      words[bin]++;
+      accepted[bin] += accept;
+    }
+  };
+
+  /**
+   *  Returns the labels of a range of bins counting up from zero or one, the last of which takes everything above.
+   */
+  std::vector<std::string> numbered(unsigned first, unsigned bins, unsigned width)
+  {
+    std::vector<std::string> labels {};
+    for (unsigned i = 0; i < bins; i++)
+    {
+      unsigned low = first + i * width;
+      if (i + 1 == bins) labels.push_back(std::to_string(low) + "+");
+      else if (width == 1) labels.push_back(std::to_string(low));
+      else labels.push_back(std::to_string(low) + "-" + std::to_string(low + width - 1));
+    }
+
+    return labels;
+  }
+
+  /**
+   *  Returns the labels of the 26 letter bins.
+   */
+  std::vector<std::string> lettered()
+  {
+    std::vector<std::string> labels {};
+    for (char c = 'a'; c <= 'z'; c++)
+    {
+      labels.push_back(std::string (1, c));
+    }
+
+    return labels;
+  }
+}
+
+Analysis::Analysis(const Settings & settings)
+  : m_settings {settings}
+{}
+
+std::ostream & Analysis::format(std::ostream & out) const
+{
+  if (m_rule.empty())
+  {
+    U_LOGW("Nothing has been analyzed yet.");
+    return out;
+  }
+
+  U_LOGI(
+      "'", m_rule, "' accepts ", m_accepted, " of ", m_words, " words (", std::fixed, std::setprecision(1),
+      100.0 * m_accepted / std::max<size_t>(1, m_words), "%), ", m_cached ? "looked up and " : "", "analyzed in ",
+      m_seconds * 1000, " ms.");
+
+  for (const Breakdown & breakdown : m_breakdowns)
+  {
+    out << "\n" << breakdown.feature << ":\n";
+
+    for (size_t i = 0; i < breakdown.labels.size(); i++)
+    {
+      if (breakdown.words[i] == 0) continue;
+
+      double rate = (double) breakdown.accepted[i] / breakdown.words[i];
+      out
+        << "  " << std::setw(7) << std::left << breakdown.labels[i] << " | "
+        << std::setw(6) << std::right << breakdown.words[i] << " words | "
+        << std::setw(5) << std::fixed << std::setprecision(1) << 100 * rate << "% "
+        << std::string (std::lround(20 * rate), '#') << "\n";
+    }
+  }
+
+  out << "\nmost correlated with acceptance:\n";
+  if (m_correlations.empty())
+  {
+    out << "  (nothing, since the rule decides every word the same way)\n";
+  }
+
+  for (const Correlation & correlation : m_correlations)
+  {
+    out
+      << "  " << std::setw(6) << std::right << std::showpos << std::fixed << std::setprecision(3) << correlation.phi
+      << std::noshowpos << "  " << correlation.feature << " = " << correlation.label << " ("
+      << std::setprecision(1) << 100.0 * correlation.accepted / correlation.words << "% of "
+      << correlation.words << " words)\n";
+  }
+
+  auto join = [](const std::vector<std::string> & words)
+  {
+    std::string joined {};
+    for (const std::string & word : words)
+    {
+      joined += (joined.empty() ? "" : ", ") + word;
+    }
+
+    return joined.empty() ? "(none)" : joined;
+  };
+
+  out << "\naccepted: " << join(m_samples[1]) << "\nrejected: " << join(m_samples[0]) << "\n";
+  return out;
+}
+
+bool Analysis::run(const Rule & rule, const History & history)
+{
+  Watchdog & watchdog = Watchdog::instance();
+  const Dictionary & dictionary = Dictionary::instance();
+  auto start = std::chrono::steady_clock::now();
+
+  // A pure rule's cached decisions stand in for evaluating it; other rules are evaluated during the pass.
+
+  const Bitmap * cached = rule.pure() ? RuleCache::instance().find(rule) : nullptr;
+  Bitmap accepted = cached ? * cached : Bitmap {dictionary.size()};
+
+  std::vector<Tally> tallies (concurrency());
+  std::atomic<bool> aborted {! cached && watchdog.quarantined(rule)};
+  Job::expect(accepted.words());
+
+  parallel_for(accepted.words(), [&](size_t begin, size_t end, size_t worker)
+  {
+    Tally & tally = tallies[worker];
+    std::string word {};
+    Watchdog::Meter meter = watchdog.meter(rule);
+
+    for (size_t k = begin; k < end && ! aborted; k++)
+    {
+      uint64_t bits = cached ? accepted.word(k) : 0;
+      size_t last = std::min<size_t>(64 * k + 64, dictionary.size());
+
+      for (size_t id = 64 * k; id < last; id++)
+      {
+        std::string_view view = dictionary.word(id);
+        if (! cached)
+        {
+          word.assign(view);
+          bits |= (uint64_t) meter.evaluate(word, history).accepted << (id % 64);
+        }
+
+        tally.count(view, bits >> (id % 64) & 1);
+      }
+
+      if (! cached)
+      {
+        accepted.word(k, bits);
+        if (meter.quarantined()) aborted = true;
+      }
+
+      Job::checkpoint();
+      Job::advance(1);
+    }
+  }, 64);
+
+  if (aborted)
+  {
+    return false;
+  }
+
+  Tally total {};
+  for (const Tally & tally : tallies)
+  {
+    for (size_t bin = 0; bin < BINS; bin++)
+    {
+      total.words[bin] += tally.words[bin];
+      total.accepted[bin] += tally.accepted[bin];
+    }
+  }
+
+  m_rule = rule.name();
+  m_cached = cached;
+  m_words = dictionary.size();
+  m_accepted = accepted.count();
+
+  struct Layout
+  {
+    const char *             feature;
+    int                      first;
+    std::vector<std::string> labels;
+  };
+
+  const Layout layouts[] {
+    {"length",       LENGTH,       numbered(1, 16, 1)},
+    {"a1z26 sum",    SUM,          numbered(0, 16, sum_width)},
+    {"first letter", FIRST_LETTER, lettered()},
+    {"last letter",  LAST_LETTER,  lettered()},
+    {"contains",     HAS_LETTER,   lettered()},
+    {"vowels",       VOWELS,       numbered(0, 7, 1)},
+  };
+
+  m_breakdowns.clear();
+  m_correlations.clear();
+
+  double n = m_words;
+  double a = m_accepted;
+
+  for (const Layout & layout : layouts)
+  {
+    Breakdown breakdown {layout.feature, layout.labels, {}, {}};
+
+    for (size_t i = 0; i < layout.labels.size(); i++)
+    {
+      uint32_t words = total.words[layout.first + i];
+      uint32_t hits = total.accepted[layout.first + i];
+      breakdown.words.push_back(words);
+      breakdown.accepted.push_back(hits);
+
+      // Every bin is a yes-or-no feature of a word, so its correlation with acceptance is a phi coefficient.
+
+      double spread = words * (n - words) * a * (n - a);
+      if (spread > 0)
+      {
+        double phi = (hits * n - words * a) / std::sqrt(spread);
+        m_correlations.push_back({layout.feature, layout.labels[i], words, hits, phi});
+      }
+    }
+
+    m_breakdowns.push_back(std::move(breakdown));
+  }
+
+  auto strongest = [](const Correlation & x, const Correlation & y) { return std::abs(x.phi) > std::abs(y.phi); };
+  size_t shown = std::min(m_settings.correlated, m_correlations.size());
+  std::partial_sort(m_correlations.begin(), m_correlations.begin() + shown, m_correlations.end(), strongest);
+  m_correlations.resize(shown);
+
+  // Draw the samples at random, moving on from each draw to the next word of the wanted kind.
+
+  std::mt19937_64 rng {m_settings.seed};
+  std::set<size_t> chosen {};
+
+  for (bool want : {true, false})
+  {
+    m_samples[want].clear();
+    if ((want ? m_accepted : m_words - m_accepted) == 0) continue;
+
+    for (size_t tries = 0; tries < 16 * m_settings.samples && m_samples[want].size() < m_settings.samples; tries++)
+    {
+      size_t id = rng() % m_words;
+      while (accepted.test(id) != want)
+      {
+        id = (id + 1) % m_words;
+      }
+
+      if (chosen.insert(id).second) m_samples[want].emplace_back(dictionary.word(id));
+    }
+  }
+
+  m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
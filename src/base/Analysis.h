@@ -0,0 +1,88 @@
+
+#ifndef PQ_ANALYSIS_H_
+#define PQ_ANALYSIS_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "History.h"
+#include "Rule.h"
+
+/**
+ *  Characterizes a rule by what it accepts over the whole dictionary: the accept rate broken down by length,
+ *  a1z26 sum, first and last letter, letters present and vowel count, the feature values most correlated with
+ *  acceptance, and a balanced sample of accepted and rejected words.
+ *
+ *  The dictionary is split across workers, each filling histograms of its own, which are merged at the end, so
+ *  the report costs a single pass over the words. A pure rule whose decisions are cached is not even evaluated.
+ */ 
+class Analysis
+{
+  public:
+
+    /**
+     *  The knobs of an analysis.
+     */ 
+    struct Settings
+    {
+      size_t   samples    {8};
+      size_t   correlated {10};
+      uint64_t seed       {1};
+    };
+
+    /**
+     *  The dictionary words counted by the values of one feature, and how many of each the rule accepted.
+     */ 
+    struct Breakdown
+    {
+      std::string              feature;
+      std::vector<std::string> labels;
+      std::vector<uint32_t>    words;
+      std::vector<uint32_t>    accepted;
+    };
+
+    /**
+     *  One feature value and its phi coefficient with acceptance, from -1 (exactly the rejected words have it) to
+     *  1 (exactly the accepted words have it).
+     */ 
+    struct Correlation
+    {
+      std::string feature;
+      std::string label;
+      uint32_t    words    {0};
+      uint32_t    accepted {0};
+      double      phi      {0};
+    };
+
+    /**
+     *  Constructs an analysis with the given settings.
+     */ 
+    explicit Analysis(const Settings & settings);
+
+    /**
+     *  Prints the report.
+     */ 
+    std::ostream & format(std::ostream & out) const;
+
+    /**
+     *  Evaluates the rule over the dictionary against the history and gathers the report. Returns false if the
+     *  rule got quarantined meanwhile.
+     */ 
+    bool run(const Rule & rule, const History & history);
+
+  private:
+
+    Settings                 m_settings;
+    std::string              m_rule;
+    std::vector<Breakdown>   m_breakdowns;
+    std::vector<Correlation> m_correlations;
+    std::vector<std::string> m_samples[2];
+    size_t                   m_words    {0};
+    size_t                   m_accepted {0};
+    bool                     m_cached   {false};
+    double                   m_seconds  {0};
+};
+
+#endif
@@ -0,0 +1,201 @@
+
+#include <algorithm>
+#include <bit>
+
+#include "Bitmap.h"
+#include "Error.h"
+
+namespace
+{
+  // A marker word holds the fill bit in bit 63, the run of fill words in bits 32 to 62, and the number of
+  // literal words that follow it in bits 0 to 31.
+
+  constexpr uint64_t max_run = (uint64_t {1} << 31) - 1;
+  constexpr uint64_t max_literals = (uint64_t {1} << 32) - 1;
+
+  void check_sizes(size_t a, size_t b)
+  {
+    if (a != b)
+    {
+      THROW_ERROR("Cannot combine bitmaps of ", a, " and ", b, " bits.");
+    }
+  }
+}
+
+Bitmap::Bitmap(size_t size)
+  : m_size {size}
+  , m_words ((size + 63) / 64)
+{}
+
+std::vector<uint64_t> Bitmap::compress() const
+{
+  std::vector<uint64_t> out {};
+  size_t k = 0;
+
+  while (k < m_words.size())
+  {
+    uint64_t fill = m_words[k] == ~uint64_t {0} ? 1 : 0;
+    uint64_t run = 0;
+    while (k < m_words.size() && run < max_run && m_words[k] == (fill ? ~uint64_t {0} : 0))
+    {
+      run++;
+      k++;
+    }
+
+    size_t marker = out.size();
+    out.push_back(0);
+
+    uint64_t literals = 0;
+    while (k < m_words.size() && literals < max_literals && m_words[k] != 0 && m_words[k] != ~uint64_t {0})
+    {
+      out.push_back(m_words[k++]);
+      literals++;
+    }
+
+    out[marker] = fill << 63 | run << 32 | literals;
+  }
+
+  return out;
+}
+
+size_t Bitmap::count() const
+{
+  size_t count = 0;
+  for (uint64_t bits : m_words)
+  {
+    count += std::popcount(bits);
+  }
+
+  return count;
+}
+
+Bitmap Bitmap::decompress(size_t size, const uint64_t * data, size_t length)
+{
+  Bitmap bitmap {size};
+  size_t k = 0;
+  size_t i = 0;
+
+  while (i < length)
+  {
+    uint64_t marker = data[i++];
+    uint64_t fill = marker >> 63 ? ~uint64_t {0} : 0;
+    uint64_t run = (marker >> 32) & max_run;
+    uint64_t literals = marker & max_literals;
+
+    if (run > bitmap.m_words.size() - k || literals > bitmap.m_words.size() - k - run || literals > length - i)
+    {
+      THROW_ERROR("The compressed bitmap overruns its ", size, " bits.");
+    }
+
+    std::fill_n(bitmap.m_words.begin() + k, run, fill);
+    k += run;
+
+    std::copy_n(data + i, literals, bitmap.m_words.begin() + k);
+    k += literals;
+    i += literals;
+  }
+
+  if (k != bitmap.m_words.size() || (size % 64 && bitmap.m_words.back() >> (size % 64)))
+  {
+    THROW_ERROR("The compressed bitmap does not fill its ", size, " bits.");
+  }
+
+  return bitmap;
+}
+
+size_t Bitmap::next(size_t from) const
+{
+  size_t k = from / 64;
+  if (k >= m_words.size())
+  {
+    return m_size;
+  }
+
+  uint64_t bits = m_words[k] & (~uint64_t {0} << (from % 64));
+  while (bits == 0)
+  {
+    if (++k == m_words.size()) return m_size;
+    bits = m_words[k];
+  }
+
+  return k * 64 + std::countr_zero(bits);
+}
+
+void Bitmap::reset(size_t i)
+{
+  m_words[i / 64] &= ~(uint64_t {1} << (i % 64));
+}
+
+void Bitmap::set(size_t i)
+{
+  m_words[i / 64] |= uint64_t {1} << (i % 64);
+}
+
+size_t Bitmap::size() const
+{
+  return m_size;
+}
+
+Bitmap & Bitmap::subtract(const Bitmap & other)
+{
+  check_sizes(m_size, other.m_size);
+  for (size_t k = 0; k < m_words.size(); k++)
+  {
+    m_words[k] &= ~other.m_words[k];
+  }
+
+  return * this;
+}
+
+bool Bitmap::test(size_t i) const
+{
+  return (m_words[i / 64] >> (i % 64)) & 1;
+}
+
+uint64_t Bitmap::word(size_t k) const
+{
+  return m_words[k];
+}
+
+void Bitmap::word(size_t k, uint64_t bits)
+{
+  m_words[k] = bits;
+}
+
+size_t Bitmap::words() const
+{
+  return m_words.size();
+}
+
+Bitmap & Bitmap::operator&=(const Bitmap & other)
+{
+  check_sizes(m_size, other.m_size);
+  for (size_t k = 0; k < m_words.size(); k++)
+  {
+    m_words[k] &= other.m_words[k];
+  }
+
+  return * this;
+}
+
+Bitmap & Bitmap::operator|=(const Bitmap & other)
+{
+  check_sizes(m_size, other.m_size);
+  for (size_t k = 0; k < m_words.size(); k++)
+  {
+    m_words[k] |= other.m_words[k];
+  }
+
+  return * this;
+}
+
+Bitmap & Bitmap::operator^=(const Bitmap & other)
+{
+  check_sizes(m_size, other.m_size);
+  for (size_t k = 0; k < m_words.size(); k++)
+  {
+    m_words[k] ^= other.m_words[k];
+  }
+
+  return * this;
+}
@@ -0,0 +1,99 @@
+
+#ifndef PQ_BITMAP_H_
+#define PQ_BITMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ *  A fixed-size set of bits, one per dictionary word, as produced by passes over the whole dictionary.
+ *
+ *  Bits are packed 64 to a word, least significant first, so that a pass can fill one whole word per block of
+ *  64 ids and never share a word with another thread.
+ */ 
+class Bitmap
+{
+  public:
+
+    /**
+     *  Creates a bitmap of the given number of bits, all clear.
+     */ 
+    explicit Bitmap(size_t size = 0);
+
+    /**
+     *  Decodes a bitmap of the given number of bits from the output of compress; throws an error if the data
+     *  is malformed or does not fill the bitmap exactly.
+     */ 
+    static Bitmap decompress(size_t size, const uint64_t * data, size_t length);
+
+    /**
+     *  Encodes the bitmap as runs of all-clear or all-set words, each followed by the words that are neither,
+     *  copied as they are. Sparse and dense bitmaps shrink a lot, and decoding is a single pass.
+     */ 
+    std::vector<uint64_t> compress() const;
+
+    /**
+     *  Returns the number of set bits.
+     */ 
+    size_t count() const;
+
+    /**
+     *  Returns the position of the first set bit at or after the given position, or size() if there is none.
+     */ 
+    size_t next(size_t from) const;
+
+    /**
+     *  Clears the bit at the given position.
+     */ 
+    void reset(size_t i);
+
+    /**
+     *  Sets the bit at the given position.
+     */ 
+    void set(size_t i);
+
+    /**
+     *  Returns the number of bits.
+     */ 
+    size_t size() const;
+
+    /**
+     *  Determines whether the bit at the given position is set.
+     */ 
+    bool test(size_t i) const;
+
+    /**
+     *  Returns the k-th 64-bit word, which holds bits 64k to 64k + 63.
+     */ 
+    uint64_t word(size_t k) const;
+
+    /**
+     *  Sets the k-th 64-bit word. Bits past the end must be clear.
+     */ 
+    void word(size_t k, uint64_t bits);
+
+    /**
+     *  Returns the number of 64-bit words.
+     */ 
+    size_t words() const;
+
+    /**
+     *  Combines the bitmaps bit by bit; both must have the same size.
+     */ 
+    Bitmap & operator&=(const Bitmap & other);
+    Bitmap & operator|=(const Bitmap & other);
+    Bitmap & operator^=(const Bitmap & other);
+
+    /**
+     *  Clears every bit that is set in the other bitmap; both must have the same size.
+     */ 
+    Bitmap & subtract(const Bitmap & other);
+
+  private:
+
+    size_t                m_size;
+    std::vector<uint64_t> m_words;
+};
+
+#endif
@@ -0,0 +1,173 @@
+
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+
+#include "Category.h"
+#include "Logging.h"
+#include "Memory.h"
+#include "String.h"
+
+namespace
+{
+  std::atomic<uint64_t> s_next_id {1};
+
+  uint64_t fnv(std::string_view text, uint64_t hash)
+  {
+    for (char c : text)
+    {
+      hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+    }
+
+    return hash;
+  }
+}
+
+CategoryIndex::CategoryIndex(const Dictionary & dictionary)
+  : m_id {s_next_id++}
+{
+  m_hash = 14695981039346656037ull;
+
+  if (dictionary.source().empty())
+  {
+    return;
+  }
+
+  m_directory = (std::filesystem::path {dictionary.source()}.parent_path() / "categories").string();
+
+  std::error_code error {};
+  for (const auto & entry : std::filesystem::directory_iterator {m_directory, error})
+  {
+    if (! entry.is_regular_file() || entry.path().extension() != ".txt")
+    {
+      continue;
+    }
+
+    std::ifstream fs {entry.path()};
+    if (! fs)
+    {
+      U_LOGW("Skipping the category at '", entry.path().string(), "': could not open it.");
+      continue;
+    }
+
+    std::vector<uint32_t> ids {};
+    size_t unknown = 0;
+    std::string line {};
+
+    while (std::getline(fs, line))
+    {
+      // Lines are stripped of all surrounding whitespace, carriage returns included, as the dictionary's words are.
+
+      std::string_view view {line};
+      while (! view.empty() && std::isspace((unsigned char) view.front())) view.remove_prefix(1);
+      while (! view.empty() && std::isspace((unsigned char) view.back())) view.remove_suffix(1);
+
+      std::string word = lower(std::string {view});
+      if (word.empty() || word[0] == '#')
+      {
+        continue;
+      }
+
+      Dictionary::Id id = dictionary.find(word);
+      if (id == Dictionary::npos)
+      {
+        unknown++;
+        continue;
+      }
+
+      ids.push_back(id);
+    }
+
+    m_categories[entry.path().stem().string()] = Category {WordSet {std::move(ids)}, unknown};
+  }
+
+  // The map is ordered, so the hash does not depend on the order the directory lists its files in.
+
+  for (const auto & [name, category] : m_categories)
+  {
+    m_hash = fnv(name, m_hash);
+    for (uint32_t id : category.words.ids())
+    {
+      m_hash = fnv(std::string_view {reinterpret_cast<const char *>(&id), sizeof(id)}, m_hash);
+    }
+  }
+
+  if (! m_categories.empty())
+  {
+    U_LOGD("Loaded ", m_categories.size(), " word categories from '", m_directory, "'.");
+  }
+}
+
+const std::map<std::string, CategoryIndex::Category, std::less<>> & CategoryIndex::categories() const
+{
+  return m_categories;
+}
+
+const std::string & CategoryIndex::directory() const
+{
+  return m_directory;
+}
+
+const CategoryIndex::Category * CategoryIndex::find(std::string_view name) const
+{
+  auto it = m_categories.find(name);
+  return it == m_categories.end() ? nullptr : &it->second;
+}
+
+uint64_t CategoryIndex::hash() const
+{
+  return m_hash;
+}
+
+uint64_t CategoryIndex::id() const
+{
+  return m_id;
+}
+
+const WordSet * CategoryIndex::resolve(std::string_view expression) const
+{
+  size_t op = expression.find_first_of("|&-");
+  if (op == std::string_view::npos)
+  {
+    const Category * category = find(expression);
+    return category ? &category->words : nullptr;
+  }
+
+  std::lock_guard lock {m_mutex};
+  auto it = m_combined.find(expression);
+  if (it != m_combined.end())
+  {
+    return it->second.get();
+  }
+
+  const Category * first = find(expression.substr(0, op));
+  if (! first)
+  {
+    return nullptr;
+  }
+
+  Memory::Scope charged {Memory::DICTIONARY};
+  WordSet words = first->words;
+  while (op != std::string_view::npos)
+  {
+    size_t next = expression.find_first_of("|&-", op + 1);
+    const Category * operand = find(expression.substr(op + 1, next - op - 1));
+    if (! operand)
+    {
+      return nullptr;
+    }
+
+    switch (expression[op])
+    {
+      case '|': words |= operand->words; break;
+      case '&': words &= operand->words; break;
+      default:  words -= operand->words; break;
+    }
+
+    op = next;
+  }
+
+  auto [inserted, _] = m_combined.emplace(expression, std::make_unique<WordSet>(std::move(words)));
+  return inserted->second.get();
+}
@@ -0,0 +1,88 @@
+
+#ifndef PQ_CATEGORY_H_
+#define PQ_CATEGORY_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "Dictionary.h"
+#include "WordSet.h"
+
+/**
+ *  Named word categories over the dictionary, such as colors, animals or verbs.
+ *
+ *  Every file categories/<name>.txt next to the dictionary's word list defines the category <name>: one word
+ *  per line, trimmed and lowercased like the dictionary's words, with blank lines and lines starting with '#'
+ *  skipped. Each category is stored as a WordSet over dictionary ids; words that are not in the dictionary
+ *  cannot be guessed, so they are only counted.
+ *
+ *  Categories combine with the operators of WordSet, and by name in expressions such as "colors|animals-verbs",
+ *  whose result is computed on first use and kept, so that a rule can test membership in it in constant time.
+ */ 
+class CategoryIndex
+{
+  public:
+
+    /**
+     *  One category: its words, and how many listed words the dictionary lacks.
+     */ 
+    struct Category
+    {
+      WordSet words;
+      size_t  unknown {0};
+    };
+
+    /**
+     *  Builds the index over the given dictionary, loading the categories from the directory next to its source.
+     *  A dictionary without a source has no categories.
+     */ 
+    explicit CategoryIndex(const Dictionary & dictionary);
+
+    /**
+     *  Returns all categories by name.
+     */ 
+    const std::map<std::string, Category, std::less<>> & categories() const;
+
+    /**
+     *  Returns the directory the categories are loaded from, or an empty string.
+     */ 
+    const std::string & directory() const;
+
+    /**
+     *  Returns the category with the given name, or null if there is none.
+     */ 
+    const Category * find(std::string_view name) const;
+
+    /**
+     *  Returns a hash of every category's name and words, which identifies caches that may depend on them.
+     */ 
+    uint64_t hash() const;
+
+    /**
+     *  Returns a number no other index built by this process has, so that a resolved set can be cached per index.
+     */ 
+    uint64_t id() const;
+
+    /**
+     *  Returns the words an expression over category names stands for, or null if it names an unknown category.
+     *  The operators '|', '&' and '-' stand for union, intersection and difference and apply from left to right.
+     */ 
+    const WordSet * resolve(std::string_view expression) const;
+
+  private:
+
+    std::string                                                          m_directory;
+    std::map<std::string, Category, std::less<>>                         m_categories;
+    uint64_t                                                             m_hash {0};
+    uint64_t                                                             m_id;
+
+    mutable std::mutex                                                   m_mutex;
+    mutable std::map<std::string, std::unique_ptr<WordSet>, std::less<>> m_combined;
+};
+
+#endif
@@ -0,0 +1,292 @@
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Corpus.h"
+#include "Error.h"
+#include "Guess.h"
+#include "History.h"
+#include "Job.h"
+#include "Parallel.h"
+#include "Watchdog.h"
+
+namespace
+{
+  constexpr size_t max_distinct = 65536;
+
+  /**
+   *  Determines whether a byte belongs to a token: an ASCII letter, or any byte of a multibyte UTF-8 character.
+   */
+  inline bool is_letter(char c)
+  {
+    unsigned char u = c;
+    return (unsigned char) ((u | 0x20) - 'a') < 26 || u >= 0x80;
+  }
+
+  /**
+   *  Calls f(token, offset) for every token in [from, to), which must not cut through a token.
+   */
+  template<typename F>
+  void for_each_token(const char * data, size_t from, size_t to, F && f)
+  {
+    size_t i = from;
+    while (i < to)
+    {
+      while (i < to && ! is_letter(data[i])) i++;
+
+      size_t start = i;
+      while (i < to && is_letter(data[i])) i++;
+
+      if (i > start) f(std::string_view {data + start, i - start}, start);
+    }
+  }
+
+  /**
+   *  What one worker found so far. Examples are kept in stream order, since each worker sees its tokens in order.
+   */
+  struct Findings
+  {
+    uint64_t                                       tokens   {0};
+    uint64_t                                       accepted {0};
+    std::vector<std::pair<uint64_t, std::string>>  examples;
+    std::unordered_map<std::string, uint64_t>      counts;
+    std::string                                    key;
+
+    void hit(std::string_view token, uint64_t offset, const Corpus::Settings & settings)
+    {
+      accepted++;
+
+      if (examples.size() < settings.examples)
+      {
+        examples.emplace_back(offset, std::string {token});
+      }
+
+      key.assign(token);
+      for (char & c : key)
+      {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+      }
+
+      auto it = counts.find(key);
+      if (it != counts.end()) it->second++;
+      else if (counts.size() < max_distinct) counts.emplace(key, 1);
+    }
+  };
+}
+
+Corpus::Corpus(const std::string & path)
+  : m_path {path}
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    THROW_ERROR("Could not open '", path, "'.");
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || ! S_ISREG(info.st_mode))
+  {
+    close(fd);
+    THROW_ERROR("'", path, "' is not a regular file.");
+  }
+
+  m_size = info.st_size;
+  if (m_size == 0)
+  {
+    close(fd);
+    return;
+  }
+
+  void * mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    THROW_ERROR("Could not map '", path, "' into memory.");
+  }
+
+  madvise(mapping, m_size, MADV_SEQUENTIAL);
+  m_data = static_cast<const char *>(mapping);
+}
+
+Corpus::~Corpus()
+{
+  if (m_data)
+  {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+}
+
+size_t Corpus::boundary(size_t pos) const
+{
+  while (pos > 0 && pos < m_size && is_letter(m_data[pos - 1]))
+  {
+    pos++;
+  }
+
+  return pos;
+}
+
+const std::string & Corpus::path() const
+{
+  return m_path;
+}
+
+void Corpus::release(size_t from, size_t to) const
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t first = (from + page - 1) / page * page;
+  size_t last = to / page * page;
+
+  if (first < last)
+  {
+    madvise(const_cast<char *>(m_data) + first, last - first, MADV_DONTNEED);
+  }
+}
+
+Corpus::Result Corpus::scan(const Rule & rule, const Settings & settings) const
+{
+  Watchdog & watchdog = Watchdog::instance();
+  auto start = std::chrono::steady_clock::now();
+
+  Result result {};
+  result.bytes = m_size;
+
+  size_t workers = settings.sequential ? 1 : concurrency();
+  std::vector<Findings> findings (workers);
+  std::atomic<bool> aborted {watchdog.quarantined(rule)};
+
+  History history {};
+  history.reseed(settings.seed);
+  rule.initialize(history);
+
+  size_t window = std::max<size_t>(1, settings.window);
+  Job::expect(m_size);
+
+  for (size_t base = 0; base < m_size && ! aborted; )
+  {
+    size_t stop = boundary(std::min(m_size, base + window));
+
+    if (settings.sequential)
+    {
+      Findings & mine = findings[0];
+      Watchdog::Meter meter = watchdog.meter(rule);
+      std::string word {};
+      size_t reported = base;
+
+      for_each_token(m_data, base, stop, [&](std::string_view token, size_t offset)
+      {
+        if (aborted) return;
+
+        if (history.count() >= settings.restart)
+        {
+          history = History {};
+          history.reseed(settings.seed);
+          rule.initialize(history);
+          result.restarts++;
+        }
+
+        word.assign(token);
+        Verdict verdict = meter.evaluate(word, history);
+        history.push(Guess {word, verdict.accepted}, verdict.delta);
+
+        mine.tokens++;
+        if (verdict.accepted) mine.hit(token, offset, settings);
+        if (mine.tokens % 4096 == 0)
+        {
+          Job::checkpoint();
+          Job::advance(offset - reported);
+          reported = offset;
+          if (meter.quarantined()) aborted = true;
+        }
+      });
+
+      Job::advance(stop - reported);
+    }
+    else
+    {
+      size_t length = stop - base;
+
+      parallel_for(workers, [&](size_t begin, size_t end, size_t)
+      {
+        for (size_t w = begin; w < end; w++)
+        {
+          Findings & mine = findings[w];
+          Watchdog::Meter meter = watchdog.meter(rule);
+          std::string word {};
+
+          size_t from = boundary(base + length * w / workers);
+          size_t to = boundary(base + length * (w + 1) / workers);
+          size_t reported = from;
+
+          for_each_token(m_data, from, to, [&](std::string_view token, size_t offset)
+          {
+            if (aborted) return;
+
+            word.assign(token);
+            mine.tokens++;
+            if (meter.evaluate(word, history).accepted) mine.hit(token, offset, settings);
+            if (mine.tokens % 4096 == 0)
+            {
+              Job::checkpoint();
+              Job::advance(offset - reported);
+              reported = offset;
+              if (meter.quarantined()) aborted = true;
+            }
+          });
+
+          Job::advance(to - reported);
+        }
+      });
+    }
+
+    release(base, stop);
+    base = stop;
+  }
+
+  result.aborted = aborted;
+
+  // Every worker's examples are its first hits in stream order, so the first hits overall are among them.
+
+  std::vector<std::pair<uint64_t, std::string>> examples {};
+  std::unordered_map<std::string, uint64_t> counts {};
+
+  for (Findings & mine : findings)
+  {
+    result.tokens += mine.tokens;
+    result.accepted += mine.accepted;
+
+    std::move(mine.examples.begin(), mine.examples.end(), std::back_inserter(examples));
+    for (auto & [key, count] : mine.counts)
+    {
+      counts[key] += count;
+    }
+  }
+
+  std::sort(examples.begin(), examples.end());
+  for (size_t i = 0; i < examples.size() && i < settings.examples; i++)
+  {
+    result.examples.push_back(std::move(examples[i].second));
+  }
+
+  result.frequent.assign(counts.begin(), counts.end());
+  auto most = [](const auto & a, const auto & b) { return a.second != b.second ? a.second > b.second : a.first < b.first; };
+  size_t shown = std::min(settings.frequent, result.frequent.size());
+  std::partial_sort(result.frequent.begin(), result.frequent.begin() + shown, result.frequent.end(), most);
+  result.frequent.resize(shown);
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+size_t Corpus::size() const
+{
+  return m_size;
+}
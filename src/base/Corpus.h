@@ -0,0 +1,107 @@
+
+#ifndef PQ_CORPUS_H_
+#define PQ_CORPUS_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Rule.h"
+
+/**
+ *  A large text file, memory-mapped read-only, whose words can be run through a rule.
+ *
+ *  A token is a maximal run of letters, where any byte of a multibyte UTF-8 character counts as a letter. The
+ *  file is scanned in windows of a fixed size. Each window is split into chunks whose boundaries are moved
+ *  forward to the start of a token, the chunks are tokenized and evaluated in parallel, and the window's pages
+ *  are released once it is done. Memory use is therefore bounded by the window and the per-worker tallies,
+ *  however large the file. Tokens are never copied into strings of their own; each worker reuses one buffer.
+ */ 
+class Corpus
+{
+  public:
+
+    /**
+     *  The knobs of a scan.
+     */ 
+    struct Settings
+    {
+      /**
+       *  Whether to play the tokens as one game in stream order, on one thread, so that history-aware rules
+       *  see the tokens before each one. Otherwise every token is evaluated against a new game.
+       */ 
+      bool     sequential {false};
+
+      /**
+       *  The number of tokens after which a sequential game starts over, which bounds the history's size.
+       */ 
+      size_t   restart    {1000000};
+
+      uint64_t seed       {1};
+      size_t   examples   {10};
+      size_t   frequent   {10};
+      size_t   window     {64 << 20};
+    };
+
+    /**
+     *  What a scan found: the counts, the first accepted tokens in stream order, and the most frequently
+     *  accepted tokens (lowercased) with their counts. Frequencies are exact for the first 65536 distinct
+     *  tokens each worker sees, and undercounted for the rest.
+     */ 
+    struct Result
+    {
+      uint64_t                                     bytes    {0};
+      uint64_t                                     tokens   {0};
+      uint64_t                                     accepted {0};
+      uint64_t                                     restarts {0};
+      bool                                         aborted  {false};
+      double                                       seconds  {0};
+      std::vector<std::string>                     examples;
+      std::vector<std::pair<std::string, uint64_t>> frequent;
+    };
+
+    /**
+     *  Maps the file at the given path; throws an error if it cannot be opened.
+     */ 
+    explicit Corpus(const std::string & path);
+
+    ~Corpus();
+
+    Corpus(const Corpus &) = delete;
+    Corpus & operator=(const Corpus &) = delete;
+
+    /**
+     *  Returns the path of the file.
+     */ 
+    const std::string & path() const;
+
+    /**
+     *  Runs every token through the rule. Calls are timed by the watchdog, and the scan stops early, marked as
+     *  aborted, if the rule is quarantined meanwhile.
+     */ 
+    Result scan(const Rule & rule, const Settings & settings) const;
+
+    /**
+     *  Returns the size of the file in bytes.
+     */ 
+    size_t size() const;
+
+  private:
+
+    /**
+     *  Moves the position forward to the start of the next token, unless it already is at one or at a gap.
+     */ 
+    size_t boundary(size_t pos) const;
+
+    /**
+     *  Lets the kernel drop the pages of [from, to) that lie wholly inside it.
+     */ 
+    void release(size_t from, size_t to) const;
+
+    std::string  m_path;
+    const char * m_data {nullptr};
+    size_t       m_size {0};
+};
+
+#endif
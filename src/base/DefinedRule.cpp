@@ -0,0 +1,78 @@
+
+#include <cctype>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DefinedRule.h"
+#include "Error.h"
+#include "Memory.h"
+
+DefinedRule::DefinedRule(const std::string & name, const std::string & source)
+  : m_name {name}
+  , m_expr {source}
+{}
+
+const DefinedRule & DefinedRule::define(const std::string & name, const std::string & source)
+{
+  static std::mutex mutex_;
+  static std::vector<std::unique_ptr<DefinedRule>> defined_;
+  Memory::Scope charged {Memory::RULES};
+
+  for (char c : name)
+  {
+    if (! std::isalnum((unsigned char) c) && c != '_')
+    {
+      THROW_ERROR("The rule name '", name, "' may only contain letters, digits and underscores.");
+    }
+  }
+
+  auto rule = std::make_unique<DefinedRule>(name, source);
+
+  std::lock_guard lock {mutex_};
+  const auto & table = Rules::get_rule_table();
+  auto existing = table.find(name);
+
+  if (existing != table.end() && ! dynamic_cast<const DefinedRule *>(existing->second))
+  {
+    THROW_ERROR("There is already a built-in rule named '", name, "'.");
+  }
+
+  defined_.push_back(std::move(rule));
+  Rules::replace_rule(defined_.back().get());
+  return * defined_.back();
+}
+
+std::string DefinedRule::description() const
+{
+  return "Defined as: " + m_expr.source();
+}
+
+Verdict DefinedRule::evaluate(const std::string & word, const History & history) const
+{
+  // Expressions never write state, so there is no delta to record.
+  return Verdict {m_expr.test(word, history)};
+}
+
+const Expr & DefinedRule::expr() const
+{
+  return m_expr;
+}
+
+void DefinedRule::initialize(History & history) const
+{}
+
+bool DefinedRule::pure() const
+{
+  return m_expr.pure();
+}
+
+std::string DefinedRule::name() const
+{
+  return m_name;
+}
+
+bool DefinedRule::test(const std::string & word, const History & history) const
+{
+  return m_expr.test(word, history);
+}
@@ -0,0 +1,55 @@
+
+#ifndef PQ_DEFINED_RULE_H_
+#define PQ_DEFINED_RULE_H_
+
+#include <string>
+
+#include "Expr.h"
+#include "Rule.h"
+
+/**
+ *  A rule defined at runtime by an expression (see Expr) rather than written in C++. It keeps no state.
+ */ 
+class DefinedRule : public Rule
+{
+  public:
+
+    /**
+     *  Compiles the expression into a rule with the given name; throws an error if it does not compile.
+     */ 
+    DefinedRule(const std::string & name, const std::string & source);
+
+    /**
+     *  Compiles the expression and registers it under the given name, replacing an earlier defined rule of the
+     *  same name. Throws an error if it does not compile or if the name belongs to a built-in rule. Rules
+     *  defined this way live until the program ends.
+     */ 
+    static const DefinedRule & define(const std::string & name, const std::string & source);
+
+    virtual std::string description() const override;
+
+    virtual Verdict evaluate(const std::string & word, const History & history) const override;
+
+    /**
+     *  Returns the compiled expression.
+     */ 
+    const Expr & expr() const;
+
+    virtual void initialize(History & history) const override;
+
+    virtual std::string name() const override;
+
+    /**
+     *  Determines whether the expression reads nothing from the history.
+     */ 
+    virtual bool pure() const override;
+
+    virtual bool test(const std::string & word, const History & history) const override;
+
+  private:
+
+    std::string m_name;
+    Expr        m_expr;
+};
+
+#endif
@@ -0,0 +1,604 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <thread>
+#include <utility>
+
+#include "Category.h"
+#include "Dictionary.h"
+#include "EditIndex.h"
+#include "Encoding.h"
+#include "Error.h"
+#include "Job.h"
+#include "Logging.h"
+#include "Memory.h"
+#include "Parallel.h"
+#include "Phonetic.h"
+#include "String.h"
+#include "SubstringIndex.h"
+
+namespace
+{
+  /**
+   *  Moves the position forward to the start of the next token, unless it already is at one.
+   */
+  size_t token_boundary(const std::string & text, size_t pos)
+  {
+    while (pos > 0 && pos < text.size() && ! std::isspace((unsigned char) text[pos - 1]))
+    {
+      pos++;
+    }
+
+    return pos;
+  }
+
+  constexpr uint64_t idle = UINT64_MAX;
+
+  /**
+   *  One thread's side of the epoch scheme: the epoch it entered its outermost pin at, or idle outside of any,
+   *  and the dictionary it sees meanwhile. Outside of any pin, the thread instead shares ownership of the
+   *  dictionary it was last given. Registered for as long as the thread lives.
+   */
+  struct Reader
+  {
+    std::atomic<uint64_t>             epoch    {idle};
+    const Dictionary *                pinned   {nullptr};
+    size_t                            depth    {0};
+    std::shared_ptr<const Dictionary> unpinned {};
+
+    Reader();
+    ~Reader();
+  };
+
+  /**
+   *  The published dictionary, the retired ones with the epoch they were retired at, and the readers.
+   */
+  struct Versions
+  {
+    std::mutex                                                       mutex;
+    std::shared_ptr<const Dictionary>                                current;
+    std::vector<std::pair<uint64_t, std::shared_ptr<const Dictionary>>> retired;
+
+    std::mutex                                                       readers_mutex;
+    std::vector<Reader *>                                            readers;
+  };
+
+  std::atomic<const Dictionary *> published {nullptr};
+  std::atomic<uint64_t>           epoch     {1};
+  std::atomic<size_t>             retiring  {0};
+
+  /**
+   *  The counter the calling thread reports its waits into, if any; see Dictionary::Waits.
+   */
+  thread_local std::atomic<uint32_t> * t_waits = nullptr;
+
+  /**
+   *  Reports the calling thread as waiting for as long as it lives.
+   */
+  struct Waiting
+  {
+    Waiting()
+    {
+      if (t_waits) t_waits->fetch_add(1);
+    }
+
+    ~Waiting()
+    {
+      if (t_waits) t_waits->fetch_add(1);
+    }
+  };
+
+  /**
+   *  Builds an index as call_once does, reporting the calling thread as waiting only if the index is not built
+   *  yet. The bit of the index in built is set once it is.
+   */
+  template<typename Build>
+  void build_once(std::once_flag & flag, std::atomic<uint32_t> & built, uint32_t bit, Build build)
+  {
+    if (built.load(std::memory_order_acquire) & bit)
+    {
+      return;
+    }
+
+    Waiting waiting {};
+    std::call_once(flag, build);
+    built.fetch_or(bit, std::memory_order_release);
+  }
+
+  Versions & versions()
+  {
+    // Never destroyed, as threads that outlive the program's static objects, such as watchdog runners, still
+    // unregister their readers from it as they exit.
+
+    static Versions & versions_ = * new Versions {};
+    return versions_;
+  }
+
+  Reader & reader()
+  {
+    thread_local Reader reader_ {};
+    return reader_;
+  }
+
+  Reader::Reader()
+  {
+    Versions & v = versions();
+    std::lock_guard lock {v.readers_mutex};
+    v.readers.push_back(this);
+  }
+
+  Reader::~Reader()
+  {
+    Versions & v = versions();
+    std::lock_guard lock {v.readers_mutex};
+    v.readers.erase(std::find(v.readers.begin(), v.readers.end(), this));
+  }
+
+  /**
+   *  Frees the retired dictionaries that no reader can still see: those retired at an epoch no later than the
+   *  oldest one a reader is pinned at. Gives up at once if another thread is publishing or reclaiming.
+   */
+  void reclaim()
+  {
+    Versions & v = versions();
+    std::unique_lock lock {v.mutex, std::try_to_lock};
+    if (! lock)
+    {
+      return;
+    }
+
+    uint64_t oldest = idle;
+    {
+      std::lock_guard readers {v.readers_mutex};
+      for (Reader * r : v.readers)
+      {
+        oldest = std::min(oldest, r->epoch.load());
+      }
+    }
+
+    std::erase_if(v.retired, [oldest](const auto & retired) { return retired.first <= oldest; });
+    retiring = v.retired.size();
+  }
+
+  /**
+   *  Makes the dictionary the one new pins see, and retires the one it replaces. A reader that pins after the
+   *  epoch moves on is certain to see the new dictionary, so the old one is freed once every reader pinned
+   *  before has let go.
+   */
+  void publish(std::shared_ptr<const Dictionary> dictionary)
+  {
+    Versions & v = versions();
+
+    {
+      std::lock_guard lock {v.mutex};
+      std::shared_ptr<const Dictionary> old = std::exchange(v.current, dictionary);
+      published = dictionary.get();
+      uint64_t retired_at = ++epoch;
+
+      if (old)
+      {
+        v.retired.emplace_back(retired_at, std::move(old));
+        retiring = v.retired.size();
+      }
+    }
+
+    reclaim();
+  }
+
+  /**
+   *  The path of the word list, as configured; guarded by its own mutex.
+   */
+  std::string & configured(std::unique_lock<std::mutex> & lock)
+  {
+    static std::mutex mutex_;
+    static std::string path_ {};
+
+    lock = std::unique_lock {mutex_};
+    return path_;
+  }
+
+  /**
+   *  Builds every index of the dictionary on its own background thread. The threads share ownership of
+   *  the dictionary, so they may safely outlive every other reference to it.
+   */
+  void warm(std::shared_ptr<const Dictionary> dictionary)
+  {
+    std::thread {[dictionary](){ dictionary->category_index(); }}.detach();
+    std::thread {[dictionary](){ dictionary->edit_index(); }}.detach();
+    std::thread {[dictionary](){ dictionary->encoding_index(); }}.detach();
+    std::thread {[dictionary](){ dictionary->phonetic_index(); }}.detach();
+    std::thread {[dictionary](){ dictionary->substring_index(); }}.detach();
+  }
+
+  /**
+   *  Gets the background load of the configured dictionary, starting it on first use. Concurrent first callers
+   *  all share the one load, which publishes the dictionary once its words are in.
+   */
+  std::shared_future<void> loading()
+  {
+    // The loading thread is detached and shares the state of the load with every waiter, and the program's own
+    // share is never released, so exiting never waits for the load, even while a waiter is still blocked on it.
+
+    static std::shared_future<void> & future = * []()
+    {
+      auto promise = std::make_shared<std::promise<void>>();
+      auto * future = new std::shared_future<void> {promise->get_future().share()};
+
+      std::thread {[promise]()
+      {
+        try
+        {
+          Memory::Scope charged {Memory::DICTIONARY};
+          std::shared_ptr<const Dictionary> dictionary = Dictionary::load(Dictionary::path());
+          warm(dictionary);
+          publish(dictionary);
+          promise->set_value();
+        }
+        catch (...)
+        {
+          promise->set_exception(std::current_exception());
+        }
+      }}.detach();
+
+      return future;
+    }();
+
+    return future;
+  }
+}
+
+Dictionary::Dictionary(const std::vector<std::string> & words, const std::string & source)
+  : m_source {source}
+{
+  std::vector<std::string> sorted (words.size());
+
+  parallel_for(words.size(), [&](size_t begin, size_t end, size_t)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      sorted[i] = trim(lower(words[i]));
+    }
+  }, 4096);
+
+  sorted.erase(std::remove(sorted.begin(), sorted.end(), ""), sorted.end());
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+  size_t total = 0;
+  for (const std::string & word : sorted)
+  {
+    total += word.size() + 1;
+  }
+
+  m_buffer.reserve(total);
+  m_offsets.reserve(sorted.size() + 1);
+
+  for (const std::string & word : sorted)
+  {
+    m_offsets.push_back(m_buffer.size());
+    m_buffer.append(word);
+    m_buffer.push_back('\n');
+  }
+  m_offsets.push_back(m_buffer.size());
+
+  m_hash = 14695981039346656037ull;
+  for (char c : m_buffer)
+  {
+    m_hash = (m_hash ^ (unsigned char) c) * 1099511628211ull;
+  }
+
+  // Views into the buffer stay valid because it is never resized again.
+
+  m_ids.reserve(sorted.size());
+  for (Id id = 0; id < sorted.size(); id++)
+  {
+    m_ids.emplace(word(id), id);
+  }
+}
+
+Dictionary::~Dictionary() = default;
+
+Dictionary::Pin::Pin()
+{
+  reader().depth++;
+}
+
+Dictionary::Pin::Pin(const Dictionary * adopted)
+  : m_adopted {true}
+{
+  Reader & r = reader();
+  m_previous = r.pinned;
+  r.depth++;
+  if (adopted) r.pinned = adopted;
+}
+
+Dictionary::Pin::~Pin()
+{
+  Reader & r = reader();
+  if (m_adopted) r.pinned = m_previous;
+  if (--r.depth > 0) return;
+
+  r.pinned = nullptr;
+  r.epoch.store(idle);
+  if (retiring.load(std::memory_order_relaxed) > 0) reclaim();
+}
+
+Dictionary::Waits::Waits(std::atomic<uint32_t> & counter)
+  : m_previous {t_waits}
+{
+  t_waits = &counter;
+}
+
+Dictionary::Waits::~Waits()
+{
+  t_waits = m_previous;
+}
+
+const Dictionary & Dictionary::instance()
+{
+  Reader & r = reader();
+  if (r.pinned)
+  {
+    return * r.pinned;
+  }
+
+  if (! published.load())
+  {
+    Waiting waiting {};
+    loading().get();
+  }
+
+  if (r.depth == 0)
+  {
+    // Taking a share only when the dictionary changed keeps this lock off the common path.
+
+    if (r.unpinned.get() != published.load())
+    {
+      Versions & v = versions();
+      std::lock_guard lock {v.mutex};
+      r.unpinned = v.current;
+    }
+
+    return * r.unpinned;
+  }
+
+  // Entering the epoch before reading the pointer means that a dictionary retired after this read is not freed
+  // until the pin is let go.
+
+  r.epoch.store(epoch.load());
+  r.pinned = published.load();
+  return * r.pinned;
+}
+
+std::unique_ptr<Dictionary> Dictionary::load(const std::string & path)
+{
+  std::ifstream fs {path, std::ios::binary | std::ios::ate};
+  if (! fs)
+  {
+    THROW_ERROR("Could not open the dictionary at '", path, "'.");
+  }
+
+  std::string text (fs.tellg(), '\0');
+  fs.seekg(0);
+  fs.read(text.data(), text.size());
+
+  // Tokenize in parallel; every chunk boundary is moved forward to the start of a token, so that no token
+  // is split across two chunks.
+
+  size_t chunks = concurrency();
+  std::vector<std::vector<std::string>> parts (chunks);
+
+  parallel_for(chunks, [&](size_t begin, size_t end, size_t)
+  {
+    for (size_t c = begin; c < end; c++)
+    {
+      size_t from = token_boundary(text, text.size() * c / chunks);
+      size_t to = token_boundary(text, text.size() * (c + 1) / chunks);
+
+      while (from < to)
+      {
+        while (from < to && std::isspace((unsigned char) text[from])) from++;
+
+        size_t stop = from;
+        while (stop < to && ! std::isspace((unsigned char) text[stop])) stop++;
+
+        if (stop > from) parts[c].emplace_back(text, from, stop - from);
+        from = stop;
+      }
+    }
+  });
+
+  std::vector<std::string> words {};
+  for (std::vector<std::string> & part : parts)
+  {
+    std::move(part.begin(), part.end(), std::back_inserter(words));
+  }
+
+  return std::make_unique<Dictionary>(words, path);
+}
+
+std::string Dictionary::path()
+{
+  std::unique_lock<std::mutex> lock {};
+  std::string & path_ = configured(lock);
+
+  if (path_.empty())
+  {
+    const char * variable = std::getenv("PQ_DICTIONARY");
+    path_ = variable && * variable ? variable : "data/dictionary.txt";
+  }
+
+  return path_;
+}
+
+void Dictionary::path(const std::string & path)
+{
+  std::unique_lock<std::mutex> lock {};
+  configured(lock) = path;
+}
+
+const Dictionary * Dictionary::pinned()
+{
+  return reader().pinned;
+}
+
+void Dictionary::preload()
+{
+  loading();
+}
+
+bool Dictionary::ready()
+{
+  return loading().wait_for(std::chrono::seconds {0}) == std::future_status::ready;
+}
+
+std::shared_ptr<const Dictionary> Dictionary::reload(const std::string & path)
+{
+  Memory::Scope charged {Memory::DICTIONARY};
+
+  // The first load must not publish over a reload that finished before it.
+
+  loading().wait();
+
+  std::shared_ptr<const Dictionary> dictionary = load(path);
+  Job::checkpoint();
+
+  // Readers must never wait for an index, so all of them are built before the dictionary is published.
+
+  std::function<void()> builds[] {
+    [&](){ dictionary->category_index(); },
+    [&](){ dictionary->edit_index(); },
+    [&](){ dictionary->encoding_index(); },
+    [&](){ dictionary->phonetic_index(); },
+    [&](){ dictionary->substring_index(); },
+  };
+
+  parallel_for(std::size(builds), [&](size_t begin, size_t end, size_t)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      builds[i]();
+    }
+  });
+
+  Job::checkpoint();
+  publish(dictionary);
+  Dictionary::path(path);
+  return dictionary;
+}
+
+const std::string & Dictionary::buffer() const
+{
+  return m_buffer;
+}
+
+const CategoryIndex & Dictionary::category_index() const
+{
+  build_once(m_category_once, m_built, 1, [this]()
+  {
+    Memory::Scope charged {Memory::DICTIONARY};
+    m_category = std::make_unique<CategoryIndex>(* this);
+  });
+  return * m_category;
+}
+
+bool Dictionary::contains(std::string_view word) const
+{
+  return m_ids.find(word) != m_ids.end();
+}
+
+const EditIndex & Dictionary::edit_index() const
+{
+  build_once(m_edit_once, m_built, 2, [this]()
+  {
+    Memory::Scope charged {Memory::DICTIONARY};
+    m_edit = std::make_unique<EditIndex>(* this);
+  });
+  return * m_edit;
+}
+
+const EncodingIndex & Dictionary::encoding_index() const
+{
+  build_once(m_encoding_once, m_built, 4, [this]()
+  {
+    Memory::Scope charged {Memory::DICTIONARY};
+    m_encoding = std::make_unique<EncodingIndex>(* this);
+  });
+  return * m_encoding;
+}
+
+uint64_t Dictionary::hash() const
+{
+  return m_hash;
+}
+
+Dictionary::Id Dictionary::find(std::string_view word) const
+{
+  auto it = m_ids.find(word);
+  return it == m_ids.end() ? npos : it->second;
+}
+
+uint32_t Dictionary::offset(Id id) const
+{
+  return m_offsets[id];
+}
+
+const PhoneticIndex & Dictionary::phonetic_index() const
+{
+  build_once(m_phonetic_once, m_built, 8, [this]()
+  {
+    Memory::Scope charged {Memory::DICTIONARY};
+    m_phonetic = std::make_unique<PhoneticIndex>(* this);
+  });
+  return * m_phonetic;
+}
+
+size_t Dictionary::size() const
+{
+  return m_offsets.size() - 1;
+}
+
+const std::string & Dictionary::source() const
+{
+  return m_source;
+}
+
+const SubstringIndex & Dictionary::substring_index() const
+{
+  build_once(m_substring_once, m_built, 16, [this]()
+  {
+    Memory::Scope charged {Memory::DICTIONARY};
+    std::string cache = m_source + ".sa";
+
+    if (! m_source.empty())
+    {
+      m_substring = SubstringIndex::map(cache, m_hash);
+    }
+
+    if (! m_substring)
+    {
+      m_substring = std::make_unique<SubstringIndex>(* this);
+
+      try
+      {
+        if (! m_source.empty()) m_substring->save(cache);
+      }
+      catch (Error & e)
+      {
+        U_LOGW("Not caching the substring index: could not write '", cache, "'.");
+      }
+    }
+  });
+
+  return * m_substring;
+}
+
+std::string_view Dictionary::word(Id id) const
+{
+  return std::string_view {m_buffer.data() + m_offsets[id], m_offsets[id + 1] - m_offsets[id] - 1};
+}
@@ -0,0 +1,238 @@
+
+#ifndef PQ_DICTIONARY_H_
+#define PQ_DICTIONARY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class CategoryIndex;
+class EditIndex;
+class EncodingIndex;
+class PhoneticIndex;
+class SubstringIndex;
+
+/**
+ *  An immutable word list in which every word has a dense integer id.
+ *
+ *  Words are trimmed, lowercased and deduplicated on construction; a word's id is its index in sorted order.
+ *  The words are stored back to back in one contiguous buffer, each followed by a newline, so that bulk passes
+ *  can walk the whole dictionary without chasing pointers. Indexes over the dictionary are built on first use.
+ *
+ *  The program's dictionary can be replaced while it runs: reload builds a new one with all of its indexes and
+ *  publishes it with an atomic pointer swap. Readers hold a Pin, under which instance() keeps returning the
+ *  dictionary it first returned, however many reloads happen meanwhile; a replaced dictionary is freed once
+ *  every pin that may have seen it is gone. Pins never block and cost a few thread-local writes.
+ */ 
+class Dictionary
+{
+  public:
+
+    using Id = uint32_t;
+
+    /**
+     *  The id returned for words that are not in the dictionary.
+     */ 
+    static constexpr Id npos = UINT32_MAX;
+
+    /**
+     *  Keeps the dictionary that instance() returns on the calling thread the same, and alive, for as long as
+     *  it lives. Pins nest. A pin can also adopt the dictionary pinned by another thread that outlives it,
+     *  which is how parallel_for shares its caller's dictionary with its workers.
+     */ 
+    class Pin
+    {
+      public:
+
+        Pin();
+
+        explicit Pin(const Dictionary * adopted);
+
+        ~Pin();
+
+        Pin(const Pin &) = delete;
+        Pin & operator=(const Pin &) = delete;
+
+      private:
+
+        const Dictionary * m_previous {nullptr};
+        bool               m_adopted  {false};
+    };
+
+    /**
+     *  Counts the times the calling thread blocks on the dictionary loading or on one of its indexes being built,
+     *  for as long as it lives. The counter goes up once as each wait starts and once as it ends, so it is odd
+     *  while the thread waits; another thread can thus tell time spent waiting for data from time spent working.
+     */ 
+    class Waits
+    {
+      public:
+
+        explicit Waits(std::atomic<uint32_t> & counter);
+
+        ~Waits();
+
+        Waits(const Waits &) = delete;
+        Waits & operator=(const Waits &) = delete;
+
+      private:
+
+        std::atomic<uint32_t> * m_previous;
+    };
+
+    /**
+     *  Builds a dictionary out of the given words. The source, if given, is the path of the word list,
+     *  next to which indexes may be cached.
+     */ 
+    explicit Dictionary(const std::vector<std::string> & words, const std::string & source = "");
+
+    ~Dictionary();
+
+    Dictionary(const Dictionary &) = delete;
+    Dictionary & operator=(const Dictionary &) = delete;
+
+    /**
+     *  Gets the program's dictionary, waiting for it if it is still loading, and starting the load if nothing
+     *  has yet. Under a pin, this is the dictionary the pin first saw. Outside of any pin, it is the one last
+     *  published, which the calling thread keeps alive until it asks again after a reload; as successive calls
+     *  may then disagree, bulk work should only ever run pinned.
+     */ 
+    static const Dictionary & instance();
+
+    /**
+     *  Loads a dictionary from a file of whitespace-separated words, parsing it in parallel chunks.
+     */ 
+    static std::unique_ptr<Dictionary> load(const std::string & path);
+
+    /**
+     *  Returns the path of the word list the program's dictionary is loaded from: the one last set, else the
+     *  PQ_DICTIONARY environment variable, else data/dictionary.txt.
+     */ 
+    static std::string path();
+
+    /**
+     *  Sets the path of the word list; the first load only picks it up if it is set before the load starts.
+     */ 
+    static void path(const std::string & path);
+
+    /**
+     *  Returns the dictionary pinned on the calling thread, or null if there is none yet.
+     */ 
+    static const Dictionary * pinned();
+
+    /**
+     *  Starts loading the configured dictionary on a background thread without waiting for it.
+     *  Once the words are in, its indexes are built on further background threads.
+     */ 
+    static void preload();
+
+    /**
+     *  Determines if the first load of the dictionary has finished.
+     */ 
+    static bool ready();
+
+    /**
+     *  Loads the word list at the path on the calling thread, builds all of its indexes and then publishes
+     *  it as the program's dictionary, from then on the default path. Pins taken before keep seeing the old
+     *  dictionary. Throws an error, leaving the old dictionary in place, if the word list cannot be loaded.
+     */ 
+    static std::shared_ptr<const Dictionary> reload(const std::string & path);
+
+    /**
+     *  Returns the contiguous word buffer; word i occupies [offset(i), offset(i + 1) - 1), followed by a newline.
+     */ 
+    const std::string & buffer() const;
+
+    /**
+     *  Gets the lazily-loaded word categories (see Category.h).
+     */ 
+    const CategoryIndex & category_index() const;
+
+    /**
+     *  Determines if the given normalized word is in the dictionary.
+     */ 
+    bool contains(std::string_view word) const;
+
+    /**
+     *  Gets the lazily-built edit distance index.
+     */ 
+    const EditIndex & edit_index() const;
+
+    /**
+     *  Gets the lazily-built encoded length and hash columns.
+     */ 
+    const EncodingIndex & encoding_index() const;
+
+    /**
+     *  Returns a hash of the dictionary's contents, which identifies caches built over it.
+     */ 
+    uint64_t hash() const;
+
+    /**
+     *  Returns the id of the given normalized word, or npos if it is not in the dictionary.
+     */ 
+    Id find(std::string_view word) const;
+
+    /**
+     *  Returns the offset of the word with the given id into the buffer; offset(size()) is the buffer's length.
+     */ 
+    uint32_t offset(Id id) const;
+
+    /**
+     *  Gets the lazily-built phonetic key index.
+     */ 
+    const PhoneticIndex & phonetic_index() const;
+
+    /**
+     *  Returns the number of words.
+     */ 
+    size_t size() const;
+
+    /**
+     *  Returns the path of the word list the dictionary was loaded from, or an empty string.
+     */ 
+    const std::string & source() const;
+
+    /**
+     *  Gets the lazily-built substring index, which is memory-mapped from the cache next to the source
+     *  when one exists and saved there otherwise.
+     */ 
+    const SubstringIndex & substring_index() const;
+
+    /**
+     *  Returns the word with the given id.
+     */ 
+    std::string_view word(Id id) const;
+
+  private:
+
+    std::string                              m_source;
+    std::string                              m_buffer;
+    uint64_t                                 m_hash;
+    std::vector<uint32_t>                    m_offsets;
+    std::unordered_map<std::string_view, Id> m_ids;
+
+    mutable std::atomic<uint32_t>            m_built {0};
+
+    mutable std::once_flag                   m_category_once;
+    mutable std::unique_ptr<CategoryIndex>   m_category;
+
+    mutable std::once_flag                   m_edit_once;
+    mutable std::unique_ptr<EditIndex>       m_edit;
+
+    mutable std::once_flag                   m_encoding_once;
+    mutable std::unique_ptr<EncodingIndex>   m_encoding;
+
+    mutable std::once_flag                   m_phonetic_once;
+    mutable std::unique_ptr<PhoneticIndex>   m_phonetic;
+
+    mutable std::once_flag                   m_substring_once;
+    mutable std::unique_ptr<SubstringIndex>  m_substring;
+};
+
+#endif
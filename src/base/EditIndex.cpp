@@ -0,0 +1,465 @@
+
+#include <algorithm>
+#include <queue>
+
+#include "EditIndex.h"
+#include "Utf8.h"
+
+namespace
+{
+  constexpr uint32_t none = UINT32_MAX;
+
+  /**
+   *  Decodes the code point at the given offset and advances the offset past it, reading ASCII directly.
+   */
+  char32_t decode(std::string_view word, size_t & at)
+  {
+    return (unsigned char) word[at] < 0x80 ? word[at++] : utf8_decode(word, at);
+  }
+
+  /**
+   *  Decodes the whole word into code points.
+   */
+  std::u32string decode(std::string_view word)
+  {
+    std::u32string points {};
+    for (size_t at = 0; at < word.size(); )
+    {
+      points.push_back(decode(word, at));
+    }
+
+    return points;
+  }
+
+  /**
+   *  Returns the offset just past the code point at the given offset.
+   */
+  size_t step(std::string_view word, size_t at)
+  {
+    decode(word, at);
+    return at;
+  }
+
+  /**
+   *  Hashes a word with the code point at the given offset removed, so that words differing only in that code
+   *  point collide whatever its encoded length.
+   */
+  uint64_t hash_without(std::string_view word, size_t pos, size_t next)
+  {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < word.size(); i++)
+    {
+      if (i == pos) i = next;
+      if (i == word.size()) break;
+      hash = (hash ^ (unsigned char) word[i]) * 1099511628211ull;
+    }
+
+    return hash ^ (pos * 0x9e3779b97f4a7c15ull) ^ ((word.size() - (next - pos)) << 56);
+  }
+
+  /**
+   *  Determines if two words are identical everywhere except in the code point at the given offset.
+   */
+  bool equal_without(std::string_view a, std::string_view b, size_t pos)
+  {
+    return a.substr(0, pos) == b.substr(0, pos)
+      && a.substr(step(a, pos)) == b.substr(step(b, pos));
+  }
+}
+
+EditPattern::EditPattern(std::string_view word)
+  : m_word {word}
+  , m_length {0}
+  , m_peq {}
+{
+  for (size_t at = 0; at < word.size(); m_length++)
+  {
+    char32_t c = decode(word, at);
+    if (m_length >= 64) continue;
+
+    uint64_t bit = uint64_t {1} << m_length;
+    if (c < 0x80)
+    {
+      m_peq[c] |= bit;
+      continue;
+    }
+
+    auto found = std::find_if(m_wide.begin(), m_wide.end(), [&](const auto & wide){ return wide.first == c; });
+    if (found == m_wide.end()) m_wide.emplace_back(c, bit);
+    else found->second |= bit;
+  }
+}
+
+unsigned EditPattern::distance(std::string_view other) const
+{
+  size_t m = m_length;
+
+  if (m == 0)
+  {
+    return decode(other).size();
+  }
+
+  if (m > 64)
+  {
+    std::u32string a = decode(m_word);
+    std::u32string b = decode(other);
+
+    std::vector<unsigned> row (b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) row[j] = j;
+
+    for (size_t i = 1; i <= m; i++)
+    {
+      unsigned diagonal = row[0];
+      row[0] = i;
+
+      for (size_t j = 1; j <= b.size(); j++)
+      {
+        unsigned above = row[j];
+        row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1]) });
+        diagonal = above;
+      }
+    }
+
+    return row[b.size()];
+  }
+
+  uint64_t pv = ~uint64_t {0};
+  uint64_t mv = 0;
+  uint64_t last = uint64_t {1} << (m - 1);
+  unsigned score = m;
+
+  for (size_t at = 0; at < other.size(); )
+  {
+    uint64_t eq = equal(decode(other, at));
+    uint64_t xv = eq | mv;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+
+    if (ph & last) score++;
+    if (mh & last) score--;
+
+    ph = (ph << 1) | 1;
+    mh = mh << 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+
+  return score;
+}
+
+uint64_t EditPattern::equal(char32_t c) const
+{
+  if (c < 0x80)
+  {
+    return m_peq[c];
+  }
+
+  for (auto [wide, mask] : m_wide)
+  {
+    if (wide == c) return mask;
+  }
+
+  return 0;
+}
+
+EditIndex::EditIndex(const Dictionary & dictionary)
+  : m_dictionary {dictionary}
+{
+  std::string_view buffer = dictionary.buffer();
+  std::array<bool, 128> seen {};
+  std::u32string wide {};
+
+  for (size_t at = 0; at < buffer.size(); )
+  {
+    char32_t c = decode(buffer, at);
+    if (c < 0x80) seen[c] = true;
+    else wide.push_back(c);
+  }
+
+  for (char32_t c = 0; c < 0x80; c++)
+  {
+    if (seen[c] && c != '\n') m_alphabet.push_back(c);
+  }
+
+  std::sort(wide.begin(), wide.end());
+  wide.erase(std::unique(wide.begin(), wide.end()), wide.end());
+  m_alphabet.append(wide);
+
+  build_graph();
+  build_tree();
+}
+
+std::span<const EditIndex::Id> EditIndex::adjacent(Id id) const
+{
+  return std::span<const Id> {m_column.data() + m_row[id], m_row[id + 1] - m_row[id]};
+}
+
+void EditIndex::build_graph()
+{
+  size_t n = m_dictionary.size();
+  std::vector<std::pair<Id, Id>> edges {};
+
+  // Insertions and deletions: every word with one code point removed that is itself a word.
+
+  std::string shorter {};
+  for (Id id = 0; id < n; id++)
+  {
+    std::string_view word = m_dictionary.word(id);
+
+    for (size_t pos = 0, previous = 0, next = 0; pos < word.size(); previous = pos, pos = next)
+    {
+      next = step(word, pos);
+      if (pos > 0 && word.substr(previous, pos - previous) == word.substr(pos, next - pos)) continue;
+
+      shorter.assign(word.substr(0, pos));
+      shorter.append(word.substr(next));
+
+      Id other = m_dictionary.find(shorter);
+      if (other != Dictionary::npos)
+      {
+        edges.emplace_back(id, other);
+        edges.emplace_back(other, id);
+      }
+    }
+  }
+
+  // Substitutions: bucket every (word, code point) by the word with that code point blanked out.
+
+  struct Key
+  {
+    uint64_t hash;
+    Id       id;
+    uint32_t pos;
+  };
+
+  std::vector<Key> keys {};
+  keys.reserve(m_dictionary.offset(n));
+
+  for (Id id = 0; id < n; id++)
+  {
+    std::string_view word = m_dictionary.word(id);
+    for (size_t pos = 0, next = 0; pos < word.size(); pos = next)
+    {
+      next = step(word, pos);
+      keys.push_back(Key { hash_without(word, pos, next), id, (uint32_t) pos });
+    }
+  }
+
+  std::sort(keys.begin(), keys.end(), [](const Key & a, const Key & b){ return a.hash < b.hash; });
+
+  for (size_t begin = 0, end = 0; begin < keys.size(); begin = end)
+  {
+    while (end < keys.size() && keys[end].hash == keys[begin].hash) end++;
+
+    for (size_t i = begin; i < end; i++)
+    {
+      for (size_t j = i + 1; j < end; j++)
+      {
+        if (keys[i].pos != keys[j].pos) continue;
+        if (! equal_without(m_dictionary.word(keys[i].id), m_dictionary.word(keys[j].id), keys[i].pos)) continue;
+
+        edges.emplace_back(keys[i].id, keys[j].id);
+        edges.emplace_back(keys[j].id, keys[i].id);
+      }
+    }
+  }
+
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  m_row.assign(n + 1, 0);
+  m_column.reserve(edges.size());
+
+  for (auto [from, to] : edges)
+  {
+    m_row[from + 1]++;
+    m_column.push_back(to);
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    m_row[i + 1] += m_row[i];
+  }
+}
+
+void EditIndex::build_tree()
+{
+  size_t n = m_dictionary.size();
+  if (n == 0) return;
+
+  m_tree.reserve(n);
+  m_tree.push_back(Node { 0, none, none, 0 });
+
+  for (Id id = 1; id < n; id++)
+  {
+    EditPattern pattern {m_dictionary.word(id)};
+    uint32_t at = 0;
+
+    while (true)
+    {
+      uint32_t d = pattern.distance(m_dictionary.word(m_tree[at].id));
+      uint32_t child = m_tree[at].child;
+
+      while (child != none && m_tree[child].distance != d)
+      {
+        child = m_tree[child].sibling;
+      }
+
+      if (child == none)
+      {
+        m_tree.push_back(Node { id, none, m_tree[at].child, d });
+        m_tree[at].child = m_tree.size() - 1;
+        break;
+      }
+
+      at = child;
+    }
+  }
+}
+
+size_t EditIndex::edges() const
+{
+  return m_column.size() / 2;
+}
+
+std::vector<EditIndex::Id> EditIndex::ladder(Id from, Id to) const
+{
+  std::vector<Id> parent (m_dictionary.size(), Dictionary::npos);
+  std::queue<Id> frontier {};
+
+  parent[from] = from;
+  frontier.push(from);
+
+  while (! frontier.empty() && parent[to] == Dictionary::npos)
+  {
+    Id at = frontier.front();
+    frontier.pop();
+
+    for (Id next : adjacent(at))
+    {
+      if (parent[next] != Dictionary::npos) continue;
+
+      parent[next] = at;
+      frontier.push(next);
+    }
+  }
+
+  std::vector<Id> path {};
+  if (parent[to] == Dictionary::npos)
+  {
+    return path;
+  }
+
+  for (Id at = to; at != from; at = parent[at])
+  {
+    path.push_back(at);
+  }
+  path.push_back(from);
+
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+std::vector<EditIndex::Id> EditIndex::neighbors(std::string_view word, unsigned k) const
+{
+  if (k == 0)
+  {
+    Id id = m_dictionary.find(word);
+    return id == Dictionary::npos ? std::vector<Id> {} : std::vector<Id> {id};
+  }
+
+  if (k == 1)
+  {
+    return neighbors_one(word);
+  }
+
+  std::vector<Id> result {};
+  if (m_tree.empty())
+  {
+    return result;
+  }
+
+  EditPattern pattern {word};
+  std::vector<uint32_t> stack {0};
+
+  while (! stack.empty())
+  {
+    const Node & node = m_tree[stack.back()];
+    stack.pop_back();
+
+    unsigned d = pattern.distance(m_dictionary.word(node.id));
+    if (d <= k)
+    {
+      result.push_back(node.id);
+    }
+
+    for (uint32_t child = node.child; child != none; child = m_tree[child].sibling)
+    {
+      if (m_tree[child].distance + k >= d && m_tree[child].distance <= d + k)
+      {
+        stack.push_back(child);
+      }
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+std::vector<EditIndex::Id> EditIndex::neighbors_one(std::string_view word) const
+{
+  std::vector<Id> result {};
+
+  Id self = m_dictionary.find(word);
+  if (self != Dictionary::npos)
+  {
+    std::span<const Id> row = adjacent(self);
+    result.assign(row.begin(), row.end());
+    result.push_back(self);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  // The word is not in the dictionary, so enumerate its one-edit variants instead: delete each of its code
+  // points, and insert or substitute every code point that occurs in the dictionary, so that "cafè" finds "café".
+
+  std::string candidate {};
+  auto probe = [&]()
+  {
+    Id id = m_dictionary.find(candidate);
+    if (id != Dictionary::npos) result.push_back(id);
+  };
+
+  for (size_t pos = 0, next = 0; pos <= word.size(); pos = next)
+  {
+    next = pos < word.size() ? step(word, pos) : pos + 1;
+
+    if (pos < word.size())
+    {
+      candidate.assign(word.substr(0, pos));
+      candidate.append(word.substr(next));
+      probe();
+    }
+
+    for (char32_t c : m_alphabet)
+    {
+      candidate.assign(word.substr(0, pos));
+      utf8_encode(c, candidate);
+      size_t end = candidate.size();
+      candidate.append(word.substr(pos));
+      probe();
+
+      if (pos < word.size() && word.substr(pos, next - pos) != std::string_view {candidate}.substr(pos, end - pos))
+      {
+        candidate.erase(end, next - pos);
+        probe();
+      }
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
@@ -0,0 +1,115 @@
+
+#ifndef PQ_EDIT_INDEX_H_
+#define PQ_EDIT_INDEX_H_
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Dictionary.h"
+
+/**
+ *  A word compiled for repeated Levenshtein distance queries against many other words.
+ *
+ *  Distances count code points, so that replacing "é" with "e" is one edit (words are in NFC, where letters with
+ *  diacritics are single code points). ASCII characters are looked up directly and the few others in the word
+ *  are kept aside. Uses the bit-parallel algorithm of Myers (as formulated by Hyyrö) when the word has at most
+ *  64 code points, and the textbook dynamic program otherwise.
+ */ 
+class EditPattern
+{
+  public:
+
+    /**
+     *  Compiles the given word.
+     */ 
+    explicit EditPattern(std::string_view word);
+
+    /**
+     *  Returns the Levenshtein distance between the compiled word and the given word.
+     */ 
+    unsigned distance(std::string_view other) const;
+
+  private:
+
+    uint64_t equal(char32_t c) const;
+
+    std::string_view                           m_word;
+    size_t                                     m_length;
+    std::array<uint64_t, 128>                  m_peq;
+    std::vector<std::pair<char32_t, uint64_t>> m_wide;
+};
+
+/**
+ *  Nearest-neighbour queries over the dictionary in Levenshtein space, with distances in code points as
+ *  EditPattern counts them.
+ *
+ *  Arbitrary-radius queries walk a BK-tree over all word ids. The graph of words at distance exactly one from
+ *  each other is also materialized in compressed sparse row form, which answers radius-one queries on
+ *  dictionary words directly and supports word-ladder style path queries.
+ */ 
+class EditIndex
+{
+  public:
+
+    using Id = Dictionary::Id;
+
+    /**
+     *  Builds the index over the given dictionary, which must outlive it.
+     */ 
+    explicit EditIndex(const Dictionary & dictionary);
+
+    /**
+     *  Returns the ids of the dictionary words at distance exactly one from the given word.
+     */ 
+    std::span<const Id> adjacent(Id id) const;
+
+    /**
+     *  Returns the number of undirected edges in the one-edit graph.
+     */ 
+    size_t edges() const;
+
+    /**
+     *  Returns a shortest chain of one-edit steps from one word to another, both ends included,
+     *  or an empty chain if the words are not connected.
+     */ 
+    std::vector<Id> ladder(Id from, Id to) const;
+
+    /**
+     *  Returns the ids of all dictionary words within distance k of the given normalized word, in ascending order.
+     *  The word itself is included if it is in the dictionary.
+     */ 
+    std::vector<Id> neighbors(std::string_view word, unsigned k) const;
+
+  private:
+
+    /**
+     *  A BK-tree node; children are kept as a singly-linked list of siblings.
+     */ 
+    struct Node
+    {
+      Id       id;
+      uint32_t child;
+      uint32_t sibling;
+      uint32_t distance;
+    };
+
+    void build_graph();
+
+    void build_tree();
+
+    std::vector<Id> neighbors_one(std::string_view word) const;
+
+    const Dictionary & m_dictionary;
+
+    std::u32string        m_alphabet;
+    std::vector<uint32_t> m_row;
+    std::vector<Id>       m_column;
+    std::vector<Node>     m_tree;
+};
+
+#endif
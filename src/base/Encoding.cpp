@@ -0,0 +1,34 @@
+
+#include "Encoding.h"
+
+EncodingIndex::EncodingIndex(const Dictionary & dictionary)
+{
+  for (int s = 0; s < SCHEMES; s++)
+  {
+    const CodeTable & codes = table((Scheme) s);
+
+    m_lengths[s].resize(dictionary.size());
+    m_hashes[s].resize(dictionary.size());
+
+    for (Id id = 0; id < dictionary.size(); id++)
+    {
+      m_lengths[s][id] = encoded_length(dictionary.word(id), codes);
+      m_hashes[s][id] = encoded_hash(dictionary.word(id), codes);
+    }
+  }
+}
+
+uint64_t EncodingIndex::hash(Scheme scheme, Id id) const
+{
+  return m_hashes[scheme][id];
+}
+
+uint32_t EncodingIndex::length(Scheme scheme, Id id) const
+{
+  return m_lengths[scheme][id];
+}
+
+const CodeTable & EncodingIndex::table(Scheme scheme)
+{
+  return scheme == MORSE ? morse_table : ascii_table;
+}
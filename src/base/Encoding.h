@@ -0,0 +1,60 @@
+
+#ifndef PQ_ENCODING_H_
+#define PQ_ENCODING_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "Dictionary.h"
+#include "String.h"
+
+/**
+ *  Precomputed encoded lengths and hashes for every word in the dictionary.
+ *
+ *  Rules that compare the morse or ASCII encodings of words can compare these integers instead of building
+ *  the encodings; for words outside the dictionary, encoded_length and encoded_hash give the same values.
+ */ 
+class EncodingIndex
+{
+  public:
+
+    using Id = Dictionary::Id;
+
+    /**
+     *  The encodings with precomputed columns.
+     */ 
+    enum Scheme
+    {
+      ASCII,
+      MORSE,
+      SCHEMES
+    };
+
+    /**
+     *  Builds the columns over the given dictionary.
+     */ 
+    explicit EncodingIndex(const Dictionary & dictionary);
+
+    /**
+     *  Returns the hash of the given dictionary word's encoding.
+     */ 
+    uint64_t hash(Scheme scheme, Id id) const;
+
+    /**
+     *  Returns the length of the given dictionary word's encoding.
+     */ 
+    uint32_t length(Scheme scheme, Id id) const;
+
+    /**
+     *  Returns the code table for the given scheme.
+     */ 
+    static const CodeTable & table(Scheme scheme);
+
+  private:
+
+    std::vector<uint32_t> m_lengths[SCHEMES];
+    std::vector<uint64_t> m_hashes[SCHEMES];
+};
+
+#endif
+
@@ -6,6 +6,8 @@
 #include <vector>
 #include <stdexcept>
 
+#include "Memory.h"
+
 class Error : public std::runtime_error
 {
   public:
@@ -58,6 +60,7 @@ Error::Error(const std::string & file, const std::string & func, unsigned line,
 template<typename ... Ts>
 void Error::append(const std::string & file, const std::string & func, unsigned line, const Ts & ... args)
 {
+  Memory::Scope charged {Memory::ERRORS};
   std::ostringstream ss {};
   (ss << ... << args);
 
@@ -0,0 +1,200 @@
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Error.h"
+#include "Executor.h"
+#include "Logging.h"
+
+namespace
+{
+  constexpr size_t background_threads = 2;
+}
+
+void Executor::Task::promise_type::unhandled_exception()
+{
+  try
+  {
+    throw;
+  }
+  catch (Error & e)
+  {
+    e.print();
+  }
+  catch (std::exception & e)
+  {
+    U_LOGE("A task failed: ", e.what());
+  }
+  catch (...)
+  {
+    U_LOGE("A task failed.");
+  }
+}
+
+void Executor::Readable::await_suspend(std::coroutine_handle<> handle)
+{
+  executor.m_input_fd = fd;
+  executor.m_input = handle;
+}
+
+Executor & Executor::instance()
+{
+  static Executor instance_ {};
+  return instance_;
+}
+
+Executor::Executor()
+{
+  if (pipe(m_wake) == 0)
+  {
+    fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(m_wake[1], F_SETFL, O_NONBLOCK);
+  }
+
+  for (size_t i = 0; i < background_threads; i++)
+  {
+    m_threads.emplace_back([this]() { serve(); });
+  }
+}
+
+Executor::~Executor()
+{
+  {
+    std::lock_guard lock {m_mutex};
+    m_closing = true;
+  }
+  m_background_cv.notify_all();
+
+  for (std::thread & thread : m_threads)
+  {
+    thread.join();
+  }
+
+  close(m_wake[0]);
+  close(m_wake[1]);
+}
+
+Executor::Hop Executor::background()
+{
+  return Hop {* this, false};
+}
+
+bool Executor::drain()
+{
+  std::deque<std::coroutine_handle<>> ready {};
+  {
+    std::lock_guard lock {m_mutex};
+    ready.swap(m_foreground);
+  }
+
+  for (std::coroutine_handle<> handle : ready)
+  {
+    handle.resume();
+  }
+
+  return ! ready.empty();
+}
+
+Executor::Hop Executor::foreground()
+{
+  return Hop {* this, true};
+}
+
+void Executor::post(std::coroutine_handle<> handle, bool foreground)
+{
+  {
+    std::lock_guard lock {m_mutex};
+    (foreground ? m_foreground : m_background).push_back(handle);
+  }
+
+  if (foreground)
+  {
+    m_foreground_cv.notify_all();
+
+    // A full pipe already wakes the foreground, so a failed write loses nothing.
+    char byte = 0;
+    [[maybe_unused]] ssize_t written = write(m_wake[1], &byte, 1);
+  }
+  else
+  {
+    m_background_cv.notify_one();
+  }
+}
+
+Executor::Readable Executor::readable(int fd)
+{
+  return Readable {* this, fd};
+}
+
+void Executor::run()
+{
+  while (true)
+  {
+    while (drain());
+
+    if (m_stopped)
+    {
+      m_stopped = false;
+      return;
+    }
+
+    pollfd fds[2] {{m_wake[0], POLLIN, 0}, {m_input_fd, POLLIN, 0}};
+    nfds_t count = m_input ? 2 : 1;
+
+    if (poll(fds, count, -1) < 0)
+    {
+      continue;
+    }
+
+    if (fds[0].revents)
+    {
+      char bytes[256];
+      while (read(m_wake[0], bytes, sizeof(bytes)) > 0);
+    }
+
+    if (count == 2 && fds[1].revents)
+    {
+      std::coroutine_handle<> input = m_input;
+      m_input = nullptr;
+      input.resume();
+    }
+  }
+}
+
+void Executor::run_until(const std::function<bool()> & done)
+{
+  while (! done())
+  {
+    {
+      std::unique_lock lock {m_mutex};
+      m_foreground_cv.wait(lock, [this]() { return ! m_foreground.empty(); });
+    }
+
+    drain();
+  }
+}
+
+void Executor::serve()
+{
+  while (true)
+  {
+    std::coroutine_handle<> handle {};
+    {
+      std::unique_lock lock {m_mutex};
+      m_background_cv.wait(lock, [this]() { return m_closing || ! m_background.empty(); });
+
+      if (m_background.empty()) return;
+
+      handle = m_background.front();
+      m_background.pop_front();
+    }
+
+    handle.resume();
+  }
+}
+
+void Executor::stop()
+{
+  m_stopped = true;
+}
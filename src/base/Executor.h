@@ -0,0 +1,143 @@
+
+#ifndef PQ_EXECUTOR_H_
+#define PQ_EXECUTOR_H_
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  Runs coroutines on two sides: the foreground, which is the main thread and owns the session and the terminal,
+ *  and a small pool of background threads for long work.
+ *
+ *  A coroutine moves between the sides by awaiting background() or foreground(), and waits for input by awaiting
+ *  readable(fd). The foreground runs in run, which resumes whatever was handed to it and otherwise sleeps in
+ *  poll until input arrives or more work is handed over. Nothing ever runs on the foreground concurrently, so
+ *  foreground code needs no locks.
+ */ 
+class Executor
+{
+  public:
+
+    /**
+     *  A coroutine that starts right away and frees itself when it finishes. Nobody waits on it, so it should
+     *  not let exceptions escape; those that do are logged.
+     */ 
+    struct Task
+    {
+      struct promise_type
+      {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+      };
+    };
+
+    /**
+     *  Resumes the awaiting coroutine on the foreground or in the background.
+     */ 
+    struct Hop
+    {
+      Executor & executor;
+      bool       foreground;
+
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle) { executor.post(handle, foreground); }
+      void await_resume() const noexcept {}
+    };
+
+    /**
+     *  Resumes the awaiting coroutine on the foreground once a file descriptor is readable.
+     */ 
+    struct Readable
+    {
+      Executor & executor;
+      int        fd;
+
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle);
+      void await_resume() const noexcept {}
+    };
+
+    /**
+     *  Gets the executor shared by the whole program.
+     */ 
+    static Executor & instance();
+
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor & operator=(const Executor &) = delete;
+
+    /**
+     *  Returns an awaitable that moves the coroutine to a background thread.
+     */ 
+    Hop background();
+
+    /**
+     *  Returns an awaitable that moves the coroutine to the foreground.
+     */ 
+    Hop foreground();
+
+    /**
+     *  Returns an awaitable that resumes the coroutine on the foreground once the file descriptor is readable.
+     *  Only one coroutine can wait for input at a time.
+     */ 
+    Readable readable(int fd);
+
+    /**
+     *  Runs the foreground on the calling thread until stop is called.
+     */ 
+    void run();
+
+    /**
+     *  Runs foreground work handed over from the background until the predicate holds, without waiting for
+     *  input. Called from the foreground to wait for background work.
+     */ 
+    void run_until(const std::function<bool()> & done);
+
+    /**
+     *  Makes run return once the foreground has nothing left to do.
+     */ 
+    void stop();
+
+  private:
+
+    Executor();
+
+    /**
+     *  Hands a coroutine over to one of the sides.
+     */ 
+    void post(std::coroutine_handle<> handle, bool foreground);
+
+    /**
+     *  Resumes every coroutine handed to the foreground so far. Returns whether there were any.
+     */ 
+    bool drain();
+
+    /**
+     *  The body of a background thread.
+     */ 
+    void serve();
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_foreground_cv;
+    std::condition_variable             m_background_cv;
+    std::deque<std::coroutine_handle<>> m_foreground;
+    std::deque<std::coroutine_handle<>> m_background;
+    std::vector<std::thread>            m_threads;
+    bool                                m_closing {false};
+
+    int                                 m_wake[2] {-1, -1};
+    int                                 m_input_fd {-1};
+    std::coroutine_handle<>             m_input;
+    bool                                m_stopped {false};
+};
+
+#endif
@@ -0,0 +1,1042 @@
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <tuple>
+
+#include "Category.h"
+#include "Dictionary.h"
+#include "EditIndex.h"
+#include "Error.h"
+#include "Expr.h"
+#include "Pattern.h"
+#include "String.h"
+#include "SubstringIndex.h"
+#include "Utf8.h"
+
+namespace
+{
+  enum class Type
+  {
+    INT,
+    STR
+  };
+
+  /**
+   *  What the evaluation is about; names and impure functions read from it.
+   */
+  struct Context
+  {
+    std::string_view                 word;
+    const History *                  history;
+    const std::unique_ptr<Pattern> * patterns;
+  };
+
+  /**
+   *  A signature for a name or function.
+   */
+  struct Builtin
+  {
+    const char *      name;
+    Expr::Op          op;
+    Type              result;
+    std::vector<Type> args;
+    bool              pure;
+  };
+
+  const std::vector<Builtin> & builtins()
+  {
+    static const std::vector<Builtin> builtins_ =
+    {
+      {"word",             Expr::WORD,             Type::STR, {},                     false},
+      {"last",             Expr::LAST,             Type::STR, {},                     false},
+      {"last_accepted",    Expr::LAST_ACCEPTED,    Type::STR, {},                     false},
+      {"last_rejected",    Expr::LAST_REJECTED,    Type::STR, {},                     false},
+      {"guesses",          Expr::GUESSES,          Type::INT, {},                     false},
+      {"accepted",         Expr::ACCEPTED,         Type::INT, {},                     false},
+      {"rejected",         Expr::REJECTED,         Type::INT, {},                     false},
+      {"len",              Expr::LEN,              Type::INT, {Type::STR},            true},
+      {"sum_a1z26",        Expr::SUM_A1Z26,        Type::INT, {Type::STR},            true},
+      {"vowels",           Expr::VOWELS,           Type::INT, {Type::STR},            true},
+      {"count",            Expr::COUNT,            Type::INT, {Type::STR, Type::STR}, true},
+      {"contains",         Expr::CONTAINS,         Type::INT, {Type::STR, Type::STR}, true},
+      {"starts_with",      Expr::STARTS_WITH,      Type::INT, {Type::STR, Type::STR}, true},
+      {"ends_with",        Expr::ENDS_WITH,        Type::INT, {Type::STR, Type::STR}, true},
+      {"matches",          Expr::MATCHES,          Type::INT, {Type::STR, Type::STR}, true},
+      {"at",               Expr::AT,               Type::STR, {Type::STR, Type::INT}, true},
+      {"lower",            Expr::LOWER,            Type::STR, {Type::STR},            true},
+      {"upper",            Expr::UPPER,            Type::STR, {Type::STR},            true},
+      {"trim",             Expr::TRIM,             Type::STR, {Type::STR},            true},
+      {"edit_distance",    Expr::EDIT_DISTANCE,    Type::INT, {Type::STR, Type::STR}, true},
+      {"in_dictionary",    Expr::IN_DICTIONARY,    Type::INT, {Type::STR},            false},
+      {"in_category",      Expr::IN_CATEGORY,      Type::INT, {Type::STR, Type::STR}, false},
+      {"count_containing", Expr::COUNT_CONTAINING, Type::INT, {Type::STR},            false},
+      {"rhymes",           Expr::RHYMES,           Type::INT, {Type::STR, Type::STR}, false},
+      {"sounds_like",      Expr::SOUNDS_LIKE,      Type::INT, {Type::STR, Type::STR}, false},
+      {"guessed",          Expr::GUESSED,          Type::INT, {Type::STR},            false},
+      {"chance",           Expr::CHANCE,           Type::INT, {Type::INT},            false},
+    };
+
+    return builtins_;
+  }
+
+  const char * op_names[] =
+  {
+    "ret", "jump", "jump_zero", "jump_nonzero", "move_int", "move_str", "bool",
+    "neg", "not", "add", "sub", "mul", "div", "mod", "eq", "ne", "lt", "le", "gt", "ge",
+    "str_eq", "str_ne", "str_lt", "str_le", "str_gt", "str_ge", "concat",
+    "word", "last", "last_accepted", "last_rejected", "guesses", "accepted", "rejected",
+    "len", "sum_a1z26", "vowels", "count", "contains", "starts_with", "ends_with", "matches", "at", "lower", "upper", "trim",
+    "edit_distance", "in_dictionary", "in_category", "count_containing", "rhymes", "sounds_like", "guessed", "chance"
+  };
+
+  /**
+   *  Case folds the view into the buffer and trims surrounding whitespace, as String.h does before dictionary lookups.
+   */
+  std::string_view fold(std::string_view s, std::string & buffer)
+  {
+    while (! s.empty() && std::isspace((unsigned char) s.front())) s.remove_prefix(1);
+    while (! s.empty() && std::isspace((unsigned char) s.back())) s.remove_suffix(1);
+
+    utf8_fold(s, buffer);
+    return buffer;
+  }
+
+  /**
+   *  Returns the lowercase base letter of the character at the offset (see utf8_base in Utf8.h), and advances
+   *  past it.
+   */
+  char32_t letter(std::string_view s, size_t & at)
+  {
+    unsigned char c = s[at];
+    if (c < 0x80)
+    {
+      at++;
+      return std::tolower(c);
+    }
+
+    return utf8_base(utf8_decode(s, at));
+  }
+
+  /**
+   *  Runs one instruction other than a return or a jump.
+   */
+  [[gnu::always_inline]] inline void execute(const Expr::Instruction & in, Expr::Frame & f, const Context & context)
+  {
+    int64_t * i = f.ints.data();
+    std::string_view * s = f.strs.data();
+
+    switch (in.op)
+    {
+      case Expr::MOVE_INT: i[in.dst] = i[in.a]; break;
+      case Expr::MOVE_STR: s[in.dst] = s[in.a]; break;
+      case Expr::BOOL:     i[in.dst] = i[in.a] != 0; break;
+
+      case Expr::NEG: i[in.dst] = (int64_t) (0 - (uint64_t) i[in.a]); break;
+      case Expr::NOT: i[in.dst] = i[in.a] == 0; break;
+      case Expr::ADD: i[in.dst] = (int64_t) ((uint64_t) i[in.a] + (uint64_t) i[in.b]); break;
+      case Expr::SUB: i[in.dst] = (int64_t) ((uint64_t) i[in.a] - (uint64_t) i[in.b]); break;
+      case Expr::MUL: i[in.dst] = (int64_t) ((uint64_t) i[in.a] * (uint64_t) i[in.b]); break;
+      case Expr::DIV: i[in.dst] = i[in.b] == 0 ? 0 : i[in.b] == -1 ? (int64_t) (0 - (uint64_t) i[in.a]) : i[in.a] / i[in.b]; break;
+      case Expr::MOD: i[in.dst] = i[in.b] == 0 || i[in.b] == -1 ? 0 : i[in.a] % i[in.b]; break;
+      case Expr::EQ:  i[in.dst] = i[in.a] == i[in.b]; break;
+      case Expr::NE:  i[in.dst] = i[in.a] != i[in.b]; break;
+      case Expr::LT:  i[in.dst] = i[in.a] < i[in.b]; break;
+      case Expr::LE:  i[in.dst] = i[in.a] <= i[in.b]; break;
+      case Expr::GT:  i[in.dst] = i[in.a] > i[in.b]; break;
+      case Expr::GE:  i[in.dst] = i[in.a] >= i[in.b]; break;
+
+      case Expr::STR_EQ: i[in.dst] = s[in.a] == s[in.b]; break;
+      case Expr::STR_NE: i[in.dst] = s[in.a] != s[in.b]; break;
+      case Expr::STR_LT: i[in.dst] = s[in.a] < s[in.b]; break;
+      case Expr::STR_LE: i[in.dst] = s[in.a] <= s[in.b]; break;
+      case Expr::STR_GT: i[in.dst] = s[in.a] > s[in.b]; break;
+      case Expr::STR_GE: i[in.dst] = s[in.a] >= s[in.b]; break;
+      case Expr::CONCAT:
+        {
+          std::string & out = f.owned[in.dst];
+          out.assign(s[in.a]);
+          out.append(s[in.b]);
+          s[in.dst] = out;
+          break;
+        }
+
+      case Expr::WORD: s[in.dst] = context.word; break;
+      case Expr::LAST:
+        {
+          f.owned[in.dst] = context.history->peek().word;
+          s[in.dst] = f.owned[in.dst];
+          break;
+        }
+      case Expr::LAST_ACCEPTED:
+        {
+          f.owned[in.dst] = context.history->peek_accepted();
+          s[in.dst] = f.owned[in.dst];
+          break;
+        }
+      case Expr::LAST_REJECTED:
+        {
+          f.owned[in.dst] = context.history->peek_rejected();
+          s[in.dst] = f.owned[in.dst];
+          break;
+        }
+      case Expr::GUESSES:  i[in.dst] = context.history->count(); break;
+      case Expr::ACCEPTED: i[in.dst] = context.history->count_accepted(); break;
+      case Expr::REJECTED: i[in.dst] = context.history->count_rejected(); break;
+
+      case Expr::LEN: i[in.dst] = utf8_clusters(s[in.a]); break;
+      case Expr::SUM_A1Z26:
+        {
+          int64_t sum = 0;
+          for (size_t at = 0; at < s[in.a].size(); )
+          {
+            char32_t c = letter(s[in.a], at);
+            if ('a' <= c && c <= 'z') sum += c - 'a' + 1;
+          }
+          i[in.dst] = sum;
+          break;
+        }
+      case Expr::VOWELS:
+        {
+          int64_t vowels = 0;
+          for (size_t at = 0; at < s[in.a].size(); )
+          {
+            char32_t c = letter(s[in.a], at);
+            vowels += c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+          }
+          i[in.dst] = vowels;
+          break;
+        }
+      case Expr::COUNT:
+        {
+          int64_t count = 0;
+          std::string_view haystack = s[in.a];
+          std::string_view needle = s[in.b];
+          if (! needle.empty())
+          {
+            for (size_t at = haystack.find(needle); at != std::string_view::npos; at = haystack.find(needle, at + 1))
+            {
+              count++;
+            }
+          }
+          i[in.dst] = count;
+          break;
+        }
+      case Expr::CONTAINS:    i[in.dst] = s[in.a].find(s[in.b]) != std::string_view::npos; break;
+      case Expr::STARTS_WITH: i[in.dst] = s[in.a].starts_with(s[in.b]); break;
+      case Expr::ENDS_WITH:   i[in.dst] = s[in.a].ends_with(s[in.b]); break;
+      case Expr::MATCHES:
+        {
+          const Pattern & pattern = in.imm ? * context.patterns[in.imm - 1] : Pattern::compile(s[in.b]);
+          i[in.dst] = pattern.matches(s[in.a]);
+          break;
+        }
+      case Expr::AT:
+        {
+          // ASCII words index bytes; others walk their grapheme clusters.
+
+          std::string_view v = s[in.a];
+          bool ascii = utf8_ascii(v);
+          int64_t n = ascii ? v.size() : utf8_clusters(v);
+          int64_t k = i[in.b] < 0 ? n + i[in.b] : i[in.b];
+
+          if (k < 0 || k >= n)
+          {
+            s[in.dst] = std::string_view {};
+          }
+          else if (ascii)
+          {
+            s[in.dst] = v.substr(k, 1);
+          }
+          else
+          {
+            size_t at = 0;
+            for (int64_t j = 0; j < k; j++) at = utf8_cluster(v, at);
+            s[in.dst] = v.substr(at, utf8_cluster(v, at) - at);
+          }
+          break;
+        }
+      case Expr::LOWER:
+        {
+          utf8_fold(s[in.a], f.owned[in.dst]);
+          s[in.dst] = f.owned[in.dst];
+          break;
+        }
+      case Expr::UPPER:
+        {
+          utf8_upper(s[in.a], f.owned[in.dst]);
+          s[in.dst] = f.owned[in.dst];
+          break;
+        }
+      case Expr::TRIM:
+        {
+          std::string_view v = s[in.a];
+          while (! v.empty() && std::isspace((unsigned char) v.front())) v.remove_prefix(1);
+          while (! v.empty() && std::isspace((unsigned char) v.back())) v.remove_suffix(1);
+          s[in.dst] = v;
+          break;
+        }
+
+      case Expr::EDIT_DISTANCE:
+        {
+          std::string_view a = s[in.a];
+          std::string_view b = s[in.b];
+          i[in.dst] = a.size() <= b.size() ? EditPattern {a}.distance(b) : EditPattern {b}.distance(a);
+          break;
+        }
+      case Expr::IN_DICTIONARY:
+        {
+          i[in.dst] = Dictionary::instance().contains(fold(s[in.a], f.scratch));
+          break;
+        }
+      case Expr::IN_CATEGORY:
+        {
+          // The name is nearly always a constant, so the frame keeps the set it last stood for in the current index.
+
+          const Dictionary & dictionary = Dictionary::instance();
+          const CategoryIndex & index = dictionary.category_index();
+
+          if (f.categories != index.id() || f.category != s[in.b])
+          {
+            f.categories = 0;
+            f.words = index.resolve(s[in.b]);
+            if (! f.words)
+            {
+              THROW_ERROR("No word category '", s[in.b], "'.");
+            }
+
+            f.categories = index.id();
+            f.category.assign(s[in.b]);
+          }
+
+          Dictionary::Id id = dictionary.find(fold(s[in.a], f.scratch));
+          i[in.dst] = id != Dictionary::npos && f.words->contains(id);
+          break;
+        }
+      case Expr::COUNT_CONTAINING:
+        {
+          i[in.dst] = Dictionary::instance().substring_index().count_words(fold(s[in.a], f.scratch));
+          break;
+        }
+      case Expr::RHYMES:      i[in.dst] = rhymes(std::string {s[in.a]}, std::string {s[in.b]}); break;
+      case Expr::SOUNDS_LIKE: i[in.dst] = sounds_like(std::string {s[in.a]}, std::string {s[in.b]}); break;
+      case Expr::GUESSED:
+        {
+          f.scratch.assign(s[in.a]);
+          i[in.dst] = context.history->guessed(f.scratch);
+          break;
+        }
+      case Expr::CHANCE:
+        {
+          f.scratch.assign(context.word);
+          i[in.dst] = context.history->chance(f.scratch, i[in.a] / 100.0);
+          break;
+        }
+
+      default:
+        break;
+    }
+  }
+
+  /**
+   *  Points the frame's registers at the program's constants, if it was last used for another program.
+   */
+  void load(Expr::Frame & frame, uint64_t id, const std::vector<int64_t> & ints, const std::vector<std::string> & strs)
+  {
+    if (frame.program == id)
+    {
+      return;
+    }
+
+    frame.program = id;
+    frame.ints = ints;
+    frame.strs.assign(strs.begin(), strs.end());
+    frame.owned.resize(std::max(frame.owned.size(), strs.size()));
+  }
+
+  thread_local Expr::Frame t_frame {};
+
+  std::atomic<uint64_t> s_next_id {1};
+}
+
+/**
+ *  Parses an expression into a tree, type-checks it and emits bytecode, folding constants along the way.
+ */
+class ExprCompiler
+{
+  public:
+
+    explicit ExprCompiler(Expr & expr)
+      : m_expr {expr}
+      , m_source {expr.m_source}
+    {}
+
+    void compile()
+    {
+      std::unique_ptr<Node> root = parse_ternary();
+      if (peek().kind != Token::END)
+      {
+        fail(peek().column, "Unexpected '", peek().text, "'.");
+      }
+
+      Operand result = emit(* root);
+      if (result.type != Type::INT)
+      {
+        fail(0, "The expression must be an integer or a comparison, not a string.");
+      }
+
+      m_expr.m_code.push_back({Expr::RET, 0, result.reg, 0, 0});
+    }
+
+  private:
+
+    struct Token
+    {
+      enum Kind { INT, STR, NAME, SYMBOL, END };
+
+      Kind        kind;
+      std::string text;
+      int64_t     value  {0};
+      size_t      column {0};
+    };
+
+    struct Node
+    {
+      enum Kind { INT, STR, NAME, CALL, UNARY, BINARY, TERNARY };
+
+      Kind                               kind;
+      std::string                        text;
+      int64_t                            value  {0};
+      size_t                             column {0};
+      std::vector<std::unique_ptr<Node>> children;
+    };
+
+    struct Operand
+    {
+      Type    type;
+      uint8_t reg;
+      bool    constant;
+    };
+
+    template<typename ... Ts>
+    [[noreturn]] void fail(size_t column, const Ts & ... args) const
+    {
+      THROW_ERROR(args..., " (at column ", column + 1, " of '", m_source, "')");
+    }
+
+    // Lexing.
+
+    const Token & peek()
+    {
+      if (! m_lookahead)
+      {
+        m_token = lex();
+        m_lookahead = true;
+      }
+
+      return m_token;
+    }
+
+    Token next()
+    {
+      peek();
+      m_lookahead = false;
+      return m_token;
+    }
+
+    bool accept(const char * symbol)
+    {
+      if (peek().kind == Token::SYMBOL && peek().text == symbol)
+      {
+        next();
+        return true;
+      }
+
+      return false;
+    }
+
+    void expect(const char * symbol)
+    {
+      if (! accept(symbol))
+      {
+        fail(peek().column, "Expected '", symbol, "' but found '", peek().text, "'.");
+      }
+    }
+
+    Token lex()
+    {
+      while (m_at < m_source.size() && std::isspace((unsigned char) m_source[m_at])) m_at++;
+
+      Token token {Token::END, "end of input", 0, m_at};
+      if (m_at == m_source.size())
+      {
+        return token;
+      }
+
+      char c = m_source[m_at];
+      if (std::isdigit((unsigned char) c))
+      {
+        size_t start = m_at;
+        while (m_at < m_source.size() && std::isdigit((unsigned char) m_source[m_at])) m_at++;
+
+        token.kind = Token::INT;
+        token.text = m_source.substr(start, m_at - start);
+        try
+        {
+          token.value = std::stoll(token.text);
+        }
+        catch (std::exception & e)
+        {
+          fail(start, "The number ", token.text, " is too large.");
+        }
+      }
+      else if (std::isalpha((unsigned char) c) || c == '_')
+      {
+        size_t start = m_at;
+        while (m_at < m_source.size() && (std::isalnum((unsigned char) m_source[m_at]) || m_source[m_at] == '_')) m_at++;
+
+        token.kind = Token::NAME;
+        token.text = m_source.substr(start, m_at - start);
+      }
+      else if (c == '"' || c == '\'')
+      {
+        size_t end = m_source.find(c, m_at + 1);
+        if (end == std::string::npos)
+        {
+          fail(m_at, "Unterminated string.");
+        }
+
+        token.kind = Token::STR;
+        token.text = m_source.substr(m_at + 1, end - m_at - 1);
+        m_at = end + 1;
+      }
+      else
+      {
+        static const char * symbols[] =
+        {
+          "||", "&&", "==", "!=", "<=", ">=", "<", ">", "+", "-", "*", "/", "%", "!", "?", ":", "(", ")", ","
+        };
+
+        for (const char * symbol : symbols)
+        {
+          if (m_source.compare(m_at, std::strlen(symbol), symbol) == 0)
+          {
+            token.kind = Token::SYMBOL;
+            token.text = symbol;
+            m_at += token.text.size();
+            return token;
+          }
+        }
+
+        fail(m_at, "Unexpected character '", c, "'.");
+      }
+
+      return token;
+    }
+
+    // Parsing, by recursive descent with one function per precedence level.
+
+    std::unique_ptr<Node> node(Node::Kind kind, const std::string & text, size_t column)
+    {
+      auto n = std::make_unique<Node>();
+      n->kind = kind;
+      n->text = text;
+      n->column = column;
+      return n;
+    }
+
+    std::unique_ptr<Node> binary(const std::string & op, size_t column, std::unique_ptr<Node> lhs, std::unique_ptr<Node> rhs)
+    {
+      auto n = node(Node::BINARY, op, column);
+      n->children.push_back(std::move(lhs));
+      n->children.push_back(std::move(rhs));
+      return n;
+    }
+
+    std::unique_ptr<Node> parse_ternary()
+    {
+      std::unique_ptr<Node> cond = parse_level(0);
+      size_t column = peek().column;
+
+      if (! accept("?"))
+      {
+        return cond;
+      }
+
+      auto n = node(Node::TERNARY, "?", column);
+      n->children.push_back(std::move(cond));
+      n->children.push_back(parse_ternary());
+      expect(":");
+      n->children.push_back(parse_ternary());
+      return n;
+    }
+
+    std::unique_ptr<Node> parse_level(size_t level)
+    {
+      static const std::vector<std::vector<const char *>> levels =
+      {
+        {"||"}, {"&&"}, {"==", "!="}, {"<", "<=", ">", ">="}, {"+", "-"}, {"*", "/", "%"}
+      };
+
+      if (level == levels.size())
+      {
+        return parse_unary();
+      }
+
+      std::unique_ptr<Node> lhs = parse_level(level + 1);
+      while (true)
+      {
+        const char * matched = nullptr;
+        size_t column = peek().column;
+
+        for (const char * op : levels[level])
+        {
+          if (accept(op))
+          {
+            matched = op;
+            break;
+          }
+        }
+
+        if (! matched)
+        {
+          return lhs;
+        }
+
+        lhs = binary(matched, column, std::move(lhs), parse_level(level + 1));
+      }
+    }
+
+    std::unique_ptr<Node> parse_unary()
+    {
+      size_t column = peek().column;
+      for (const char * op : {"!", "-"})
+      {
+        if (accept(op))
+        {
+          auto n = node(Node::UNARY, op, column);
+          n->children.push_back(parse_unary());
+          return n;
+        }
+      }
+
+      return parse_primary();
+    }
+
+    std::unique_ptr<Node> parse_primary()
+    {
+      Token token = next();
+
+      switch (token.kind)
+      {
+        case Token::INT:
+          {
+            auto n = node(Node::INT, token.text, token.column);
+            n->value = token.value;
+            return n;
+          }
+        case Token::STR:
+          {
+            return node(Node::STR, token.text, token.column);
+          }
+        case Token::NAME:
+          {
+            if (token.text == "true" || token.text == "false")
+            {
+              auto n = node(Node::INT, token.text, token.column);
+              n->value = token.text == "true";
+              return n;
+            }
+
+            if (! accept("("))
+            {
+              return node(Node::NAME, token.text, token.column);
+            }
+
+            auto n = node(Node::CALL, token.text, token.column);
+            if (! accept(")"))
+            {
+              do
+              {
+                n->children.push_back(parse_ternary());
+              }
+              while (accept(","));
+              expect(")");
+            }
+            return n;
+          }
+        case Token::SYMBOL:
+          {
+            if (token.text == "(")
+            {
+              std::unique_ptr<Node> inner = parse_ternary();
+              expect(")");
+              return inner;
+            }
+            break;
+          }
+        default:
+          break;
+      }
+
+      fail(token.column, "Unexpected '", token.text, "'.");
+    }
+
+    // Code generation.
+
+    uint8_t allocate(Type type, size_t column)
+    {
+      auto & constants = m_expr.m_int_constants;
+      auto & strings = m_expr.m_str_constants;
+      size_t n = type == Type::INT ? constants.size() : strings.size();
+
+      if (n > UINT8_MAX)
+      {
+        fail(column, "The expression is too large.");
+      }
+
+      if (type == Type::INT) constants.push_back(0);
+      else strings.emplace_back();
+
+      return n;
+    }
+
+    Operand constant(int64_t value, size_t column)
+    {
+      uint8_t reg = allocate(Type::INT, column);
+      m_expr.m_int_constants[reg] = value;
+      return {Type::INT, reg, true};
+    }
+
+    Operand constant(const std::string & value, size_t column)
+    {
+      uint8_t reg = allocate(Type::STR, column);
+      m_expr.m_str_constants[reg] = value;
+      return {Type::STR, reg, true};
+    }
+
+    /**
+     *  Emits an instruction, or runs it right away if it is pure and its operands are constants.
+     */
+    Operand instruction(Expr::Op op, Type type, bool pure, std::vector<Operand> args, size_t column, uint32_t imm = 0)
+    {
+      uint8_t dst = allocate(type, column);
+      Expr::Instruction in {op, dst, args.size() > 0 ? args[0].reg : uint8_t {0}, args.size() > 1 ? args[1].reg : uint8_t {0}, imm};
+
+      bool foldable = pure;
+      for (const Operand & arg : args)
+      {
+        foldable &= arg.constant;
+      }
+
+      if (! foldable)
+      {
+        m_expr.m_code.push_back(in);
+        return {type, dst, false};
+      }
+
+      Expr::Frame frame {};
+      frame.ints = m_expr.m_int_constants;
+      frame.strs.assign(m_expr.m_str_constants.begin(), m_expr.m_str_constants.end());
+      frame.owned.resize(m_expr.m_str_constants.size());
+      // Pure operations never look at the context, but give them a valid one anyway.
+      static const History empty {};
+      execute(in, frame, Context {{}, &empty, m_expr.m_patterns.data()});
+
+      if (type == Type::INT) m_expr.m_int_constants[dst] = frame.ints[dst];
+      else m_expr.m_str_constants[dst] = std::string {frame.strs[dst]};
+
+      return {type, dst, true};
+    }
+
+    Operand emit(const Node & n)
+    {
+      switch (n.kind)
+      {
+        case Node::INT:
+          return constant(n.value, n.column);
+
+        case Node::STR:
+          return constant(n.text, n.column);
+
+        case Node::NAME:
+        case Node::CALL:
+          return emit_builtin(n);
+
+        case Node::UNARY:
+          {
+            Operand arg = emit(* n.children[0]);
+            require(arg, Type::INT, n);
+            return instruction(n.text == "!" ? Expr::NOT : Expr::NEG, Type::INT, true, {arg}, n.column);
+          }
+
+        case Node::BINARY:
+          {
+            if (n.text == "&&" || n.text == "||")
+            {
+              return emit_logical(n);
+            }
+
+            Operand lhs = emit(* n.children[0]);
+            Operand rhs = emit(* n.children[1]);
+
+            if (lhs.type != rhs.type)
+            {
+              fail(n.column, "Both sides of '", n.text, "' must be integers or both strings.");
+            }
+
+            static const std::vector<std::tuple<const char *, Expr::Op, Expr::Op>> ops =
+            {
+              {"==", Expr::EQ, Expr::STR_EQ}, {"!=", Expr::NE, Expr::STR_NE},
+              {"<", Expr::LT, Expr::STR_LT}, {"<=", Expr::LE, Expr::STR_LE},
+              {">", Expr::GT, Expr::STR_GT}, {">=", Expr::GE, Expr::STR_GE},
+              {"+", Expr::ADD, Expr::CONCAT}, {"-", Expr::SUB, Expr::RET},
+              {"*", Expr::MUL, Expr::RET}, {"/", Expr::DIV, Expr::RET}, {"%", Expr::MOD, Expr::RET}
+            };
+
+            for (auto [text, int_op, str_op] : ops)
+            {
+              if (n.text != text) continue;
+
+              if (lhs.type == Type::INT)
+              {
+                return instruction(int_op, Type::INT, true, {lhs, rhs}, n.column);
+              }
+
+              if (str_op == Expr::RET)
+              {
+                fail(n.column, "'", n.text, "' does not apply to strings.");
+              }
+
+              return instruction(str_op, str_op == Expr::CONCAT ? Type::STR : Type::INT, true, {lhs, rhs}, n.column);
+            }
+
+            fail(n.column, "Unknown operator '", n.text, "'.");
+          }
+
+        case Node::TERNARY:
+          return emit_ternary(n);
+      }
+
+      fail(n.column, "Unknown expression.");
+    }
+
+    Operand emit_builtin(const Node & n)
+    {
+      for (const Builtin & builtin : builtins())
+      {
+        if (n.text != builtin.name) continue;
+
+        bool call = n.kind == Node::CALL;
+        if (call != ! builtin.args.empty() || n.children.size() != builtin.args.size())
+        {
+          if (builtin.args.empty()) fail(n.column, "'", n.text, "' is a name, not a function.");
+          fail(n.column, "'", n.text, "' takes ", builtin.args.size(), " argument", builtin.args.size() == 1 ? "" : "s", ".");
+        }
+
+        std::vector<Operand> args {};
+        for (size_t k = 0; k < n.children.size(); k++)
+        {
+          args.push_back(emit(* n.children[k]));
+          require(args.back(), builtin.args[k], * n.children[k]);
+        }
+
+        // A constant pattern is compiled now and kept with the expression, so that a malformed one is a compile
+        // error rather than an evaluation one, and evaluations need not look it up. Other patterns go through
+        // the bounded cache of Pattern::compile.
+
+        uint32_t imm = 0;
+        if (builtin.op == Expr::MATCHES && args[1].constant)
+        {
+          try
+          {
+            m_expr.m_patterns.push_back(std::make_unique<Pattern>(m_expr.m_str_constants[args[1].reg]));
+            imm = m_expr.m_patterns.size();
+          }
+          catch (const Error &)
+          {
+            fail(n.children[1]->column, "The pattern '", m_expr.m_str_constants[args[1].reg], "' is malformed.");
+          }
+        }
+
+        return instruction(builtin.op, builtin.result, builtin.pure, args, n.column, imm);
+      }
+
+      fail(n.column, "Unknown ", n.kind == Node::CALL ? "function" : "name", " '", n.text, "'.");
+    }
+
+    Operand emit_logical(const Node & n)
+    {
+      // a && b is false without evaluating b if a is false, and bool(b) otherwise; || is the other way round.
+
+      bool conjunction = n.text == "&&";
+      Operand lhs = emit(* n.children[0]);
+      require(lhs, Type::INT, * n.children[0]);
+
+      if (lhs.constant)
+      {
+        bool value = m_expr.m_int_constants[lhs.reg] != 0;
+        if (value != conjunction)
+        {
+          return constant(value, n.column);
+        }
+
+        Operand rhs = emit(* n.children[1]);
+        require(rhs, Type::INT, * n.children[1]);
+        return instruction(Expr::BOOL, Type::INT, true, {rhs}, n.column);
+      }
+
+      uint8_t dst = allocate(Type::INT, n.column);
+      m_expr.m_code.push_back({Expr::BOOL, dst, lhs.reg, 0, 0});
+
+      size_t skip = m_expr.m_code.size();
+      m_expr.m_code.push_back({conjunction ? Expr::JUMP_ZERO : Expr::JUMP_NONZERO, 0, dst, 0, 0});
+
+      Operand rhs = emit(* n.children[1]);
+      require(rhs, Type::INT, * n.children[1]);
+      m_expr.m_code.push_back({Expr::BOOL, dst, rhs.reg, 0, 0});
+      m_expr.m_code[skip].imm = m_expr.m_code.size();
+
+      return {Type::INT, dst, false};
+    }
+
+    Operand emit_ternary(const Node & n)
+    {
+      Operand cond = emit(* n.children[0]);
+      require(cond, Type::INT, * n.children[0]);
+
+      if (cond.constant)
+      {
+        return emit(* n.children[m_expr.m_int_constants[cond.reg] != 0 ? 1 : 2]);
+      }
+
+      size_t to_else = m_expr.m_code.size();
+      m_expr.m_code.push_back({Expr::JUMP_ZERO, 0, cond.reg, 0, 0});
+
+      Operand then = emit(* n.children[1]);
+      uint8_t dst = allocate(then.type, n.column);
+      m_expr.m_code.push_back({then.type == Type::INT ? Expr::MOVE_INT : Expr::MOVE_STR, dst, then.reg, 0, 0});
+
+      size_t to_end = m_expr.m_code.size();
+      m_expr.m_code.push_back({Expr::JUMP, 0, 0, 0, 0});
+      m_expr.m_code[to_else].imm = m_expr.m_code.size();
+
+      Operand otherwise = emit(* n.children[2]);
+      if (otherwise.type != then.type)
+      {
+        fail(n.column, "Both branches of '?:' must be integers or both strings.");
+      }
+
+      m_expr.m_code.push_back({then.type == Type::INT ? Expr::MOVE_INT : Expr::MOVE_STR, dst, otherwise.reg, 0, 0});
+      m_expr.m_code[to_end].imm = m_expr.m_code.size();
+
+      return {then.type, dst, false};
+    }
+
+    void require(const Operand & operand, Type type, const Node & n)
+    {
+      if (operand.type != type)
+      {
+        fail(n.column, "Expected ", type == Type::INT ? "an integer" : "a string", " here.");
+      }
+    }
+
+    Expr &            m_expr;
+    const std::string m_source;
+    size_t            m_at        {0};
+    Token             m_token     {};
+    bool              m_lookahead {false};
+};
+
+Expr::Expr(const std::string & source)
+  : m_source {source}
+  , m_id {s_next_id++}
+{
+  ExprCompiler {* this}.compile();
+}
+
+Expr::~Expr() = default;
+
+std::string Expr::disassemble() const
+{
+  std::ostringstream out {};
+  for (size_t pc = 0; pc < m_code.size(); pc++)
+  {
+    const Instruction & in = m_code[pc];
+    out << pc << ": " << op_names[in.op] << " " << (int) in.dst << ", " << (int) in.a << ", " << (int) in.b;
+    if (in.op == JUMP || in.op == JUMP_ZERO || in.op == JUMP_NONZERO) out << " -> " << in.imm;
+    out << "\n";
+  }
+
+  return out.str();
+}
+
+bool Expr::pure() const
+{
+  // Dictionary lookups depend on the word alone; only the names and functions below read the history.
+
+  for (const Instruction & in : m_code)
+  {
+    switch (in.op)
+    {
+      case LAST:
+      case LAST_ACCEPTED:
+      case LAST_REJECTED:
+      case GUESSES:
+      case ACCEPTED:
+      case REJECTED:
+      case GUESSED:
+      case CHANCE:
+        return false;
+      default:
+        break;
+    }
+  }
+
+  return true;
+}
+
+size_t Expr::size() const
+{
+  return m_code.size();
+}
+
+const std::string & Expr::source() const
+{
+  return m_source;
+}
+
+bool Expr::test(std::string_view word, const History & history) const
+{
+  Frame & frame = t_frame;
+  load(frame, m_id, m_int_constants, m_str_constants);
+
+  Context context {word, &history, m_patterns.data()};
+  const Instruction * code = m_code.data();
+
+  for (size_t pc = 0; ; )
+  {
+    const Instruction & in = code[pc];
+    switch (in.op)
+    {
+      case RET:
+        return frame.ints[in.a] != 0;
+      case JUMP:
+        pc = in.imm;
+        break;
+      case JUMP_ZERO:
+        pc = frame.ints[in.a] == 0 ? in.imm : pc + 1;
+        break;
+      case JUMP_NONZERO:
+        pc = frame.ints[in.a] != 0 ? in.imm : pc + 1;
+        break;
+      default:
+        execute(in, frame, context);
+        pc++;
+        break;
+    }
+  }
+}
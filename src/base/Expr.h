@@ -0,0 +1,145 @@
+
+#ifndef PQ_EXPR_H_
+#define PQ_EXPR_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "History.h"
+
+class Pattern;
+class WordSet;
+
+/**
+ *  A predicate over a word and a history, written in a small expression language and compiled to bytecode.
+ *
+ *  Values are integers or strings; booleans are integers. The operators are those of C, from loosest to tightest:
+ *  ?:, ||, &&, == and !=, <, <=, > and >=, + and -, *, / and %, and the unary ! and -. Two strings can be
+ *  compared, and + on two strings concatenates them. Division by zero gives zero. String literals are quoted
+ *  with either kind of quote.
+ *
+ *  Names: word, last, last_accepted, last_rejected (strings), and guesses, accepted, rejected (counts).
+ *
+ *  Functions: len(s), sum_a1z26(s), vowels(s), count(s, t), contains(s, t), starts_with(s, t), ends_with(s, t),
+ *  matches(s, pattern) (see Pattern.h), at(s, i) (the i-th letter, counting from the end if negative, or "" out of
+ *  range), lower(s), upper(s), trim(s), edit_distance(s, t), in_dictionary(s), in_category(s, name) (where the name
+ *  may combine categories, as in "colors|animals"; see Category.h), count_containing(s), rhymes(s, t),
+ *  sounds_like(s, t), guessed(s), and chance(percent), which uses the history's random numbers for the word.
+ *  Strings are UTF-8: len and at count letters as grapheme clusters, lower and upper map case beyond ASCII,
+ *  sum_a1z26 and vowels see letters with diacritics as their base letters (see Utf8.h), and edit_distance counts
+ *  code points, so edit_distance("été", "ete") is 2.
+ *
+ *  The source is parsed once and type-checked, subexpressions that only involve constants are evaluated at
+ *  compile time, and the rest becomes a flat list of typed register instructions. Evaluations run on registers
+ *  kept per thread, so after the first evaluation on a thread they do not allocate unless a string function has
+ *  to build a longer string than before.
+ */ 
+class Expr
+{
+  public:
+
+    /**
+     *  Compiles the source; throws an error describing the first syntax or type error.
+     */ 
+    explicit Expr(const std::string & source);
+
+    ~Expr();
+
+    Expr(const Expr &) = delete;
+    Expr & operator=(const Expr &) = delete;
+
+    /**
+     *  Returns a listing of the bytecode, one instruction per line.
+     */ 
+    std::string disassemble() const;
+
+    /**
+     *  Determines whether the expression reads nothing from the history, so that its value depends on the word
+     *  alone (and the dictionary).
+     */ 
+    bool pure() const;
+
+    /**
+     *  Returns the number of instructions.
+     */ 
+    size_t size() const;
+
+    /**
+     *  Returns the source the expression was compiled from.
+     */ 
+    const std::string & source() const;
+
+    /**
+     *  Evaluates the expression for the word against the history; a nonzero integer is true. Safe to call from
+     *  many threads at once.
+     */ 
+    bool test(std::string_view word, const History & history) const;
+
+    /**
+     *  The operations of the bytecode.
+     */ 
+    enum Op : uint8_t
+    {
+      // Control flow.
+      RET, JUMP, JUMP_ZERO, JUMP_NONZERO, MOVE_INT, MOVE_STR, BOOL,
+
+      // Integer arithmetic and comparison.
+      NEG, NOT, ADD, SUB, MUL, DIV, MOD, EQ, NE, LT, LE, GT, GE,
+
+      // String comparison and concatenation.
+      STR_EQ, STR_NE, STR_LT, STR_LE, STR_GT, STR_GE, CONCAT,
+
+      // Names.
+      WORD, LAST, LAST_ACCEPTED, LAST_REJECTED, GUESSES, ACCEPTED, REJECTED,
+
+      // Functions.
+      LEN, SUM_A1Z26, VOWELS, COUNT, CONTAINS, STARTS_WITH, ENDS_WITH, MATCHES, AT, LOWER, UPPER, TRIM,
+      EDIT_DISTANCE, IN_DICTIONARY, IN_CATEGORY, COUNT_CONTAINING, RHYMES, SOUNDS_LIKE, GUESSED, CHANCE
+    };
+
+    /**
+     *  One instruction: an operation on up to two registers, writing a third. Jumps keep their target in imm,
+     *  and a match against a constant pattern keeps one more than the index of the compiled pattern.
+     */ 
+    struct Instruction
+    {
+      Op       op;
+      uint8_t  dst;
+      uint8_t  a;
+      uint8_t  b;
+      uint32_t imm;
+    };
+
+    /**
+     *  The registers of one evaluation. Constants are loaded once, when the frame is first used for a program.
+     *  The frame also keeps the word category last resolved, along with the id of the index it came from.
+     */ 
+    struct Frame
+    {
+      uint64_t                      program {0};
+      std::vector<int64_t>          ints;
+      std::vector<std::string_view> strs;
+      std::vector<std::string>      owned;
+      std::string                   scratch;
+      uint64_t                      categories {0};
+      std::string                   category;
+      const WordSet *               words      {nullptr};
+    };
+
+  private:
+
+    friend class ExprCompiler;
+
+    std::string              m_source;
+    uint64_t                 m_id;
+    std::vector<Instruction> m_code;
+    std::vector<int64_t>     m_int_constants;
+    std::vector<std::string> m_str_constants;
+
+    std::vector<std::unique_ptr<Pattern>> m_patterns;
+};
+
+#endif
@@ -0,0 +1,120 @@
+
+#include <algorithm>
+#include <future>
+
+#include "Dictionary.h"
+#include "GuessBatch.h"
+#include "Memory.h"
+#include "Parallel.h"
+#include "RuleCache.h"
+#include "Watchdog.h"
+
+GuessBatch::GuessBatch(const Rule & rule)
+  : m_rule {rule}
+{
+  // Pure rules never read the history, but may still expect it to be set up.
+
+  if (rule.pure()) rule.initialize(m_pure_history);
+}
+
+size_t GuessBatch::play(const std::vector<std::string> & words, History & history, const std::function<void(const Guess &)> & played)
+{
+  // A pure rule's lookups need the dictionary, and taking it here pins it, so that the threads preparing chunks
+  // ahead see the same one. Other rules need not wait for it to load.
+
+  const Dictionary * dictionary = m_rule.pure() ? &Dictionary::instance() : Dictionary::pinned();
+  Memory::Subsystem subsystem = Memory::current();
+  Watchdog::Meter meter = Watchdog::instance().meter(m_rule);
+
+  auto end = [&](size_t begin) { return std::min(begin + chunk_size, words.size()); };
+  auto ahead = [&](size_t begin)
+  {
+    return std::async(std::launch::async, [this, &words, dictionary, subsystem, begin, stop = end(begin)]()
+    {
+      Dictionary::Pin pin {dictionary};
+      Memory::Scope charged {subsystem};
+      return prepare(words, begin, stop);
+    });
+  };
+
+  std::future<Chunk> next {};
+  size_t count = 0;
+
+  for (size_t begin = 0; begin < words.size(); begin = end(begin))
+  {
+    Chunk chunk = next.valid() ? next.get() : prepare(words, begin, end(begin));
+    if (end(begin) < words.size()) next = ahead(end(begin));
+
+    for (size_t i = 0; i < chunk.features.size(); i++)
+    {
+      if (meter.quarantined())
+      {
+        return count;
+      }
+
+      if (chunk.errors[i])
+      {
+        std::rethrow_exception(chunk.errors[i]);
+      }
+
+      const Features & features = * chunk.features[i];
+      if (! chunk.verdicts[i])
+      {
+        Features::Scope scope {features};
+        chunk.verdicts[i] = meter.evaluate(features.word, history);
+      }
+
+      Guess guess {features.word, chunk.verdicts[i]->accepted};
+      played(guess);
+      history.push(guess, chunk.verdicts[i]->delta);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+GuessBatch::Chunk GuessBatch::prepare(const std::vector<std::string> & words, size_t begin, size_t end) const
+{
+  size_t n = end - begin;
+  Chunk chunk {};
+  chunk.features.resize(n);
+  chunk.verdicts.resize(n);
+  chunk.errors.resize(n);
+
+  const Dictionary & dictionary = Dictionary::instance();
+  const Bitmap * cached = m_rule.pure() ? RuleCache::instance().find(m_rule) : nullptr;
+
+  parallel_for(n, [&](size_t from, size_t to, size_t)
+  {
+    Watchdog::Meter meter = Watchdog::instance().meter(m_rule);
+
+    for (size_t i = from; i < to; i++)
+    {
+      const Features & features = chunk.features[i].emplace(words[begin + i]);
+      if (! m_rule.pure())
+      {
+        continue;
+      }
+
+      Dictionary::Id id = cached ? dictionary.find(features.word) : Dictionary::npos;
+      if (id != Dictionary::npos)
+      {
+        chunk.verdicts[i] = Verdict {cached->test(id)};
+        continue;
+      }
+
+      try
+      {
+        Features::Scope scope {features};
+        chunk.verdicts[i] = meter.evaluate(features.word, m_pure_history);
+      }
+      catch (...)
+      {
+        chunk.errors[i] = std::current_exception();
+      }
+    }
+  }, 64);
+
+  return chunk;
+}
@@ -0,0 +1,69 @@
+
+#ifndef PQ_GUESS_BATCH_H_
+#define PQ_GUESS_BATCH_H_
+
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Guess.h"
+#include "History.h"
+#include "Rule.h"
+#include "String.h"
+
+/**
+ *  Plays many guesses against one rule in order, with the same outcome as guessing them one at a time.
+ *
+ *  Guesses are played in chunks, and each chunk is prepared on other threads while the one before is played:
+ *  the words' features are extracted (see Features in String.h), and, for a pure rule, the verdicts are worked
+ *  out in full, by lookup in its cached bitmap (see RuleCache.h) where there is one and by evaluating it on a
+ *  history of its own otherwise. Playing a chunk then only evaluates what depends on the history, and pushes
+ *  the guesses in order.
+ *
+ *  Calls are timed in place with a meter, as bulk passes are (see Watchdog.h): a slow call delays the batch
+ *  instead of being dropped, and strikes against the rule as usual. Once the rule is quarantined, the batch
+ *  stops.
+ */ 
+class GuessBatch
+{
+  public:
+
+    /**
+     *  Sets up a batch against the rule.
+     */ 
+    explicit GuessBatch(const Rule & rule);
+
+    /**
+     *  Plays the words in order against the history. Before each guess is pushed, calls played with the guess,
+     *  while the history is still as it was. Returns the number of words played, which is short of all of them
+     *  if the rule got quarantined. An exception thrown by the rule is rethrown once the guesses before it have
+     *  been played.
+     */ 
+    size_t play(const std::vector<std::string> & words, History & history, const std::function<void(const Guess &)> & played);
+
+  private:
+
+    /**
+     *  What is worked out for one chunk ahead of playing it.
+     */ 
+    struct Chunk
+    {
+      std::vector<std::optional<Features>> features;
+      std::vector<std::optional<Verdict>>  verdicts;
+      std::vector<std::exception_ptr>      errors;
+    };
+
+    /**
+     *  Prepares the words in [begin, end), in parallel.
+     */ 
+    Chunk prepare(const std::vector<std::string> & words, size_t begin, size_t end) const;
+
+    static constexpr size_t chunk_size = 1024;
+
+    const Rule & m_rule;
+    History      m_pure_history;
+};
+
+#endif
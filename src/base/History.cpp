@@ -1,9 +1,66 @@
 
+#include <cctype>
 #include <iomanip>
 
 #include "Error.h"
 #include "Logging.h"
 #include "History.h"
+#include "Memory.h"
+#include "Random.h"
+#include "String.h"
+#include "Utf8.h"
+
+thread_local History::Recording * History::t_recording = nullptr;
+
+History::Recording::Recording(const History & history, nlohmann::json & delta)
+  : m_history {&history}
+  , m_delta {&delta}
+  , m_previous {t_recording}
+{
+  t_recording = this;
+}
+
+History::Recording::~Recording()
+{
+  t_recording = m_previous;
+}
+
+int64_t History::aggregate_get(const std::string & name, bool accepted) const
+{
+  auto it = m_totals->aggregates.find(name);
+  if (it == m_totals->aggregates.end())
+  {
+    THROW_ERROR("The history has no aggregate named '", name, "'.");
+  }
+
+  return accepted ? it->second.accepted : it->second.rejected;
+}
+
+int64_t History::aggregate_get(const std::string & name) const
+{
+  return aggregate_get(name, true) + aggregate_get(name, false);
+}
+
+bool History::aggregate_has(const std::string & name) const
+{
+  return m_totals->aggregates.count(name) > 0;
+}
+
+void History::aggregate_register(const std::string & name, Measure measure)
+{
+  Aggregate aggregate {std::make_shared<const Measure>(std::move(measure))};
+  m_guessed.for_each([&](const Guess & guess)
+  {
+    (guess.accepted ? aggregate.accepted : aggregate.rejected) += (* aggregate.measure)(guess);
+  });
+
+  totals().aggregates[name] = std::move(aggregate);
+}
+
+bool History::chance(const std::string & word, double probability, uint32_t stream) const
+{
+  return uniform(word, stream) < probability;
+}
 
 size_t History::count() const
 {
@@ -29,10 +86,10 @@ std::ostream & History::format(std::ostream & out) const
   }
 
   size_t pad = 9;
-  for (Guess guess : m_guessed)
+  m_guessed.for_each([&](const Guess & guess)
   {
     pad = std::max(pad, guess.word.size());
-  }
+  });
 
   U_LOGI("History:");
 
@@ -45,7 +102,7 @@ std::ostream & History::format(std::ostream & out) const
     << "\n"
     << std::setfill(' ');
 
-  for (Guess guess : m_guessed)
+  m_guessed.for_each([&](const Guess & guess)
   {
     if (guess.accepted)
     {
@@ -64,7 +121,7 @@ std::ostream & History::format(std::ostream & out) const
         << std::setw(pad) << std::left << guess.word 
         << "\n";
     }
-  }
+  });
 
   out << "\n";
   return out;
@@ -78,10 +135,8 @@ std::vector<Guess> History::get(size_t n) const
   }
 
   std::vector<Guess> retval {};
-  for (int i = count() - 1; i > count() - 1 - n; i--)
-  {
-    retval.push_back(m_guessed[i]);
-  }
+  retval.reserve(n);
+  m_guessed.for_recent(n, [&](const Guess & guess){ retval.push_back(guess); });
 
   return retval;
 }
@@ -94,10 +149,8 @@ std::vector<std::string> History::get_accepted(size_t n) const
   }
 
   std::vector<std::string> retval {};
-  for (int i = count_accepted() - 1; i > count_accepted() - 1 - n; i--)
-  {
-    retval.push_back(m_accepted[i].word);
-  }
+  retval.reserve(n);
+  m_accepted.for_recent(n, [&](const Guess & guess){ retval.push_back(guess.word); });
 
   return retval;
 }
@@ -110,14 +163,17 @@ std::vector<std::string> History::get_rejected(size_t n) const
   }
 
   std::vector<std::string> retval {};
-  for (int i = count_rejected() - 1; i > count_rejected() - 1 - n; i--)
-  {
-    retval.push_back(m_rejected[i].word);
-  }
+  retval.reserve(n);
+  m_rejected.for_recent(n, [&](const Guess & guess){ retval.push_back(guess.word); });
 
   return retval;
 }
 
+bool History::guessed(const std::string & word) const
+{
+  return times_guessed(word) > 0;
+}
+
 Guess History::peek() const
 {
   return m_guessed.empty() ? Guess() : m_guessed.back();
@@ -135,8 +191,57 @@ std::string History::peek_rejected() const
 
 void History::push(const Guess & guess)
 {
+  Memory::Scope charged {Memory::HISTORY};
   m_guessed.push_back(guess);
   (guess.accepted ? m_accepted : m_rejected).push_back(guess);
+  std::string folded = lower(guess.word);
+  const uint32_t * times = m_times_guessed.find(folded);
+  m_times_guessed.set(folded, times ? * times + 1 : 1);
+
+  Totals & totals = this->totals();
+  Tally & tally = totals.tallies[guess.accepted];
+  std::array<bool, 26> seen {};
+
+  // Letters with diacritics count as their base letter and lengths in grapheme clusters, as in String.h.
+
+  const std::string & word = guess.word;
+  for (size_t at = 0; at < word.size(); )
+  {
+    char32_t ch = (unsigned char) word[at] < 0x80 ? std::tolower(word[at++]) : utf8_base(utf8_decode(word, at));
+    int c = (unsigned) (ch - 'a') < 26 ? ch - 'a' : -1;
+    if (c < 0) continue;
+
+    tally.letters[c]++;
+    tally.words_with[c] += ! seen[c];
+    tally.a1z26 += c + 1;
+    tally.characters++;
+    tally.vowels += (c == 0 || c == 4 || c == 8 || c == 14 || c == 20);
+    seen[c] = true;
+  }
+
+  size_t length = utf8_clusters(word);
+  if (tally.lengths.size() <= length)
+  {
+    tally.lengths.resize(length + 1);
+  }
+
+  tally.lengths[length]++;
+
+  for (auto & [name, aggregate] : totals.aggregates)
+  {
+    (guess.accepted ? aggregate.accepted : aggregate.rejected) += (* aggregate.measure)(guess);
+  }
+}
+
+void History::push(const Guess & guess, const nlohmann::json & delta)
+{
+  push(guess);
+
+  Memory::Scope charged {Memory::RULE_STATE};
+  for (auto & [key, value] : delta.items())
+  {
+    m_state.set(key, value);
+  }
 }
 
 void History::push_accept(const std::string & word)
@@ -165,14 +270,89 @@ void History::push_reject(const std::string & word)
   }
 }
 
+uint64_t History::random(const std::string & word, uint32_t stream) const
+{
+  return random_bits(m_seed, count(), word, stream);
+}
+
+void History::reseed(uint64_t seed)
+{
+  m_seed = seed;
+}
+
+uint64_t History::seed() const
+{
+  return m_seed;
+}
+
+nlohmann::json * History::recording() const
+{
+  for (Recording * at = t_recording; at; at = at->m_previous)
+  {
+    if (at->m_history == this) return at->m_delta;
+  }
+
+  return nullptr;
+}
+
 std::ostream & History::state_format(std::ostream & out) const
 {
-  out << m_state.dump() << std::endl;
+  nlohmann::json state = nlohmann::json::object();
+  m_state.for_each([&](const std::string & key, const nlohmann::json & value){ state[key] = value; });
+
+  out << state.dump() << std::endl;
   return out;
 }
 
 bool History::state_has(const std::string & key) const
 {
-  return m_state.count(key) > 0;
+  nlohmann::json * delta = recording();
+  return m_state.find(key) || (delta && delta->count(key) > 0);
+}
+
+const History::Tally & History::tally(bool accepted) const
+{
+  return m_totals->tallies[accepted];
+}
+
+uint32_t History::Tally::count_letter(char c) const
+{
+  int i = std::tolower((unsigned char) c) - 'a';
+  return i >= 0 && i < 26 ? letters[i] : 0;
+}
+
+uint32_t History::Tally::count_length(size_t length) const
+{
+  return length < lengths.size() ? lengths[length] : 0;
+}
+
+uint32_t History::Tally::count_words_with(char c) const
+{
+  int i = std::tolower((unsigned char) c) - 'a';
+  return i >= 0 && i < 26 ? words_with[i] : 0;
+}
+
+size_t History::times_guessed(const std::string & word) const
+{
+  const uint32_t * times = m_times_guessed.find(lower(word));
+  return times ? * times : 0;
+}
+
+History::Totals & History::totals()
+{
+  // Only this history can be copying itself, so a count of one cannot grow under the check.
+
+  if (m_totals.use_count() > 1)
+  {
+    Memory::Scope charged {Memory::HISTORY};
+    m_totals = std::make_shared<Totals>(* m_totals);
+  }
+
+  return * m_totals;
+}
+
+double History::uniform(const std::string & word, uint32_t stream) const
+{
+  return random_unit(random(word, stream));
 }
 
@@ -4,28 +4,144 @@
 
 #include <nlohmann/json.hpp>
 
+#include <array>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Error.h"
 #include "Guess.h"
+#include "Memory.h"
+#include "Persistent.h"
+
+/**
+ *  The outcome of evaluating a word against a history: the decision, plus the state writes made while 
+ *  deciding. The writes only take effect once the guess is pushed with the delta. The delta stays null until
+ *  the first write, so that evaluating a rule that keeps no state does not allocate.
+ */ 
+struct Verdict
+{
+  bool           accepted {false};
+  nlohmann::json delta    {};
+};
 
 /**
  *  Stores the word data for a given rule.
  *
  *  Also includes an arbitrary json object that can be used to get and set arbitrary states.
+ *
+ *  A const history is never modified: state writes made through a const reference, as rules do in 
+ *  Rule::test, go to the delta of the evaluation in progress on the calling thread (see Recording), and are
+ *  committed by push. Any number of threads may therefore evaluate words against one shared history.
+ *
+ *  Aggregates over the whole game (which words were guessed, letter and length counts, running sums, and any
+ *  aggregate a rule registers) are updated on every push, so querying them costs the same however long the
+ *  game has been running.
+ *
+ *  Guesses and state are held in persistent structures, and the running totals in a block that copies share
+ *  until one of them pushes, so copying a history copies a few pointers; pushing onto either copy leaves the
+ *  other as it was. Keeping copies is how games are undone and branched.
  */ 
 class History
 {
   public:
 
+    /**
+     *  Measures one guess for a registered aggregate; see aggregate_register.
+     */ 
+    using Measure = std::function<int64_t(const Guess &)>;
+
+    /**
+     *  Running totals over either the accepted or the rejected guesses. Letters are counted case-insensitively,
+     *  letters with diacritics as their base letter, and characters other than the letters a to z are ignored
+     *  except in the lengths, which are counted in grapheme clusters as length() in String.h counts them.
+     */ 
+    struct Tally
+    {
+      std::array<uint32_t, 26> letters    {};
+      std::array<uint32_t, 26> words_with {};
+      std::vector<uint32_t>    lengths    {};
+      uint64_t                 a1z26      {0};
+      uint64_t                 characters {0};
+      uint64_t                 vowels     {0};
+
+      /**
+       *  Returns the number of times the letter occurs across the words.
+       */ 
+      uint32_t count_letter(char c) const;
+
+      /**
+       *  Returns the number of words with the given length.
+       */ 
+      uint32_t count_length(size_t length) const;
+
+      /**
+       *  Returns the number of words that contain the letter.
+       */ 
+      uint32_t count_words_with(char c) const;
+    };
+
+    /**
+     *  Routes the const state writes made to a history on this thread into a delta, for as long as it lives.
+     *  Reads on that thread see the delta's values over the history's own. Recordings nest.
+     */ 
+    class Recording
+    {
+      public:
+
+        Recording(const History & history, nlohmann::json & delta);
+
+        ~Recording();
+
+        Recording(const Recording &) = delete;
+        Recording & operator=(const Recording &) = delete;
+
+      private:
+
+        friend class History;
+
+        const History *  m_history;
+        nlohmann::json * m_delta;
+        Recording *      m_previous;
+    };
+
     /**
      *  Creates an empty history.
      */ 
     History() = default;
 
+    /**
+     *  Gets the running total of the given registered aggregate over the accepted or the rejected guesses.
+     *  Throws an error if there is no such aggregate.
+     */ 
+    int64_t aggregate_get(const std::string & name, bool accepted) const;
+
+    /**
+     *  Gets the running total of the given registered aggregate over all guesses.
+     */ 
+    int64_t aggregate_get(const std::string & name) const;
+
+    /**
+     *  Determines whether an aggregate with the given name has been registered.
+     */ 
+    bool aggregate_has(const std::string & name) const;
+
+    /**
+     *  Registers an aggregate that sums the measure over the guesses, typically from Rule::initialize. Guesses
+     *  already in the history are measured straight away; later ones are measured as they are pushed.
+     *  Registering a name again replaces the measure.
+     */ 
+    void aggregate_register(const std::string & name, Measure measure);
+
+    /**
+     *  Determines whether a random event with the given probability happens for this word at this point in the game.
+     *  See random().
+     */ 
+    bool chance(const std::string & word, double probability, uint32_t stream = 0) const;
+
     /**
      *  Returns the number of guesses.
      */ 
@@ -46,6 +162,11 @@ class History
      */ 
     std::ostream & format(std::ostream & out) const;
 
+    /**
+     *  Determines whether the word has been guessed before, in any case.
+     */ 
+    bool guessed(const std::string & word) const;
+
     /**
      *  Returns the desired number of guesses in chronological order, with the most recent guesses first.
      */ 
@@ -81,6 +202,11 @@ class History
      */ 
     void push(const Guess & guess);
 
+    /**
+     *  Adds the guess to the history and commits the state delta recorded while evaluating it.
+     */ 
+    void push(const Guess & guess, const nlohmann::json & delta);
+
     /**
      *  Accepts the given word and adds the guess to the history.
      */ 
@@ -91,6 +217,38 @@ class History
      */ 
     void push_reject(const std::string & word);
 
+    /**
+     *  Returns 64 random bits that depend only on the session seed, the number of guesses so far, the word and 
+     *  the stream. A probabilistic rule therefore always gives the same answer for the same word at the same point
+     *  of the same game, on any thread and without locking, and replays deterministically.
+     */ 
+    uint64_t random(const std::string & word, uint32_t stream = 0) const;
+
+    /**
+     *  Sets the session seed.
+     */ 
+    void reseed(uint64_t seed);
+
+    /**
+     *  Returns the session seed.
+     */ 
+    uint64_t seed() const;
+
+    /**
+     *  Returns a number uniformly distributed in [0, 1) for this word at this point in the game. See random().
+     */ 
+    double uniform(const std::string & word, uint32_t stream = 0) const;
+
+    /**
+     *  Returns the running totals over the accepted or the rejected guesses.
+     */ 
+    const Tally & tally(bool accepted) const;
+
+    /**
+     *  Returns the number of times the word has been guessed, in any case.
+     */ 
+    size_t times_guessed(const std::string & word) const;
+
     /**
      *  Dumps the state to the given stream.
      */ 
@@ -111,14 +269,56 @@ class History
      *  Sets the value at the given key.
      */ 
     template<typename T>
+    void state_set(const std::string & key, T t);
+
+    /**
+     *  Records setting the value at the given key into the delta of the evaluation in progress on this thread.
+     *  Throws an error if no evaluation of this history is in progress.
+     */ 
+    template<typename T>
     void state_set(const std::string & key, T t) const;
 
   private:
 
-    std::vector<Guess> m_guessed;
-    std::vector<Guess> m_accepted;
-    std::vector<Guess> m_rejected;
-    nlohmann::json     m_state;
+    /**
+     *  A registered aggregate, with its totals over the accepted and rejected guesses.
+     */ 
+    struct Aggregate
+    {
+      std::shared_ptr<const Measure> measure;
+      int64_t                        accepted {0};
+      int64_t                        rejected {0};
+    };
+
+    /**
+     *  The running totals over the accepted and the rejected guesses, and the registered aggregates.
+     */ 
+    struct Totals
+    {
+      std::array<Tally, 2>             tallies;
+      std::map<std::string, Aggregate> aggregates;
+    };
+
+    /**
+     *  Returns the delta recording this history's writes on this thread, or null if there is none.
+     */ 
+    nlohmann::json * recording() const;
+
+    /**
+     *  Returns the running totals for updating, first copying them if another history shares them.
+     */ 
+    Totals & totals();
+
+    static thread_local Recording * t_recording;
+
+    PersistentLog<Guess>                       m_guessed;
+    PersistentLog<Guess>                       m_accepted;
+    PersistentLog<Guess>                       m_rejected;
+    PersistentMap<std::string, nlohmann::json> m_state;
+    uint64_t                                   m_seed {0};
+
+    PersistentMap<std::string, uint32_t>       m_times_guessed;
+    std::shared_ptr<Totals>                    m_totals {std::make_shared<Totals>()};
 };
 
 template<typename T>
@@ -129,14 +329,29 @@ T History::state_get(const std::string & key) const
     THROW_ERROR("The history does not contain the key '", key, "'.");
   }
 
-  T ret = m_state.at(key);
+  nlohmann::json * delta = recording();
+  T ret = delta && delta->count(key) > 0 ? delta->at(key) : * m_state.find(key);
   return ret;
 }
 
+template<typename T>
+void History::state_set(const std::string & key, T t)
+{
+  Memory::Scope charged {Memory::RULE_STATE};
+  m_state.set(key, t);
+}
+
 template<typename T>
 void History::state_set(const std::string & key, T t) const
 {
-  const_cast<nlohmann::json &>(m_state)[key] = t;
+  nlohmann::json * delta = recording();
+  if (! delta)
+  {
+    THROW_ERROR("Cannot set '", key, "' on a const history outside of an evaluation; use Rule::evaluate.");
+  }
+
+  Memory::Scope charged {Memory::RULE_STATE};
+  (* delta)[key] = t;
 }
 
 #endif
@@ -0,0 +1,117 @@
+
+#include <algorithm>
+
+#include "Job.h"
+
+namespace
+{
+  thread_local Job * t_current = nullptr;
+}
+
+Job::Scope::Scope(Job * job)
+  : m_previous {t_current}
+{
+  t_current = job;
+}
+
+Job::Scope::~Scope()
+{
+  t_current = m_previous;
+}
+
+Job::Job(size_t id, const std::string & command)
+  : m_id {id}
+  , m_command {command}
+{}
+
+void Job::advance(uint64_t units)
+{
+  if (t_current) t_current->m_done.fetch_add(units, std::memory_order_relaxed);
+}
+
+void Job::cancel()
+{
+  m_cancelled = true;
+}
+
+bool Job::cancelled() const
+{
+  return m_cancelled.load(std::memory_order_relaxed);
+}
+
+void Job::checkpoint()
+{
+  if (t_current && t_current->cancelled())
+  {
+    throw Cancelled {};
+  }
+}
+
+const std::string & Job::command() const
+{
+  return m_command;
+}
+
+Job * Job::current()
+{
+  return t_current;
+}
+
+double Job::elapsed() const
+{
+  if (m_state.load() == State::QUEUED)
+  {
+    return 0;
+  }
+
+  int64_t ran = m_ran.load();
+  if (ran >= 0)
+  {
+    return ran * 1e-9;
+  }
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_started).count();
+}
+
+void Job::expect(uint64_t units)
+{
+  if (t_current) t_current->m_expected.fetch_add(units, std::memory_order_relaxed);
+}
+
+void Job::finish(State state)
+{
+  m_ran = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_started).count();
+  m_state = state;
+}
+
+size_t Job::id() const
+{
+  return m_id;
+}
+
+std::ostringstream & Job::output()
+{
+  return m_output;
+}
+
+double Job::progress() const
+{
+  uint64_t expected = m_expected.load(std::memory_order_relaxed);
+  if (expected == 0)
+  {
+    return -1;
+  }
+
+  return std::min(1.0, (double) m_done.load(std::memory_order_relaxed) / expected);
+}
+
+void Job::start()
+{
+  m_started = std::chrono::steady_clock::now();
+  m_state = State::RUNNING;
+}
+
+Job::State Job::state() const
+{
+  return m_state.load();
+}
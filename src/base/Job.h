@@ -0,0 +1,146 @@
+
+#ifndef PQ_JOB_H_
+#define PQ_JOB_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+/**
+ *  A command running in the background: its progress, its buffered output and whether it was asked to stop.
+ *
+ *  Work finds the job it runs for through current, which parallel_for carries over to its workers. Bulk loops
+ *  call checkpoint every so often, which throws Cancelled once the job was cancelled, and report how far they
+ *  got through expect and advance. Outside of a job these calls cost one thread-local read and do nothing.
+ */ 
+class Job
+{
+  public:
+
+    enum class State
+    {
+      QUEUED,
+      RUNNING,
+      DONE,
+      CANCELLED,
+      FAILED
+    };
+
+    /**
+     *  Thrown by checkpoint to unwind the work of a cancelled job. Deliberately not an Error, so that commands
+     *  catching their own errors let it through.
+     */ 
+    struct Cancelled {};
+
+    /**
+     *  Makes the given job the calling thread's current one for as long as it lives.
+     */ 
+    class Scope
+    {
+      public:
+
+        explicit Scope(Job * job);
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+      private:
+
+        Job * m_previous;
+    };
+
+    Job(size_t id, const std::string & command);
+
+    Job(const Job &) = delete;
+    Job & operator=(const Job &) = delete;
+
+    /**
+     *  Adds units of work done to the current job's progress.
+     */ 
+    static void advance(uint64_t units);
+
+    /**
+     *  Throws Cancelled if the current job was cancelled.
+     */ 
+    static void checkpoint();
+
+    /**
+     *  Returns the job the calling thread works for, or null on the foreground.
+     */ 
+    static Job * current();
+
+    /**
+     *  Adds units of work to the current job's expected total.
+     */ 
+    static void expect(uint64_t units);
+
+    /**
+     *  Asks the job to stop at its next checkpoint.
+     */ 
+    void cancel();
+
+    /**
+     *  Determines whether the job was asked to stop.
+     */ 
+    bool cancelled() const;
+
+    /**
+     *  Returns the command line that started the job.
+     */ 
+    const std::string & command() const;
+
+    /**
+     *  Returns the time in seconds the job has run so far, or ran for once finished.
+     */ 
+    double elapsed() const;
+
+    /**
+     *  Marks the job as finished in the given state.
+     */ 
+    void finish(State state);
+
+    /**
+     *  Returns the job's number.
+     */ 
+    size_t id() const;
+
+    /**
+     *  Returns the buffer the job's output goes to. Only the job's own thread may write to it while it runs.
+     */ 
+    std::ostringstream & output();
+
+    /**
+     *  Returns the fraction of the expected work done so far, or a negative number if nothing was expected.
+     */ 
+    double progress() const;
+
+    /**
+     *  Marks the job as running.
+     */ 
+    void start();
+
+    /**
+     *  Returns the job's state.
+     */ 
+    State state() const;
+
+  private:
+
+    size_t                                m_id;
+    std::string                           m_command;
+    std::ostringstream                    m_output;
+
+    std::atomic<State>                    m_state     {State::QUEUED};
+    std::atomic<bool>                     m_cancelled {false};
+    std::atomic<uint64_t>                 m_done      {0};
+    std::atomic<uint64_t>                 m_expected  {0};
+
+    std::chrono::steady_clock::time_point m_started   {};
+    std::atomic<int64_t>                  m_ran       {-1}; // nanoseconds, once finished
+};
+
+#endif
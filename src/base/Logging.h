@@ -2,6 +2,7 @@
 #ifndef PQ_LOGGING_H_
 #define PQ_LOGGING_H_
 
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -10,6 +11,18 @@
 #include <sstream>
 #include <thread>
 
+#include "Memory.h"
+
+/**
+ *  Returns the stream that log messages from the calling thread go to: standard out, unless a background job
+ *  redirected its own thread's messages into its output.
+ */ 
+inline std::ostream *& log_stream()
+{
+  thread_local std::ostream * stream = &std::cout;
+  return stream;
+}
+
 /**
  *  Logs a string to standard out as well as the logfile. 
  */ 
@@ -17,11 +30,12 @@ inline void log(const std::string & s)
 {
   std::mutex s_mtx;
   std::lock_guard guard {s_mtx};
+  Memory::Scope charged {Memory::LOGGING};
   std::string out = s;
 
   if (s.empty() || s.back() != '\n') out = out + "\n";
 
-  std::cout << out;
+  * log_stream() << out;
 }
 
 /**
@@ -30,6 +44,7 @@ inline void log(const std::string & s)
 template<typename ... Ts>
 inline std::string log_print(const Ts & ... args)
 {
+  Memory::Scope charged {Memory::LOGGING};
   std::stringstream ss {};
   (ss << ... << args);
   return ss.str();
@@ -42,12 +57,22 @@ inline std::string log_print(const Ts & ... args)
 template<typename ... Ts>
 inline void log(const Ts & ... args)
 {
+  Memory::Scope charged {Memory::LOGGING};
   std::ostringstream ss {};
   (ss << ... << args);
   log(ss.str());
 }
 
-#define U_LOG(...) log(__VA_ARGS__, "\n\n")
+/**
+ *  Returns the flag that mutes every U_LOG* macro, as replaying a trace does. Muted messages are not even formatted.
+ */ 
+inline std::atomic<bool> & log_muted()
+{
+  static std::atomic<bool> muted {false};
+  return muted;
+}
+
+#define U_LOG(...) (log_muted() ? static_cast<void>(0) : log(__VA_ARGS__, "\n\n"))
 
 #define GET_TAG(severity, file, func, line) "\033[4m", std::this_thread::get_id(), "\033[0m \033[4m", severity, "/", std::filesystem::path{file}.filename(), ":", func, ":", line, ": \033[0m\n"
 
@@ -0,0 +1,200 @@
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "Memory.h"
+
+namespace
+{
+  /**
+   *  The counters of one subsystem. Constant-initialized, so that allocations made before any constructor ran
+   *  are counted too.
+   */
+  struct Counters
+  {
+    std::atomic<uint64_t> live        {0};
+    std::atomic<uint64_t> peak        {0};
+    std::atomic<uint64_t> allocations {0};
+  };
+
+  Counters counters[Memory::SUBSYSTEMS + 1] {}; // the last one counts all subsystems together
+
+#ifdef PQ_MEMORY_ACCOUNTING
+  /**
+   *  Precedes every allocation, recording what to charge back when it is freed. Its size keeps the allocation
+   *  behind it aligned as operator new promises.
+   */
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header
+  {
+    uint64_t          size;
+    Memory::Subsystem subsystem;
+  };
+
+  void charge(Counters & counters, uint64_t size)
+  {
+    uint64_t live = counters.live.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peak.load(std::memory_order_relaxed);
+    while (live > peak && ! counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void * allocate(size_t size)
+  {
+    Header * header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+    if (! header)
+    {
+      throw std::bad_alloc {};
+    }
+
+    header->size = size;
+    header->subsystem = Memory::current();
+
+    charge(counters[header->subsystem], size);
+    charge(counters[Memory::SUBSYSTEMS], size);
+    return header + 1;
+  }
+
+  void release(void * pointer)
+  {
+    if (! pointer) return;
+
+    Header * header = static_cast<Header *>(pointer) - 1;
+    counters[header->subsystem].live.fetch_sub(header->size, std::memory_order_relaxed);
+    counters[Memory::SUBSYSTEMS].live.fetch_sub(header->size, std::memory_order_relaxed);
+    std::free(header);
+  }
+#endif
+
+  /**
+   *  Formats a number of bytes with a binary unit.
+   */
+  std::string bytes(uint64_t n)
+  {
+    const char * units[] {"B", "KiB", "MiB", "GiB"};
+    double value = n;
+    size_t unit = 0;
+
+    while (value >= 1024 && unit + 1 < std::size(units))
+    {
+      value /= 1024;
+      unit++;
+    }
+
+    std::ostringstream ss {};
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+    return ss.str();
+  }
+
+  /**
+   *  Returns a field of /proc/self/status in bytes, or zero if it is unavailable.
+   */
+  uint64_t status(const std::string & field)
+  {
+    std::ifstream fs {"/proc/self/status"};
+    std::string line {};
+
+    while (std::getline(fs, line))
+    {
+      if (line.compare(0, field.size() + 1, field + ":") == 0)
+      {
+        return std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) * 1024;
+      }
+    }
+
+    return 0;
+  }
+}
+
+#ifdef PQ_MEMORY_ACCOUNTING
+void * operator new(size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new[](size_t size)
+{
+  return allocate(size);
+}
+
+void operator delete(void * pointer) noexcept
+{
+  release(pointer);
+}
+
+void operator delete[](void * pointer) noexcept
+{
+  release(pointer);
+}
+
+void operator delete(void * pointer, size_t) noexcept
+{
+  release(pointer);
+}
+
+void operator delete[](void * pointer, size_t) noexcept
+{
+  release(pointer);
+}
+#endif
+
+std::ostream & Memory::format(std::ostream & out)
+{
+  if (enabled())
+  {
+    out
+      << std::setw(10) << std::left << "SUBSYSTEM:" << " | "
+      << std::setw(10) << std::right << "LIVE" << " | "
+      << std::setw(10) << "PEAK" << " | "
+      << std::setw(12) << "ALLOCATIONS"
+      << "\n"
+      << std::setw(51) << std::setfill('-') << std::left << "-"
+      << "\n"
+      << std::setfill(' ');
+
+    for (int s = 0; s <= SUBSYSTEMS; s++)
+    {
+      Usage used = usage(Subsystem (s));
+      out
+        << std::setw(10) << std::left << name(Subsystem (s)) << " | "
+        << std::setw(10) << std::right << bytes(used.live) << " | "
+        << std::setw(10) << bytes(used.peak) << " | "
+        << std::setw(12) << used.allocations
+        << "\n";
+    }
+  }
+  else
+  {
+    out << "Built without PQ_MEMORY_ACCOUNTING, so memory is not attributed to subsystems.\n";
+  }
+
+  out << "process: " << bytes(status("VmRSS")) << " resident, " << bytes(status("VmHWM")) << " at peak\n";
+  return out;
+}
+
+const char * Memory::name(Subsystem subsystem)
+{
+  switch (subsystem)
+  {
+    case OTHER:      return "other";
+    case DICTIONARY: return "dictionary";
+    case HISTORY:    return "history";
+    case RULE_STATE: return "rule state";
+    case RULES:      return "rules";
+    case LOGGING:    return "logging";
+    case ERRORS:     return "errors";
+    default:         return "total";
+  }
+}
+
+Memory::Usage Memory::usage(Subsystem subsystem)
+{
+  const Counters & counted = counters[std::min(subsystem, SUBSYSTEMS)];
+  return Usage {counted.live.load(), counted.peak.load(), counted.allocations.load()};
+}
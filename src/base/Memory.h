@@ -0,0 +1,106 @@
+
+#ifndef PQ_MEMORY_H_
+#define PQ_MEMORY_H_
+
+#include <cstdint>
+#include <iostream>
+
+/**
+ *  Attributes heap memory to the subsystems of the program: live bytes, peak bytes and allocation counts.
+ *
+ *  Accounting is opt-in, since it costs a header and a few atomic updates per allocation: building with
+ *  PQ_MEMORY_ACCOUNTING replaces the global operator new and delete with versions that tag every allocation
+ *  with the subsystem in scope on the allocating thread, and charge its release back to the same subsystem
+ *  whichever thread frees it. Code marks the subsystem it works for with a Scope, which parallel_for carries
+ *  over to its workers; allocations outside of any scope count as other. Without the option, scopes compile
+ *  to nothing and only the process totals reported by the kernel are known.
+ */ 
+class Memory
+{
+  public:
+
+    enum Subsystem : uint8_t
+    {
+      OTHER,
+      DICTIONARY,
+      HISTORY,
+      RULE_STATE,
+      RULES,
+      LOGGING,
+      ERRORS,
+      SUBSYSTEMS
+    };
+
+    /**
+     *  What one subsystem holds and has allocated so far.
+     */ 
+    struct Usage
+    {
+      uint64_t live        {0};
+      uint64_t peak        {0};
+      uint64_t allocations {0};
+    };
+
+    /**
+     *  Charges the calling thread's allocations to the given subsystem for as long as it lives.
+     */ 
+    class Scope
+    {
+      public:
+
+#ifdef PQ_MEMORY_ACCOUNTING
+        explicit Scope(Subsystem subsystem) : m_previous {current()} { current() = subsystem; }
+
+        ~Scope() { current() = m_previous; }
+#else
+        explicit Scope(Subsystem) {}
+#endif
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+#ifdef PQ_MEMORY_ACCOUNTING
+      private:
+
+        Subsystem m_previous;
+#endif
+    };
+
+    /**
+     *  Returns the subsystem the calling thread's allocations are charged to.
+     */ 
+    static Subsystem & current()
+    {
+      thread_local Subsystem subsystem = OTHER;
+      return subsystem;
+    }
+
+    /**
+     *  Determines whether the program was built with memory accounting.
+     */ 
+    static constexpr bool enabled()
+    {
+#ifdef PQ_MEMORY_ACCOUNTING
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     *  Prints the usage of every subsystem and of the whole process.
+     */ 
+    static std::ostream & format(std::ostream & out);
+
+    /**
+     *  Returns the name of a subsystem.
+     */ 
+    static const char * name(Subsystem subsystem);
+
+    /**
+     *  Returns the usage of a subsystem, or of all of them together for SUBSYSTEMS.
+     */ 
+    static Usage usage(Subsystem subsystem);
+};
+
+#endif
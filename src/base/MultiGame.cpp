@@ -0,0 +1,83 @@
+
+#include "Dictionary.h"
+#include "MultiGame.h"
+#include "Parallel.h"
+#include "RuleCache.h"
+#include "String.h"
+#include "Watchdog.h"
+
+MultiGame::MultiGame(const std::map<std::string, const Rule *> & table, uint64_t seed)
+  : m_seed {seed}
+{
+  for (auto [name, rule] : table)
+  {
+    m_rules.push_back(rule);
+    m_histories.emplace_back();
+    m_histories.back().reseed(seed);
+    rule->initialize(m_histories.back());
+  }
+}
+
+const History & MultiGame::history(size_t i) const
+{
+  return m_histories[i];
+}
+
+std::vector<std::optional<bool>> MultiGame::probe(const std::string & word)
+{
+  const Features features {word};
+  std::vector<std::optional<Verdict>> verdicts (m_rules.size());
+  Watchdog & watchdog = Watchdog::instance();
+
+  // Pure rules whose bitmaps are cached decide on dictionary words by lookup.
+
+  Dictionary::Id id = Dictionary::instance().find(word);
+  if (id != Dictionary::npos)
+  {
+    RuleCache & cache = RuleCache::instance();
+    for (size_t i = 0; i < m_rules.size(); i++)
+    {
+      const Bitmap * bitmap = cache.find(* m_rules[i]);
+      if (bitmap) verdicts[i] = Verdict {bitmap->test(id)};
+    }
+  }
+
+  // Rules only read their histories while deciding, so all of them can decide before any guess is pushed.
+
+  parallel_for(m_rules.size(), [&](size_t begin, size_t end, size_t)
+  {
+    Features::Scope scope {features};
+
+    for (size_t i = begin; i < end; i++)
+    {
+      if (verdicts[i] || watchdog.quarantined(* m_rules[i])) continue;
+      verdicts[i] = watchdog.evaluate(* m_rules[i], features.word, m_histories[i]);
+    }
+  }, 4);
+
+  std::vector<std::optional<bool>> accepted (m_rules.size());
+  for (size_t i = 0; i < m_rules.size(); i++)
+  {
+    if (! verdicts[i]) continue;
+
+    accepted[i] = verdicts[i]->accepted;
+    m_histories[i].push(Guess {word, verdicts[i]->accepted}, verdicts[i]->delta);
+  }
+
+  return accepted;
+}
+
+const std::vector<const Rule *> & MultiGame::rules() const
+{
+  return m_rules;
+}
+
+uint64_t MultiGame::seed() const
+{
+  return m_seed;
+}
+
+size_t MultiGame::size() const
+{
+  return m_histories.size();
+}
@@ -0,0 +1,65 @@
+
+#ifndef PQ_MULTIGAME_H_
+#define PQ_MULTIGAME_H_
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "History.h"
+#include "Rule.h"
+
+/**
+ *  One game per rule in a table, all played with the same guesses, for asking which rules accept a word.
+ *
+ *  A probe extracts the word's features once (see Features in String.h), evaluates it against every game in
+ *  parallel, and only then pushes the guess onto every history, so either every game sees the guess or, if any
+ *  rule throws, none does. Evaluations run within the watchdog's budget (see Watchdog.h): a rule that overruns
+ *  it, or that is quarantined, makes no decision, and its game does not see the guess. Pure rules whose accept
+ *  bitmaps are cached (see RuleCache.h) decide on dictionary words by lookup instead. All games share one seed.
+ */ 
+class MultiGame
+{
+  public:
+
+    /**
+     *  Starts a game of every rule in the table with the given seed.
+     */ 
+    MultiGame(const std::map<std::string, const Rule *> & table, uint64_t seed);
+
+    /**
+     *  Returns the history of the i-th game.
+     */ 
+    const History & history(size_t i) const;
+
+    /**
+     *  Guesses the word in every game and returns whether each rule accepted it, in the order of rules(), or
+     *  nothing for the rules that made no decision.
+     */ 
+    std::vector<std::optional<bool>> probe(const std::string & word);
+
+    /**
+     *  Returns the rules, one per game, in the table's order.
+     */ 
+    const std::vector<const Rule *> & rules() const;
+
+    /**
+     *  Returns the seed shared by every game.
+     */ 
+    uint64_t seed() const;
+
+    /**
+     *  Returns the number of games.
+     */ 
+    size_t size() const;
+
+  private:
+
+    std::vector<const Rule *> m_rules;
+    std::vector<History>      m_histories;
+    uint64_t                  m_seed;
+};
+
+#endif
@@ -0,0 +1,75 @@
+
+#ifndef PQ_PARALLEL_H_
+#define PQ_PARALLEL_H_
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "Dictionary.h"
+#include "Job.h"
+#include "Memory.h"
+
+/**
+ *  Returns the number of workers that parallel passes split their work across.
+ */ 
+inline unsigned concurrency()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ *  Splits [0, n) into one contiguous chunk per worker and calls body(begin, end, worker) for each chunk on its
+ *  own thread, returning once every chunk is done. Chunks are never smaller than the grain, so small inputs
+ *  use fewer workers. The first exception thrown by any chunk is rethrown on the calling thread. Workers run
+ *  for the calling thread's job, so its checkpoints and progress reach into every chunk, charge their
+ *  allocations to its memory subsystem and see the dictionary it pinned.
+ */ 
+template<typename F>
+void parallel_for(size_t n, F && body, size_t grain = 1)
+{
+  size_t workers = std::min<size_t>(concurrency(), std::max<size_t>(1, n / std::max<size_t>(1, grain)));
+  if (workers <= 1)
+  {
+    body(size_t {0}, n, size_t {0});
+    return;
+  }
+
+  std::vector<std::thread> threads {};
+  std::vector<std::exception_ptr> errors (workers);
+  Job * job = Job::current();
+  Memory::Subsystem subsystem = Memory::current();
+  const Dictionary * dictionary = Dictionary::pinned();
+
+  for (size_t w = 0; w < workers; w++)
+  {
+    threads.emplace_back([&, w]()
+    {
+      Job::Scope scope {job};
+      Memory::Scope charged {subsystem};
+      Dictionary::Pin pin {dictionary};
+
+      try
+      {
+        body(n * w / workers, n * (w + 1) / workers, w);
+      }
+      catch (...)
+      {
+        errors[w] = std::current_exception();
+      }
+    });
+  }
+
+  for (std::thread & thread : threads)
+  {
+    thread.join();
+  }
+
+  for (std::exception_ptr & error : errors)
+  {
+    if (error) std::rethrow_exception(error);
+  }
+}
+
+#endif
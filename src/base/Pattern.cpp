@@ -0,0 +1,613 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+#include "Error.h"
+#include "Parallel.h"
+#include "Pattern.h"
+
+/**
+ *  Parses a pattern into a tree and emits the tree as a Thompson NFA into the pattern.
+ */
+class PatternParser
+{
+  public:
+
+    PatternParser(Pattern & pattern, std::string_view source)
+      : m_pattern {pattern}
+      , m_source {source}
+    {}
+
+    /**
+     *  Parses the whole source and builds the NFA, ending in a single matching state.
+     */
+    void build()
+    {
+      Node root = alternation();
+      if (m_pos < m_source.size())
+      {
+        fail("an unmatched ')'");
+      }
+
+      Fragment fragment = emit(root);
+      int match = add(Pattern::NfaState::MATCH);
+      m_pattern.m_nfa[fragment.end].out = match;
+      m_pattern.m_nfa_start = fragment.start;
+    }
+
+  private:
+
+    /**
+     *  A node of the parse tree. A repetition has one child and a maximum of -1 when it is unbounded.
+     */
+    struct Node
+    {
+      enum Kind { CHARS, CONCAT, ALTERNATION, REPEAT };
+
+      Kind              kind;
+      std::bitset<256>  chars {};
+      std::vector<Node> children {};
+      int               min {0};
+      int               max {-1};
+      bool              trailing {false};
+    };
+
+    /**
+     *  A piece of the NFA with one way in and one way out; the way out is an epsilon state yet to be pointed on.
+     */
+    struct Fragment
+    {
+      int start;
+      int end;
+    };
+
+    static constexpr int MAX_REPEAT = 64;
+
+    int add(Pattern::NfaState::Kind kind, int out = -1, int out1 = -1)
+    {
+      m_pattern.m_nfa.push_back(Pattern::NfaState {kind, {}, out, out1});
+      return m_pattern.m_nfa.size() - 1;
+    }
+
+    Node alternation()
+    {
+      Node node {Node::ALTERNATION};
+      node.children.push_back(concatenation());
+
+      while (m_pos < m_source.size() && m_source[m_pos] == '|')
+      {
+        m_pos++;
+        node.children.push_back(concatenation());
+      }
+
+      return node.children.size() == 1 ? std::move(node.children[0]) : node;
+    }
+
+    /**
+     *  Returns a repetition of any byte, which stands in for a missing anchor.
+     */
+    static Node anything(bool trailing)
+    {
+      Node any {Node::CHARS};
+      any.chars.set();
+
+      Node star {Node::REPEAT};
+      star.trailing = trailing;
+      star.children.push_back(std::move(any));
+      return star;
+    }
+
+    Node atom()
+    {
+      char c = m_source[m_pos++];
+      Node node {Node::CHARS};
+
+      switch (c)
+      {
+        case '(':
+          {
+            m_depth++;
+            node = alternation();
+            if (m_pos >= m_source.size() || m_source[m_pos] != ')') fail("an unclosed '('");
+            m_depth--;
+            m_pos++;
+            break;
+          }
+        case '[':
+          node.chars = bracket();
+          break;
+        case '.':
+          node.chars.set();
+          node.chars.reset('\n');
+          break;
+        case '\\':
+          if (m_pos >= m_source.size()) fail("a trailing backslash");
+          node.chars.set((unsigned char) m_source[m_pos++]);
+          break;
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+          m_pos--;
+          fail("a repetition of nothing");
+        case '^':
+        case '$':
+          m_pos--;
+          fail("an anchor inside an alternative");
+        default:
+          node.chars.set((unsigned char) c);
+          break;
+      }
+
+      return node;
+    }
+
+    std::bitset<256> bracket()
+    {
+      std::bitset<256> chars {};
+      bool negated = m_pos < m_source.size() && m_source[m_pos] == '^';
+      if (negated) m_pos++;
+
+      bool first = true;
+      while (true)
+      {
+        if (m_pos >= m_source.size()) fail("an unclosed '['");
+
+        char c = m_source[m_pos];
+        if (c == ']' && ! first)
+        {
+          m_pos++;
+          break;
+        }
+
+        unsigned char from = bracket_char();
+        unsigned char to = from;
+        if (m_pos + 1 < m_source.size() && m_source[m_pos] == '-' && m_source[m_pos + 1] != ']')
+        {
+          m_pos++;
+          to = bracket_char();
+          if (to < from) fail("a range that runs backwards");
+        }
+
+        for (unsigned b = from; b <= to; b++)
+        {
+          chars.set(b);
+        }
+        first = false;
+      }
+
+      return negated ? ~chars : chars;
+    }
+
+    unsigned char bracket_char()
+    {
+      char c = m_source[m_pos++];
+      if (c != '\\') return c;
+
+      if (m_pos >= m_source.size()) fail("a trailing backslash");
+      return m_source[m_pos++];
+    }
+
+    /**
+     *  Parses one alternative. At the top level, a leading '^' and a trailing '$' anchor it, and each missing
+     *  anchor becomes a repetition of anything on that side, so that the NFA only ever matches whole words.
+     */
+    Node concatenation()
+    {
+      Node node {Node::CONCAT};
+      bool top = m_depth == 0;
+
+      bool anchored_start = top && m_pos < m_source.size() && m_source[m_pos] == '^';
+      if (anchored_start) m_pos++;
+
+      bool anchored_end = false;
+      while (m_pos < m_source.size() && m_source[m_pos] != '|' && m_source[m_pos] != ')')
+      {
+        bool last = m_pos + 1 == m_source.size() || m_source[m_pos + 1] == '|';
+        if (top && last && m_source[m_pos] == '$')
+        {
+          anchored_end = true;
+          m_pos++;
+          break;
+        }
+
+        node.children.push_back(repetition());
+      }
+
+      if (top && ! anchored_start) node.children.insert(node.children.begin(), anything(false));
+      if (top && ! anchored_end) node.children.push_back(anything(true));
+
+      return node.children.size() == 1 ? std::move(node.children[0]) : node;
+    }
+
+    Fragment emit(const Node & node)
+    {
+      switch (node.kind)
+      {
+        case Node::CHARS:
+          {
+            int end = add(Pattern::NfaState::EPSILON);
+            int start = add(Pattern::NfaState::CHARS, end);
+            m_pattern.m_nfa[start].chars = node.chars;
+            return Fragment {start, end};
+          }
+        case Node::CONCAT:
+          {
+            if (node.children.empty())
+            {
+              int end = add(Pattern::NfaState::EPSILON);
+              return Fragment {end, end};
+            }
+
+            Fragment whole = emit(node.children[0]);
+            for (size_t k = 1; k < node.children.size(); k++)
+            {
+              whole = join(whole, emit(node.children[k]));
+            }
+            return whole;
+          }
+        case Node::ALTERNATION:
+          {
+            std::vector<Fragment> branches {};
+            for (const Node & child : node.children)
+            {
+              branches.push_back(emit(child));
+            }
+
+            int end = add(Pattern::NfaState::EPSILON);
+            int start = branches.back().start;
+            for (size_t k = branches.size(); k-- > 0;)
+            {
+              m_pattern.m_nfa[branches[k].end].out = end;
+              if (k + 1 < branches.size()) start = add(Pattern::NfaState::SPLIT, branches[k].start, start);
+            }
+            return Fragment {start, end};
+          }
+        case Node::REPEAT:
+          {
+            int empty = add(Pattern::NfaState::EPSILON);
+            Fragment whole {empty, empty};
+
+            for (int k = 0; k < node.min; k++)
+            {
+              whole = join(whole, emit(node.children[0]));
+            }
+
+            if (node.max < 0)
+            {
+              Fragment body = emit(node.children[0]);
+              int end = add(Pattern::NfaState::EPSILON);
+              int loop = add(Pattern::NfaState::SPLIT, body.start, end);
+              m_pattern.m_nfa[body.end].out = loop;
+              m_pattern.m_nfa[body.start].trailing = node.trailing;
+              return join(whole, Fragment {loop, end});
+            }
+
+            for (int k = node.min; k < node.max; k++)
+            {
+              Fragment body = emit(node.children[0]);
+              int end = add(Pattern::NfaState::EPSILON);
+              int skip = add(Pattern::NfaState::SPLIT, body.start, end);
+              m_pattern.m_nfa[body.end].out = end;
+              whole = join(whole, Fragment {skip, end});
+            }
+            return whole;
+          }
+      }
+
+      return Fragment {};
+    }
+
+    [[noreturn]] void fail(const char * what) const
+    {
+      THROW_ERROR("The pattern '", m_pattern.m_source, "' has ", what, " at position ", m_pos + 1, ".");
+    }
+
+    Fragment join(Fragment a, Fragment b)
+    {
+      m_pattern.m_nfa[a.end].out = b.start;
+      return Fragment {a.start, b.end};
+    }
+
+    int number()
+    {
+      size_t begin = m_pos;
+      int value = 0;
+      while (m_pos < m_source.size() && std::isdigit((unsigned char) m_source[m_pos]))
+      {
+        value = value * 10 + (m_source[m_pos++] - '0');
+        if (value > MAX_REPEAT) fail("a repetition count over 64");
+      }
+
+      if (m_pos == begin) fail("a malformed repetition count");
+      return value;
+    }
+
+    Node repetition()
+    {
+      Node node = atom();
+
+      while (m_pos < m_source.size())
+      {
+        int min = 0;
+        int max = -1;
+
+        switch (m_source[m_pos])
+        {
+          case '*': m_pos++; break;
+          case '+': m_pos++; min = 1; break;
+          case '?': m_pos++; max = 1; break;
+          case '{':
+            {
+              m_pos++;
+              min = max = number();
+              if (m_pos < m_source.size() && m_source[m_pos] == ',')
+              {
+                m_pos++;
+                max = m_pos < m_source.size() && m_source[m_pos] == '}' ? -1 : number();
+              }
+              if (m_pos >= m_source.size() || m_source[m_pos] != '}') fail("an unclosed '{'");
+              if (max >= 0 && max < min) fail("a repetition count that runs backwards");
+              m_pos++;
+              break;
+            }
+          default:
+            return node;
+        }
+
+        Node repeat {Node::REPEAT};
+        repeat.min = min;
+        repeat.max = max;
+        repeat.children.push_back(std::move(node));
+        node = std::move(repeat);
+      }
+
+      return node;
+    }
+
+    Pattern &        m_pattern;
+    std::string_view m_source;
+    size_t           m_pos {0};
+    int              m_depth {0};
+};
+
+Pattern::Pattern(const std::string & source)
+  : m_source {source}
+{
+  PatternParser {* this, source}.build();
+
+  // Split the bytes into classes that every set in the NFA either wholly contains or wholly excludes.
+  size_t classes = 1;
+  for (const NfaState & state : m_nfa)
+  {
+    if (state.kind != NfaState::CHARS) continue;
+
+    std::map<std::pair<uint8_t, bool>, uint8_t> refined {};
+    for (int c = 0; c < 256; c++)
+    {
+      auto [it, inserted] = refined.try_emplace({m_classes[c], state.chars[c]}, refined.size());
+      m_classes[c] = it->second;
+    }
+    classes = refined.size();
+  }
+
+  m_representatives.assign(classes, 0);
+  for (int c = 255; c >= 0; c--)
+  {
+    m_representatives[m_classes[c]] = c;
+  }
+
+  std::lock_guard lock {m_mutex};
+  intern({});
+  m_start = intern(closure({m_nfa_start}));
+}
+
+Pattern::~Pattern()
+{
+  for (std::atomic<DfaState *> & block : m_blocks)
+  {
+    delete[] block.load();
+  }
+}
+
+std::vector<int> Pattern::closure(const std::vector<int> & states) const
+{
+  std::vector<int> result {};
+  std::vector<char> seen (m_nfa.size(), 0);
+  std::vector<int> stack {states};
+
+  while (! stack.empty())
+  {
+    int s = stack.back();
+    stack.pop_back();
+
+    if (s < 0 || seen[s]) continue;
+    seen[s] = 1;
+
+    const NfaState & state = m_nfa[s];
+    switch (state.kind)
+    {
+      case NfaState::CHARS:
+      case NfaState::MATCH:
+        result.push_back(s);
+        break;
+      case NfaState::EPSILON:
+        stack.push_back(state.out);
+        break;
+      case NfaState::SPLIT:
+        stack.push_back(state.out1);
+        stack.push_back(state.out);
+        break;
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+const Pattern & Pattern::compile(std::string_view source)
+{
+  // The patterns in use are kept most recently used first, and indexed by their own sources.
+
+  using Patterns = std::list<std::unique_ptr<Pattern>>;
+  thread_local Patterns t_patterns {};
+  thread_local std::unordered_map<std::string_view, Patterns::iterator> t_index {};
+
+  auto found = t_index.find(source);
+  if (found != t_index.end())
+  {
+    t_patterns.splice(t_patterns.begin(), t_patterns, found->second);
+    return * t_patterns.front();
+  }
+
+  t_patterns.push_front(std::make_unique<Pattern>(std::string {source}));
+  t_index.emplace(t_patterns.front()->m_source, t_patterns.begin());
+
+  if (t_patterns.size() > cache_size)
+  {
+    t_index.erase(t_patterns.back()->m_source);
+    t_patterns.pop_back();
+  }
+
+  return * t_patterns.front();
+}
+
+int32_t Pattern::intern(std::vector<int> states) const
+{
+  auto existing = m_ids.find(states);
+  if (existing != m_ids.end())
+  {
+    return existing->second;
+  }
+
+  int32_t id = m_count.load(std::memory_order_relaxed);
+  if ((size_t) id >= BLOCK * BLOCKS)
+  {
+    THROW_ERROR("The pattern '", m_source, "' needs more than ", BLOCK * BLOCKS, " DFA states.");
+  }
+
+  if (! m_blocks[id / BLOCK].load(std::memory_order_relaxed))
+  {
+    m_blocks[id / BLOCK].store(new DfaState[BLOCK], std::memory_order_release);
+  }
+
+  DfaState & created = state(id);
+  created.accepting = std::any_of(states.begin(), states.end(), [&](int s)
+  {
+    return m_nfa[s].kind == NfaState::MATCH;
+  });
+
+  // An alternative that got as far as its trailing loop has matched, and stays matched whatever follows.
+  created.sticky = std::any_of(states.begin(), states.end(), [&](int s)
+  {
+    return m_nfa[s].trailing;
+  });
+
+  // The dead state is the empty set, and every byte leaves it where it is.
+  created.next = std::make_unique<std::atomic<int32_t>[]>(m_representatives.size());
+  for (size_t cls = 0; cls < m_representatives.size(); cls++)
+  {
+    created.next[cls].store(states.empty() ? id : -1, std::memory_order_relaxed);
+  }
+
+  created.nfa = states;
+  m_ids.emplace(std::move(states), id);
+  m_count.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+bool Pattern::matches(std::string_view word) const
+{
+  int32_t s = m_start;
+  if (state(s).sticky) return true;
+
+  for (unsigned char c : word)
+  {
+    s = step(s, c);
+    if (s == DEAD) return false;
+    if (state(s).sticky) return true;
+  }
+
+  return state(s).accepting;
+}
+
+Bitmap Pattern::matching(const Dictionary & dictionary) const
+{
+  Bitmap result (dictionary.size());
+  const char * buffer = dictionary.buffer().data();
+
+  parallel_for(result.words(), [&](size_t begin, size_t end, size_t)
+  {
+    for (size_t k = begin; k < end; k++)
+    {
+      Dictionary::Id first = k * 64;
+      Dictionary::Id id = first;
+      size_t pos = dictionary.offset(first);
+      size_t stop = dictionary.offset(std::min<size_t>(first + 64, dictionary.size()));
+
+      uint64_t bits = 0;
+      int32_t s = m_start;
+
+      while (pos < stop)
+      {
+        unsigned char c = buffer[pos++];
+        if (c != '\n')
+        {
+          s = step(s, c);
+          if (s != DEAD && ! state(s).sticky) continue;
+
+          // The word is decided before its end, so skip to the newline after it.
+          pos = static_cast<const char *>(std::memchr(buffer + pos, '\n', stop - pos)) - buffer + 1;
+        }
+
+        if (state(s).accepting) bits |= uint64_t {1} << (id - first);
+        id++;
+        s = m_start;
+      }
+
+      result.word(k, bits);
+    }
+  }, 64);
+
+  return result;
+}
+
+const std::string & Pattern::source() const
+{
+  return m_source;
+}
+
+Pattern::DfaState & Pattern::state(int32_t id) const
+{
+  return m_blocks[id / BLOCK].load(std::memory_order_acquire)[id % BLOCK];
+}
+
+size_t Pattern::states() const
+{
+  return m_count.load(std::memory_order_acquire);
+}
+
+int32_t Pattern::transition(int32_t id, uint8_t cls) const
+{
+  std::lock_guard lock {m_mutex};
+
+  int32_t next = state(id).next[cls].load(std::memory_order_relaxed);
+  if (next >= 0)
+  {
+    return next;
+  }
+
+  unsigned char c = m_representatives[cls];
+  std::vector<int> moved {};
+  for (int s : state(id).nfa)
+  {
+    if (m_nfa[s].kind == NfaState::CHARS && m_nfa[s].chars[c]) moved.push_back(m_nfa[s].out);
+  }
+
+  next = intern(closure(moved));
+  state(id).next[cls].store(next, std::memory_order_release);
+  return next;
+}
@@ -0,0 +1,153 @@
+
+#ifndef PQ_PATTERN_H_
+#define PQ_PATTERN_H_
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Bitmap.h"
+#include "Dictionary.h"
+
+/**
+ *  A compiled regular expression over bytes, matched by a DFA that is built lazily as words are matched.
+ *
+ *  The syntax is that of POSIX extended expressions without back-references: literals, '.', bracket classes
+ *  such as [a-z] and [^aeiou], grouping with parentheses, '|', and the repetitions *, +, ? and {m}, {m,} and {m,n}.
+ *  A backslash escapes the next character. A pattern matches a word if it matches anywhere in it; as in POSIX,
+ *  an alternative that starts with '^' or ends with '$' is anchored to the start or end of the word.
+ *
+ *  The pattern is compiled to a Thompson NFA, and DFA states are subsets of it, built the first time they are
+ *  reached. Bytes that no part of the pattern tells apart share a column of the transition table. Transitions
+ *  once built are read without locking, so matching a word takes one table lookup per byte and never allocates;
+ *  only reaching a state or transition for the first time takes a lock.
+ */ 
+class Pattern
+{
+  public:
+
+    /**
+     *  Compiles the pattern; throws an error if it is malformed.
+     */ 
+    explicit Pattern(const std::string & source);
+
+    ~Pattern();
+
+    Pattern(const Pattern &) = delete;
+    Pattern & operator=(const Pattern &) = delete;
+
+    /**
+     *  Returns the compiled pattern for the source, compiling it on first use. Compiled patterns are cached per
+     *  thread, so that lookups do not lock, and only the most recently used few are kept, so that patterns built
+     *  from words do not pile up: the pattern returned stays valid until the thread compiles cache_size others.
+     *  Callers that match one pattern many times should rather own a Pattern. Throws an error if the pattern is
+     *  malformed.
+     */ 
+    static const Pattern & compile(std::string_view source);
+
+    /**
+     *  Determines whether the pattern matches the word.
+     */ 
+    bool matches(std::string_view word) const;
+
+    /**
+     *  Returns the set of dictionary words that the pattern matches, found by running the DFA across the
+     *  dictionary's buffer in parallel.
+     */ 
+    Bitmap matching(const Dictionary & dictionary) const;
+
+    /**
+     *  Returns the source of the pattern.
+     */ 
+    const std::string & source() const;
+
+    /**
+     *  Returns the number of DFA states built so far.
+     */ 
+    size_t states() const;
+
+  private:
+
+    /**
+     *  A state of the NFA: consumes one byte of a set, or moves on without consuming anything. Trailing states
+     *  are the loops that let an alternative without a '$' accept whatever follows it.
+     */ 
+    struct NfaState
+    {
+      enum Kind { CHARS, EPSILON, SPLIT, MATCH };
+
+      Kind             kind;
+      std::bitset<256> chars;
+      int              out      {-1};
+      int              out1     {-1};
+      bool             trailing {false};
+    };
+
+    /**
+     *  A state of the DFA, standing for a set of NFA states. Transitions are -1 until first taken. A sticky state
+     *  accepts, and so does every state after it, so a match can stop there.
+     */ 
+    struct DfaState
+    {
+      bool                                    accepting {false};
+      bool                                    sticky    {false};
+      std::vector<int>                        nfa;
+      std::unique_ptr<std::atomic<int32_t>[]> next;
+    };
+
+    static constexpr size_t cache_size = 64;
+
+    static constexpr size_t BLOCK  = 256;
+    static constexpr size_t BLOCKS = 256;
+    static constexpr int32_t DEAD  = 0;
+
+    friend class PatternParser;
+
+    /**
+     *  Returns the set of NFA states reachable from the given states without consuming input, keeping only those
+     *  that consume a byte or match.
+     */ 
+    std::vector<int> closure(const std::vector<int> & states) const;
+
+    /**
+     *  Returns the id of the DFA state for the set of NFA states, creating it if needed. Called with the lock held.
+     */ 
+    int32_t intern(std::vector<int> states) const;
+
+    DfaState & state(int32_t id) const;
+
+    /**
+     *  Returns the state after reading the byte in the given state.
+     */ 
+    int32_t step(int32_t id, unsigned char c) const
+    {
+      int32_t next = state(id).next[m_classes[c]].load(std::memory_order_acquire);
+      return next >= 0 ? next : transition(id, m_classes[c]);
+    }
+
+    /**
+     *  Builds the transition from the state on the byte class, under the lock.
+     */ 
+    int32_t transition(int32_t id, uint8_t cls) const;
+
+    std::string                                 m_source;
+    std::vector<NfaState>                       m_nfa;
+    int                                         m_nfa_start {0};
+
+    std::array<uint8_t, 256>                    m_classes {};
+    std::vector<unsigned char>                  m_representatives;
+
+    mutable std::mutex                          m_mutex;
+    mutable std::map<std::vector<int>, int32_t> m_ids;
+    mutable std::array<std::atomic<DfaState *>, BLOCKS> m_blocks {};
+    mutable std::atomic<int32_t>                m_count {0};
+    int32_t                                     m_start {0};
+};
+
+#endif
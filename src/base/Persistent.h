@@ -0,0 +1,249 @@
+
+#ifndef PQ_PERSISTENT_H_
+#define PQ_PERSISTENT_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ *  An append-only sequence whose copies share every element already written.
+ *
+ *  Elements live in fixed-size chunks linked from the newest back to the oldest. Copying a log copies one
+ *  pointer; appending writes into the newest chunk in place while no other log shares it, and otherwise
+ *  copies at most that one chunk first. Appending to one copy never affects another.
+ */ 
+template<typename T, size_t K = 32>
+class PersistentLog
+{
+  public:
+
+    /**
+     *  Returns the most recent element; the log must not be empty.
+     */ 
+    const T & back() const
+    {
+      return m_tail->items.back();
+    }
+
+    /**
+     *  Determines whether the log is empty.
+     */ 
+    bool empty() const
+    {
+      return m_size == 0;
+    }
+
+    /**
+     *  Calls f on every element in chronological order.
+     */ 
+    template<typename F>
+    void for_each(F && f) const
+    {
+      std::vector<const Chunk *> chunks {};
+      for (const Chunk * chunk = m_tail.get(); chunk; chunk = chunk->previous.get())
+      {
+        chunks.push_back(chunk);
+      }
+
+      for (auto it = chunks.rbegin(); it != chunks.rend(); ++it)
+      {
+        for (const T & item : (* it)->items) f(item);
+      }
+    }
+
+    /**
+     *  Calls f on the most recent n elements, the most recent first.
+     */ 
+    template<typename F>
+    void for_recent(size_t n, F && f) const
+    {
+      for (const Chunk * chunk = m_tail.get(); chunk && n > 0; chunk = chunk->previous.get())
+      {
+        for (auto it = chunk->items.rbegin(); it != chunk->items.rend() && n > 0; ++it, n--)
+        {
+          f(* it);
+        }
+      }
+    }
+
+    /**
+     *  Appends the element.
+     */ 
+    void push_back(T item)
+    {
+      if (! m_tail || m_tail->items.size() == K)
+      {
+        auto chunk = std::make_shared<Chunk>();
+        chunk->previous = std::move(m_tail);
+        chunk->items.reserve(K);
+        m_tail = std::move(chunk);
+      }
+      else if (m_tail.use_count() > 1)
+      {
+        auto chunk = std::make_shared<Chunk>(* m_tail);
+        chunk->items.reserve(K);
+        m_tail = std::move(chunk);
+      }
+
+      m_tail->items.push_back(std::move(item));
+      m_size++;
+    }
+
+    /**
+     *  Returns the number of elements.
+     */ 
+    size_t size() const
+    {
+      return m_size;
+    }
+
+  private:
+
+    struct Chunk
+    {
+      std::shared_ptr<Chunk> previous;
+      std::vector<T>         items;
+    };
+
+    std::shared_ptr<Chunk> m_tail;
+    size_t                 m_size {0};
+};
+
+/**
+ *  An ordered map whose copies share structure, so that copying is constant time and an assignment copies only
+ *  the path to the key.
+ *
+ *  The map is a treap whose priorities are derived from the hash of the key, which keeps it balanced in
+ *  expectation and makes its shape depend only on its contents. Nodes are never modified once built.
+ */ 
+template<typename K, typename V>
+class PersistentMap
+{
+  public:
+
+    /**
+     *  Returns a pointer to the value at the key, or null if there is none. The pointer stays valid for as
+     *  long as this map is not assigned to.
+     */ 
+    const V * find(const K & key) const
+    {
+      const Node * node = m_root.get();
+      while (node)
+      {
+        if (key < node->key) node = node->left.get();
+        else if (node->key < key) node = node->right.get();
+        else return &node->value;
+      }
+
+      return nullptr;
+    }
+
+    /**
+     *  Calls f(key, value) on every entry in key order.
+     */ 
+    template<typename F>
+    void for_each(F && f) const
+    {
+      visit(m_root.get(), f);
+    }
+
+    /**
+     *  Sets the value at the key, inserting the key if it is missing.
+     */ 
+    void set(const K & key, V value)
+    {
+      bool added = false;
+      m_root = insert(m_root, key, std::move(value), priority(key), added);
+      m_size += added;
+    }
+
+    /**
+     *  Returns the number of entries.
+     */ 
+    size_t size() const
+    {
+      return m_size;
+    }
+
+  private:
+
+    struct Node;
+    using Ptr = std::shared_ptr<const Node>;
+
+    struct Node
+    {
+      K        key;
+      V        value;
+      uint64_t priority;
+      Ptr      left;
+      Ptr      right;
+    };
+
+    static Ptr make(K key, V value, uint64_t priority, Ptr left, Ptr right)
+    {
+      return std::make_shared<const Node>(Node {std::move(key), std::move(value), priority, std::move(left), std::move(right)});
+    }
+
+    static Ptr insert(const Ptr & node, const K & key, V && value, uint64_t priority, bool & added)
+    {
+      if (! node)
+      {
+        added = true;
+        return make(key, std::move(value), priority, nullptr, nullptr);
+      }
+
+      if (key < node->key)
+      {
+        Ptr left = insert(node->left, key, std::move(value), priority, added);
+        if (left->priority > node->priority)
+        {
+          return make(left->key, left->value, left->priority, left->left,
+              make(node->key, node->value, node->priority, left->right, node->right));
+        }
+
+        return make(node->key, node->value, node->priority, std::move(left), node->right);
+      }
+
+      if (node->key < key)
+      {
+        Ptr right = insert(node->right, key, std::move(value), priority, added);
+        if (right->priority > node->priority)
+        {
+          return make(right->key, right->value, right->priority,
+              make(node->key, node->value, node->priority, node->left, right->left), right->right);
+        }
+
+        return make(node->key, node->value, node->priority, node->left, std::move(right));
+      }
+
+      return make(node->key, std::move(value), node->priority, node->left, node->right);
+    }
+
+    static uint64_t priority(const K & key)
+    {
+      // A splitmix64 finalizer, so that poorly spread hashes still give well-spread priorities.
+
+      uint64_t z = std::hash<K> {}(key) + 0x9e3779b97f4a7c15;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      return z ^ (z >> 31);
+    }
+
+    template<typename F>
+    static void visit(const Node * node, F & f)
+    {
+      if (! node) return;
+
+      visit(node->left.get(), f);
+      f(node->key, node->value);
+      visit(node->right.get(), f);
+    }
+
+    Ptr    m_root;
+    size_t m_size {0};
+};
+
+#endif
@@ -0,0 +1,367 @@
+
+#include <array>
+
+#include "Phonetic.h"
+#include "Utf8.h"
+
+namespace
+{
+  /**
+   *  The longest prefix of a word, in letters, that the encoders look at.
+   */
+  constexpr size_t max_letters = 64;
+
+  /**
+   *  A buffer size that fits every key of a word with at most max_letters letters.
+   */
+  constexpr size_t max_key = 2 * max_letters + 1;
+
+  /**
+   *  Soundex digits for 'a' through 'z'; zero marks letters that are not coded.
+   */
+  constexpr std::array<char, 26> soundex_digits =
+    {0, '1', '2', '3', 0, '1', '2', 0, 0, '2', '2', '4', '5', '5', 0, '1', '2', '6', '2', '3', 0, '1', 0, '2', 0, '2'};
+
+  /**
+   *  Metaphone codes for the letters whose code does not depend on their neighbours; zero marks the rest.
+   */
+  constexpr std::array<char, 26> metaphone_simple =
+    {0, 0, 0, 0, 0, 'F', 0, 0, 0, 'J', 0, 'L', 'M', 'N', 0, 0, 'K', 'R', 0, 0, 0, 'F', 0, 0, 0, 'S'};
+
+  constexpr std::array<bool, 26> vowels =
+    {1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0};
+
+  /**
+   *  Copies the letters of the word into the buffer in the given case, letters with diacritics as their base
+   *  letter (see utf8_base in Utf8.h), dropping everything else.
+   */
+  size_t letters(std::string_view word, char * out, char base)
+  {
+    size_t n = 0;
+
+    for (size_t at = 0; at < word.size() && n < max_letters; )
+    {
+      char32_t c = (unsigned char) word[at] < 0x80 ? word[at++] : utf8_base(utf8_decode(word, at));
+
+      if ('a' <= c && c <= 'z') out[n++] = c - 'a' + base;
+      else if ('A' <= c && c <= 'Z') out[n++] = c - 'A' + base;
+    }
+
+    return n;
+  }
+}
+
+size_t metaphone(std::string_view word, char * out, size_t cap)
+{
+  if (cap == 0) return 0;
+
+  char w[max_letters];
+  size_t n = letters(word, w, 'A');
+  size_t len = 0;
+
+  auto at = [&](size_t i) -> char { return i < n ? w[i] : '\0'; };
+  auto before = [&](size_t i) -> char { return i > 0 ? w[i - 1] : '\0'; };
+  auto vowel = [&](char c) { return c != '\0' && vowels[c - 'A']; };
+  auto front = [&](char c) { return c == 'E' || c == 'I' || c == 'Y'; };
+  auto emit = [&](char c) { if (len + 1 < cap) out[len++] = c; };
+
+  size_t i = 0;
+
+  // Initial letter exceptions.
+
+  if (n >= 2)
+  {
+    char second = w[1];
+
+    if ((w[0] == 'A' && second == 'E') || (w[0] == 'W' && second == 'R'))
+    {
+      emit(second);
+      i = 2;
+    }
+    else if ((w[0] == 'G' || w[0] == 'K' || w[0] == 'P') && second == 'N')
+    {
+      emit('N');
+      i = 2;
+    }
+    else if (w[0] == 'W' && second == 'H')
+    {
+      emit('W');
+      i = 2;
+    }
+  }
+
+  if (n >= 1 && w[0] == 'X')
+  {
+    emit('S');
+    i = 1;
+  }
+
+  for (; i < n; i++)
+  {
+    char c = w[i];
+
+    if (c == before(i) && c != 'C') continue;
+
+    if (metaphone_simple[c - 'A'])
+    {
+      emit(metaphone_simple[c - 'A']);
+      continue;
+    }
+
+    switch (c)
+    {
+      case 'A':
+      case 'E':
+      case 'I':
+      case 'O':
+      case 'U':
+        if (i == 0) emit(c);
+        break;
+      case 'B':
+        if (! (before(i) == 'M' && i + 1 == n)) emit('B');
+        break;
+      case 'C':
+        if (at(i + 1) == 'I' && at(i + 2) == 'A') emit('X');
+        else if (at(i + 1) == 'H')
+        {
+          emit(before(i) == 'S' ? 'K' : 'X');
+          i++;
+        }
+        else if (front(at(i + 1)))
+        {
+          if (before(i) != 'S') emit('S');
+        }
+        else emit('K');
+        break;
+      case 'D':
+        if (at(i + 1) == 'G' && front(at(i + 2)))
+        {
+          emit('J');
+          i++;
+        }
+        else emit('T');
+        break;
+      case 'G':
+        if (at(i + 1) == 'H' && i + 2 < n && ! vowel(at(i + 2))) break;
+        if (at(i + 1) == 'N' && (i + 2 == n || (at(i + 2) == 'E' && at(i + 3) == 'D' && i + 4 == n))) break;
+        emit(front(at(i + 1)) ? 'J' : 'K');
+        break;
+      case 'H':
+        if (vowel(at(i + 1)) && before(i) != 'C' && before(i) != 'S' && before(i) != 'P'
+            && before(i) != 'T' && before(i) != 'G') emit('H');
+        break;
+      case 'K':
+        if (before(i) != 'C') emit('K');
+        break;
+      case 'P':
+        emit(at(i + 1) == 'H' ? 'F' : 'P');
+        break;
+      case 'S':
+        if (at(i + 1) == 'H')
+        {
+          emit('X');
+          i++;
+        }
+        else if (at(i + 1) == 'I' && (at(i + 2) == 'O' || at(i + 2) == 'A')) emit('X');
+        else emit('S');
+        break;
+      case 'T':
+        if (at(i + 1) == 'I' && (at(i + 2) == 'O' || at(i + 2) == 'A')) emit('X');
+        else if (at(i + 1) == 'H')
+        {
+          emit('0');
+          i++;
+        }
+        else if (! (at(i + 1) == 'C' && at(i + 2) == 'H')) emit('T');
+        break;
+      case 'W':
+      case 'Y':
+        if (vowel(at(i + 1))) emit(c);
+        break;
+      case 'X':
+        emit('K');
+        emit('S');
+        break;
+    }
+  }
+
+  out[len] = '\0';
+  return len;
+}
+
+size_t rhyme_tail(std::string_view word, char * out, size_t cap)
+{
+  if (cap == 0) return 0;
+
+  char w[max_letters];
+  size_t n = letters(word, w, 'a');
+
+  auto vowel = [&](size_t i) { return vowels[w[i] - 'a'] || (w[i] == 'y' && i > 0); };
+
+  size_t limit = n;
+  if (n > 2 && w[n - 1] == 'e' && ! vowel(n - 2))
+  {
+    limit = n - 1;
+  }
+
+  size_t start = 0;
+  for (size_t i = limit; i > 0; i--)
+  {
+    if (vowel(i - 1))
+    {
+      start = i - 1;
+      while (start > 0 && vowel(start - 1)) start--;
+      break;
+    }
+  }
+
+  size_t len = std::min(n - start, cap - 1);
+  for (size_t i = 0; i < len; i++)
+  {
+    out[i] = w[start + i];
+  }
+
+  out[len] = '\0';
+  return len;
+}
+
+size_t soundex(std::string_view word, char * out)
+{
+  char w[max_letters];
+  size_t n = letters(word, w, 'a');
+
+  if (n == 0)
+  {
+    out[0] = '\0';
+    return 0;
+  }
+
+  size_t len = 0;
+  out[len++] = w[0] - 'a' + 'A';
+  char previous = soundex_digits[w[0] - 'a'];
+
+  for (size_t i = 1; i < n && len < 4; i++)
+  {
+    char digit = soundex_digits[w[i] - 'a'];
+
+    if (digit && digit != previous)
+    {
+      out[len++] = digit;
+    }
+
+    // Vowels separate equal codes, but 'h' and 'w' do not.
+
+    if (w[i] != 'h' && w[i] != 'w')
+    {
+      previous = digit;
+    }
+  }
+
+  while (len < 4)
+  {
+    out[len++] = '0';
+  }
+
+  out[len] = '\0';
+  return len;
+}
+
+PhoneticIndex::PhoneticIndex(const Dictionary & dictionary)
+  : m_dictionary {dictionary}
+{
+  size_t n = dictionary.size();
+  char key[max_key];
+
+  for (Column & column : m_columns)
+  {
+    column.classes.resize(n);
+  }
+
+  for (int k = 0; k < KEYS; k++)
+  {
+    Column & column = m_columns[k];
+
+    for (Id id = 0; id < n; id++)
+    {
+      size_t len = encode((Key) k, dictionary.word(id), key, sizeof(key));
+      auto [it, _] = column.interned.try_emplace(std::string {key, len}, column.interned.size());
+      column.classes[id] = it->second;
+    }
+
+    // Group the members of each class contiguously, in ascending id order.
+
+    column.row.assign(column.interned.size() + 1, 0);
+    for (Class cls : column.classes)
+    {
+      column.row[cls + 1]++;
+    }
+
+    for (size_t i = 0; i < column.interned.size(); i++)
+    {
+      column.row[i + 1] += column.row[i];
+    }
+
+    std::vector<uint32_t> fill (column.row.begin(), column.row.end() - 1);
+    column.members.resize(n);
+
+    for (Id id = 0; id < n; id++)
+    {
+      column.members[fill[column.classes[id]]++] = id;
+    }
+  }
+}
+
+size_t PhoneticIndex::encode(Key key, std::string_view word, char * out, size_t cap)
+{
+  switch (key)
+  {
+    case SOUNDEX:   return soundex(word, out);
+    case METAPHONE: return metaphone(word, out, cap);
+    default:        return rhyme_tail(word, out, cap);
+  }
+}
+
+PhoneticIndex::Class PhoneticIndex::of(Key key, Id id) const
+{
+  return m_columns[key].classes[id];
+}
+
+PhoneticIndex::Class PhoneticIndex::of(Key key, std::string_view word) const
+{
+  Id id = m_dictionary.find(word);
+  if (id != Dictionary::npos)
+  {
+    return of(key, id);
+  }
+
+  char buffer[max_key];
+  size_t len = encode(key, word, buffer, sizeof(buffer));
+
+  auto it = m_columns[key].interned.find(std::string {buffer, len});
+  return it == m_columns[key].interned.end() ? npos : it->second;
+}
+
+std::span<const PhoneticIndex::Id> PhoneticIndex::members(Key key, Class cls) const
+{
+  const Column & column = m_columns[key];
+  return std::span<const Id> {column.members.data() + column.row[cls], column.row[cls + 1] - column.row[cls]};
+}
+
+bool PhoneticIndex::same(Key key, std::string_view a, std::string_view b) const
+{
+  Class first = of(key, a);
+  Class second = of(key, b);
+
+  if (first != npos || second != npos)
+  {
+    return first == second;
+  }
+
+  char x[max_key];
+  char y[max_key];
+
+  size_t lx = encode(key, a, x, sizeof(x));
+  size_t ly = encode(key, b, y, sizeof(y));
+
+  return std::string_view {x, lx} == std::string_view {y, ly};
+}
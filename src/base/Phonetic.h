@@ -0,0 +1,117 @@
+
+#ifndef PQ_PHONETIC_H_
+#define PQ_PHONETIC_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Dictionary.h"
+
+/**
+ *  The buffer size that is always large enough for any phonetic key of the given word.
+ */ 
+constexpr size_t phonetic_capacity (std::string_view word)
+{
+  return 2 * word.size() + 5;
+}
+
+/**
+ *  Writes the original Metaphone key of the word into the buffer, which holds at least cap characters,
+ *  and returns the key's length. The key is always null-terminated. Like the other encoders, it reads
+ *  letters with diacritics as their base letter and skips characters that are not letters of a to z.
+ */ 
+size_t metaphone (std::string_view word, char * out, size_t cap);
+
+/**
+ *  Writes the rhyming tail of the word into the buffer, which holds at least cap characters, and returns
+ *  the tail's length. The tail is the word's letters, lowercase, from their last vowel group onwards, where
+ *  a silent final 'e' does not count as a vowel group. The tail is always null-terminated.
+ */ 
+size_t rhyme_tail (std::string_view word, char * out, size_t cap);
+
+/**
+ *  Writes the four-character American Soundex key of the word into the buffer, which holds at least five
+ *  characters, and returns 4; returns 0 and writes the empty string if the word has no letters.
+ */ 
+size_t soundex (std::string_view word, char * out);
+
+/**
+ *  Precomputed phonetic keys for every word in the dictionary.
+ *
+ *  Each phonetic key is interned to a dense class id, and every dictionary word stores its Soundex, Metaphone
+ *  and rhyme class ids in a column indexed by word id. Asking whether two dictionary words share a class is
+ *  two array loads; the members of each class are also stored contiguously.
+ */ 
+class PhoneticIndex
+{
+  public:
+
+    using Class = uint32_t;
+    using Id    = Dictionary::Id;
+
+    /**
+     *  The class returned for keys that no dictionary word has.
+     */ 
+    static constexpr Class npos = UINT32_MAX;
+
+    /**
+     *  The kinds of phonetic key.
+     */ 
+    enum Key
+    {
+      SOUNDEX,
+      METAPHONE,
+      RHYME,
+      KEYS
+    };
+
+    /**
+     *  Builds the index over the given dictionary, which must outlive it.
+     */ 
+    explicit PhoneticIndex(const Dictionary & dictionary);
+
+    /**
+     *  Returns the class of the given dictionary word.
+     */ 
+    Class of(Key key, Id id) const;
+
+    /**
+     *  Returns the class of the given normalized word, which need not be in the dictionary,
+     *  or npos if no dictionary word shares its key.
+     */ 
+    Class of(Key key, std::string_view word) const;
+
+    /**
+     *  Returns the ids of all dictionary words in the given class, in ascending order.
+     */ 
+    std::span<const Id> members(Key key, Class cls) const;
+
+    /**
+     *  Determines if the two normalized words have the same key.
+     */ 
+    bool same(Key key, std::string_view a, std::string_view b) const;
+
+  private:
+
+    /**
+     *  Writes the given kind of key into the buffer and returns its length.
+     */ 
+    static size_t encode(Key key, std::string_view word, char * out, size_t cap);
+
+    struct Column
+    {
+      std::vector<Class>                     classes;
+      std::unordered_map<std::string, Class> interned;
+      std::vector<uint32_t>                  row;
+      std::vector<Id>                        members;
+    };
+
+    const Dictionary & m_dictionary;
+    Column             m_columns[KEYS];
+};
+
+#endif
@@ -0,0 +1,49 @@
+
+#include "Random.h"
+
+std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+  constexpr uint32_t m0 = 0xD2511F53;
+  constexpr uint32_t m1 = 0xCD9E8D57;
+  constexpr uint32_t w0 = 0x9E3779B9;
+  constexpr uint32_t w1 = 0xBB67AE85;
+
+  for (int round = 0; round < 10; round++)
+  {
+    uint64_t p0 = (uint64_t) m0 * counter[0];
+    uint64_t p1 = (uint64_t) m1 * counter[2];
+
+    counter = 
+    {
+      (uint32_t) (p1 >> 32) ^ counter[1] ^ key[0],
+      (uint32_t) p1,
+      (uint32_t) (p0 >> 32) ^ counter[3] ^ key[1],
+      (uint32_t) p0
+    };
+
+    key[0] += w0;
+    key[1] += w1;
+  }
+
+  return counter;
+}
+
+uint64_t random_bits(uint64_t seed, uint64_t index, std::string_view word, uint32_t stream)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : word)
+  {
+    hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+  }
+
+  std::array<uint32_t, 4> block = philox(
+    { (uint32_t) index, stream, (uint32_t) hash, (uint32_t) (hash >> 32) },
+    { (uint32_t) seed, (uint32_t) (seed >> 32) });
+
+  return ((uint64_t) block[0] << 32) | block[1];
+}
+
+double random_unit(uint64_t bits)
+{
+  return (bits >> 11) * 0x1.0p-53;
+}
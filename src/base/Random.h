@@ -0,0 +1,29 @@
+
+#ifndef PQ_RANDOM_H_
+#define PQ_RANDOM_H_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/**
+ *  The Philox4x32-10 counter-based generator of Salmon et al.
+ *
+ *  Each output block is a pure function of a 128-bit counter and a 64-bit key, so there is no generator
+ *  state to share or lock: any thread can compute the n-th random value of any stream directly.
+ */ 
+std::array<uint32_t, 4> philox (std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+/**
+ *  Returns 64 random bits determined by the seed, the guess index, the word and the stream.
+ *  Distinct streams give independent values for the same seed, index and word.
+ */ 
+uint64_t random_bits (uint64_t seed, uint64_t index, std::string_view word, uint32_t stream = 0);
+
+/**
+ *  Maps 64 random bits to a double that is uniformly distributed in [0, 1).
+ */ 
+double random_unit (uint64_t bits);
+
+#endif
+
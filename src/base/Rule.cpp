@@ -7,11 +7,25 @@ const std::map<std::string, const Rule *> & Rules::get_rule_table()
   return instance().m_rules;
 }
 
+Verdict Rule::evaluate(const std::string & word, const History & history) const
+{
+  Verdict verdict {};
+  History::Recording recording {history, verdict.delta};
+
+  verdict.accepted = test(word, history);
+  return verdict;
+}
+
 std::ostream & Rule::print_state(std::ostream & out, const History & history) const
 {
   return history.state_format(out);
 }
 
+bool Rule::pure() const
+{
+  return false;
+}
+
 void Rules::register_rule(Rule * rule_instance)
 {
   if (instance().m_rules.find(rule_instance->name()) != instance().m_rules.end())
@@ -24,6 +38,11 @@ void Rules::register_rule(Rule * rule_instance)
   instance().m_rules[rule_instance->name()] = rule_instance;
 }
 
+void Rules::replace_rule(Rule * rule_instance)
+{
+  instance().m_rules[rule_instance->name()] = rule_instance;
+}
+
 Rules & Rules::instance()
 {
   static Rules inst_ {};
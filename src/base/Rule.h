@@ -22,6 +22,13 @@ class Rule
      */ 
     virtual std::string description() const = 0;
 
+    /**
+     *  Decides on the word without modifying the history, returning the decision together with the state
+     *  changes to commit when the guess is pushed. By default this records the state writes that test makes.
+     *  Safe to call from many threads at once against the same history.
+     */ 
+    virtual Verdict evaluate(const std::string & word, const History & history) const;
+
     /**
      *  Sets up the relevant bits of the state.
      */ 
@@ -38,7 +45,15 @@ class Rule
     virtual std::ostream & print_state(std::ostream & out, const History & history) const;
 
     /**
-     *  Determines if the word accepts or rejects given the history.
+     *  Determines whether the rule's decisions depend on the word alone, never on the history, its seed or its
+     *  state, so that they can be worked out once per dictionary word and cached. False unless the rule was
+     *  derived with DERIVE_PURE_RULE or DERIVE_PURE.
+     */ 
+    virtual bool pure() const;
+
+    /**
+     *  Determines if the word accepts or rejects given the history. State writes made here only take effect
+     *  through evaluate, so call that rather than test.
      */ 
     virtual bool test(const std::string & word, const History & history) const = 0;
 };
@@ -61,6 +76,12 @@ class Rules
      */ 
     static void register_rule(Rule * rule_instance);
 
+    /**
+     *  Registers the rule according to its name(), replacing any rule with the same name. The replaced
+     *  rule must outlive every game that uses it.
+     */ 
+    static void replace_rule(Rule * rule_instance);
+
   private:
 
     /**
@@ -77,9 +98,9 @@ class Rules
 };
 
 /**
- *  Derives the class header for the rule of the given name.
+ *  Derives the class header for the rule of the given name, declaring whether it is pure.
  */ 
-#define DERIVE_RULE(classname, base)                                                                  \
+#define DERIVE_RULE_PURITY(classname, base, purity)                                                   \
   class classname : public base                                                                       \
   {                                                                                                   \
     public:                                                                                           \
@@ -109,13 +130,33 @@ class Rules
         return #classname;                                                                            \
       }                                                                                               \
                                                                                                       \
+      virtual bool pure() const override                                                              \
+      {                                                                                               \
+        return purity;                                                                                \
+      }                                                                                               \
+                                                                                                      \
       virtual bool test(const std::string & word, const History & history) const override;            \
   };
 
+/**
+ *  Derives the class header for the rule of the given name.
+ */ 
+#define DERIVE_RULE(classname, base) DERIVE_RULE_PURITY(classname, base, false)
+
+/**
+ *  Derives the class header for a rule whose decisions depend on the word alone; see Rule::pure.
+ */ 
+#define DERIVE_PURE_RULE(classname, base) DERIVE_RULE_PURITY(classname, base, true)
+
 /**
  *  Derives the class header for the rule with superclass Rule.
  */ 
 #define DERIVE_BASE(classname) DERIVE_RULE(classname, Rule)
 
+/**
+ *  Derives the class header for a pure rule with superclass Rule.
+ */ 
+#define DERIVE_PURE(classname) DERIVE_PURE_RULE(classname, Rule)
+
 #endif 
 
@@ -0,0 +1,451 @@
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string_view>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Category.h"
+#include "DefinedRule.h"
+#include "Dictionary.h"
+#include "Error.h"
+#include "Job.h"
+#include "Logging.h"
+#include "Parallel.h"
+#include "RuleCache.h"
+#include "Watchdog.h"
+
+namespace
+{
+  constexpr char magic[8] = {'P', 'Q', 'A', 'C', 'C', 'P', 'T', '1'};
+
+  struct Header
+  {
+    char     magic[8];
+    uint64_t dictionary_hash;
+    uint64_t fingerprint;
+    uint64_t bits;
+    uint64_t length;
+  };
+
+  /**
+   *  The hashes of the program's code: one per rule class, and one for everything else.
+   */
+  struct Code
+  {
+    std::map<std::string, uint64_t, std::less<>> classes;
+    uint64_t                                     shared {0};
+  };
+
+  uint64_t fnv(const void * data, size_t length, uint64_t hash = 14695981039346656037ull)
+  {
+    const unsigned char * bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; i++)
+    {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+  }
+
+  uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  /**
+   *  Returns the outermost class of a mangled member function name such as _ZNK10HasLetterE4testE..., or an
+   *  empty view if the symbol is not a member function.
+   */
+  std::string_view owner(const char * symbol)
+  {
+    if (std::strncmp(symbol, "_ZN", 3) != 0)
+    {
+      return {};
+    }
+
+    const char * p = symbol + 3;
+    while (* p == 'K' || * p == 'V' || * p == 'r') p++;
+
+    size_t length = 0;
+    while (* p >= '0' && * p <= '9') length = length * 10 + (* p++ - '0');
+
+    if (length == 0 || std::strlen(p) < length)
+    {
+      return {};
+    }
+
+    return std::string_view {p, length};
+  }
+
+  /**
+   *  Hashes the executable's functions, by owning class, and its read-only data. Hashes are summed so that the
+   *  order of the symbol table does not matter.
+   */
+  Code hash_code(const std::set<std::string, std::less<>> & rules)
+  {
+    Code code {};
+
+    int fd = open("/proc/self/exe", O_RDONLY);
+    struct stat info {};
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+      if (fd >= 0) close(fd);
+      U_LOGW("Could not read the executable; cached bitmaps are only checked against the dictionary.");
+      return code;
+    }
+
+    size_t size = info.st_size;
+    void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+      return code;
+    }
+
+    const unsigned char * image = static_cast<const unsigned char *>(mapping);
+    const Elf64_Ehdr * elf = reinterpret_cast<const Elf64_Ehdr *>(image);
+
+    bool valid =
+      size >= sizeof(Elf64_Ehdr)
+      && std::memcmp(elf->e_ident, ELFMAG, SELFMAG) == 0
+      && elf->e_ident[EI_CLASS] == ELFCLASS64
+      && elf->e_shoff + elf->e_shnum * sizeof(Elf64_Shdr) <= size;
+
+    const Elf64_Shdr * sections = valid ? reinterpret_cast<const Elf64_Shdr *>(image + elf->e_shoff) : nullptr;
+    const Elf64_Shdr * symtab = nullptr;
+
+    for (size_t i = 0; valid && i < elf->e_shnum; i++)
+    {
+      const Elf64_Shdr & section = sections[i];
+      if (section.sh_offset + section.sh_size > size && section.sh_type != SHT_NOBITS)
+      {
+        valid = false;
+      }
+      else if (section.sh_type == SHT_SYMTAB)
+      {
+        symtab = &section;
+      }
+      else if (section.sh_type == SHT_PROGBITS && (section.sh_flags & SHF_ALLOC) && ! (section.sh_flags & SHF_WRITE)
+          && ! (section.sh_flags & SHF_EXECINSTR))
+      {
+        code.shared += mix(fnv(image + section.sh_offset, section.sh_size));
+      }
+    }
+
+    if (! valid || ! symtab || symtab->sh_link >= elf->e_shnum)
+    {
+      code.classes.clear();
+      code.shared = fnv(image, size);
+      munmap(mapping, size);
+      return code;
+    }
+
+    const Elf64_Shdr & strtab = sections[symtab->sh_link];
+    const Elf64_Sym * symbols = reinterpret_cast<const Elf64_Sym *>(image + symtab->sh_offset);
+    size_t count = symtab->sh_size / sizeof(Elf64_Sym);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const Elf64_Sym & symbol = symbols[i];
+      if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_size == 0 || symbol.st_shndx >= elf->e_shnum
+          || symbol.st_name >= strtab.sh_size)
+      {
+        continue;
+      }
+
+      const Elf64_Shdr & section = sections[symbol.st_shndx];
+      if (section.sh_type != SHT_PROGBITS || symbol.st_value < section.sh_addr
+          || symbol.st_value - section.sh_addr + symbol.st_size > section.sh_size)
+      {
+        continue;
+      }
+
+      const char * name = reinterpret_cast<const char *>(image + strtab.sh_offset + symbol.st_name);
+      uint64_t hash = mix(fnv(name, std::strlen(name)) ^ fnv(image + section.sh_offset + (symbol.st_value - section.sh_addr), symbol.st_size));
+
+      std::string_view cls = owner(name);
+      if (! cls.empty() && rules.count(cls)) code.classes[std::string {cls}] += hash;
+      else code.shared += hash;
+    }
+
+    munmap(mapping, size);
+    return code;
+  }
+
+  /**
+   *  Returns the hashes of the program's code, worked out on first use.
+   */
+  const Code & code()
+  {
+    static const Code code_ = []()
+    {
+      std::set<std::string, std::less<>> rules {};
+      for (auto [name, rule] : Rules::get_rule_table())
+      {
+        if (! dynamic_cast<const DefinedRule *>(rule)) rules.insert(name);
+      }
+
+      return hash_code(rules);
+    }();
+
+    return code_;
+  }
+
+  /**
+   *  Hashes the data a pure rule may read: the dictionary's words and its word categories.
+   */
+  uint64_t data_hash(const Dictionary & dictionary)
+  {
+    return mix(dictionary.hash() ^ mix(dictionary.category_index().hash()));
+  }
+
+  uint64_t key(uint64_t fingerprint, uint64_t dictionary_hash)
+  {
+    return mix(fingerprint ^ mix(dictionary_hash));
+  }
+}
+
+RuleCache & RuleCache::instance()
+{
+  static RuleCache instance_ {};
+  return instance_;
+}
+
+const Bitmap * RuleCache::accepted(const Rule & rule)
+{
+  if (const Bitmap * bitmap = find(rule))
+  {
+    return bitmap;
+  }
+
+  if (! rule.pure())
+  {
+    return nullptr;
+  }
+
+  // Pure rules never read the history, but may still expect it to be set up.
+
+  History history {};
+  rule.initialize(history);
+
+  std::optional<Bitmap> swept = sweep(rule, history);
+  if (! swept)
+  {
+    return nullptr;
+  }
+
+  uint64_t fingerprint = this->fingerprint(rule);
+  save(rule, fingerprint, * swept);
+
+  std::lock_guard lock {m_mutex};
+  Entry & entry = m_entries[{&rule, key(fingerprint, data_hash(Dictionary::instance()))}];
+  entry.looked = true;
+  if (! entry.bitmap) entry.bitmap = std::make_unique<Bitmap>(std::move(* swept));
+  return entry.bitmap.get();
+}
+
+std::string RuleCache::directory() const
+{
+  const std::string & source = Dictionary::instance().source();
+  if (source.empty())
+  {
+    return "";
+  }
+
+  return (std::filesystem::path {source}.parent_path() / "cache").string();
+}
+
+const Bitmap * RuleCache::find(const Rule & rule)
+{
+  if (! rule.pure())
+  {
+    return nullptr;
+  }
+
+  uint64_t fingerprint = this->fingerprint(rule);
+  uint64_t key = ::key(fingerprint, data_hash(Dictionary::instance()));
+
+  {
+    std::lock_guard lock {m_mutex};
+    auto it = m_entries.find({&rule, key});
+    if (it != m_entries.end() && (it->second.bitmap || it->second.looked))
+    {
+      return it->second.bitmap.get();
+    }
+  }
+
+  std::unique_ptr<Bitmap> loaded = load(rule, fingerprint);
+
+  std::lock_guard lock {m_mutex};
+  Entry & entry = m_entries[{&rule, key}];
+  entry.looked = true;
+  if (! entry.bitmap) entry.bitmap = std::move(loaded);
+
+  return entry.bitmap.get();
+}
+
+uint64_t RuleCache::fingerprint(const Rule & rule)
+{
+  const Code & code = ::code();
+
+  if (const DefinedRule * defined = dynamic_cast<const DefinedRule *>(&rule))
+  {
+    const std::string & source = defined->expr().source();
+    return mix(fnv(source.data(), source.size()) ^ mix(code.shared));
+  }
+
+  auto it = code.classes.find(rule.name());
+  return mix((it == code.classes.end() ? 0 : it->second) ^ mix(code.shared));
+}
+
+std::unique_ptr<Bitmap> RuleCache::load(const Rule & rule, uint64_t fingerprint) const
+{
+  std::string directory = this->directory();
+  if (directory.empty())
+  {
+    return nullptr;
+  }
+
+  std::string path = directory + "/" + rule.name() + ".bm";
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(Header))
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  void * mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  const Dictionary & dictionary = Dictionary::instance();
+  const Header * header = static_cast<const Header *>(mapping);
+  std::unique_ptr<Bitmap> bitmap {};
+
+  if (std::memcmp(header->magic, magic, sizeof(magic)) == 0
+      && header->dictionary_hash == data_hash(dictionary)
+      && header->fingerprint == fingerprint
+      && header->bits == dictionary.size()
+      && header->length == (info.st_size - sizeof(Header)) / sizeof(uint64_t))
+  {
+    try
+    {
+      const uint64_t * data = reinterpret_cast<const uint64_t *>(header + 1);
+      bitmap = std::make_unique<Bitmap>(Bitmap::decompress(header->bits, data, header->length));
+    }
+    catch (Error & e)
+    {
+      U_LOGW("Ignoring the malformed cached bitmap at '", path, "'.");
+    }
+  }
+
+  munmap(mapping, info.st_size);
+  return bitmap;
+}
+
+void RuleCache::save(const Rule & rule, uint64_t fingerprint, const Bitmap & bitmap) const
+{
+  std::string directory = this->directory();
+  if (directory.empty())
+  {
+    return;
+  }
+
+  std::string path = directory + "/" + rule.name() + ".bm";
+  std::string temporary = path + "." + std::to_string(getpid());
+  std::vector<uint64_t> data = bitmap.compress();
+
+  Header header {};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.dictionary_hash = data_hash(Dictionary::instance());
+  header.fingerprint = fingerprint;
+  header.bits = bitmap.size();
+  header.length = data.size();
+
+  std::error_code error {};
+  std::filesystem::create_directories(directory, error);
+
+  {
+    std::ofstream out {temporary, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(uint64_t));
+
+    if (! out)
+    {
+      U_LOGW("Not caching the bitmap of '", rule.name(), "': could not write '", temporary, "'.");
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+
+  std::filesystem::rename(temporary, path, error);
+  if (error)
+  {
+    U_LOGW("Not caching the bitmap of '", rule.name(), "': could not write '", path, "'.");
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+std::optional<Bitmap> RuleCache::sweep(const Rule & rule, const History & history)
+{
+  Watchdog & watchdog = Watchdog::instance();
+  const Dictionary & dictionary = Dictionary::instance();
+
+  Bitmap accepted {dictionary.size()};
+  std::atomic<bool> aborted {watchdog.quarantined(rule)};
+  Job::expect(accepted.words());
+
+  parallel_for(accepted.words(), [&](size_t begin, size_t end, size_t worker)
+  {
+    std::string word {};
+    Watchdog::Meter meter = watchdog.meter(rule);
+
+    for (size_t k = begin; k < end && ! aborted; k++)
+    {
+      uint64_t bits = 0;
+      size_t last = std::min<size_t>(64 * k + 64, dictionary.size());
+
+      for (size_t id = 64 * k; id < last; id++)
+      {
+        word.assign(dictionary.word(id));
+        bits |= (uint64_t) meter.evaluate(word, history).accepted << (id % 64);
+      }
+
+      accepted.word(k, bits);
+      if (meter.quarantined()) aborted = true;
+
+      Job::checkpoint();
+      Job::advance(1);
+    }
+  }, 64);
+
+  if (aborted)
+  {
+    return std::nullopt;
+  }
+
+  return accepted;
+}
@@ -0,0 +1,103 @@
+
+#ifndef PQ_RULE_CACHE_H_
+#define PQ_RULE_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "Bitmap.h"
+#include "History.h"
+#include "Rule.h"
+
+/**
+ *  Keeps the accept bitmap of every pure rule over the dictionary, in memory and in a cache directory next to
+ *  the word list, so that it survives restarts.
+ *
+ *  Each rule's bitmap is saved compressed in a file of its own, behind a header holding a hash of the dictionary
+ *  and its word categories and the rule's fingerprint, and is memory-mapped and decoded on first use. A file whose
+ *  header does not match is ignored and overwritten, so the cache invalidates itself whenever the dictionary, a
+ *  category or the rule's code changes.
+ *
+ *  The fingerprint of a built-in rule hashes the machine code of its own class's functions, found through the
+ *  executable's symbol table, together with the code and read-only data of everything outside the rule classes,
+ *  which rules call into. Rebuilds that move code around therefore invalidate more than strictly needed, but
+ *  never less. A defined rule's fingerprint hashes its source instead of its class. Without a symbol table, the
+ *  whole executable is hashed.
+ */ 
+class RuleCache
+{
+  public:
+
+    /**
+     *  Gets the cache shared by the whole program.
+     */ 
+    static RuleCache & instance();
+
+    RuleCache(const RuleCache &) = delete;
+    RuleCache & operator=(const RuleCache &) = delete;
+
+    /**
+     *  Returns the accept bitmap of a pure rule: from memory, else from the cache directory, else computed and
+     *  saved. Returns null for rules that are not pure, and if the rule got quarantined while being computed.
+     */ 
+    const Bitmap * accepted(const Rule & rule);
+
+    /**
+     *  Returns the directory that bitmaps are saved in, or an empty string if they are only kept in memory.
+     */ 
+    std::string directory() const;
+
+    /**
+     *  Returns the accept bitmap of a pure rule if it is in memory or in the cache directory, without computing
+     *  it; returns null otherwise.
+     */ 
+    const Bitmap * find(const Rule & rule);
+
+    /**
+     *  Returns the fingerprint of the rule's code.
+     */ 
+    uint64_t fingerprint(const Rule & rule);
+
+    /**
+     *  Runs the rule over every dictionary word against the history, in parallel and metered by the watchdog.
+     *  Returns nothing if the rule got quarantined meanwhile.
+     */ 
+    static std::optional<Bitmap> sweep(const Rule & rule, const History & history);
+
+  private:
+
+    RuleCache() = default;
+
+    /**
+     *  Maps the rule's file from the cache directory, returning null if it is missing or stale.
+     */ 
+    std::unique_ptr<Bitmap> load(const Rule & rule, uint64_t fingerprint) const;
+
+    /**
+     *  Saves the bitmap into the rule's file, replacing it atomically.
+     */ 
+    void save(const Rule & rule, uint64_t fingerprint, const Bitmap & bitmap) const;
+
+    /**
+     *  What is known of one rule's bitmap over one dictionary. Looked means the cache directory was already
+     *  searched, so a missing bitmap is not searched for again.
+     */ 
+    struct Entry
+    {
+      bool                    looked {false};
+      std::unique_ptr<Bitmap> bitmap;
+    };
+
+    // Keyed by the rule and a hash of its fingerprint and the dictionary's, so that a reloaded dictionary gets
+    // entries of its own; bitmaps are never replaced, and stay valid for readers of an older dictionary.
+
+    std::mutex                                             m_mutex;
+    std::map<std::pair<const Rule *, uint64_t>, Entry>     m_entries;
+};
+
+#endif
@@ -0,0 +1,230 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+#include "Dictionary.h"
+#include "Job.h"
+#include "Logging.h"
+#include "Parallel.h"
+#include "RuleCache.h"
+#include "RuleDiff.h"
+#include "Watchdog.h"
+
+RuleDiff::RuleDiff(const Settings & settings)
+  : m_settings {settings}
+{}
+
+std::optional<Bitmap> RuleDiff::disagreements(const Rule & a, const History & ha, const Rule & b, const History & hb)
+{
+  Watchdog & watchdog = Watchdog::instance();
+  const Dictionary & dictionary = Dictionary::instance();
+  RuleCache & cache = RuleCache::instance();
+
+  // A pure rule's cached bitmap stands in for evaluating it, whatever the history.
+
+  const Rule * rules[2] {&a, &b};
+  const History * histories[2] {&ha, &hb};
+  const Bitmap * cached[2] {a.pure() ? cache.find(a) : nullptr, b.pure() ? cache.find(b) : nullptr};
+
+  Bitmap accepted[2] {Bitmap {dictionary.size()}, Bitmap {dictionary.size()}};
+  std::atomic<bool> aborted {false};
+  Job::expect(accepted[0].words());
+
+  parallel_for(accepted[0].words(), [&](size_t begin, size_t end, size_t)
+  {
+    Watchdog::Meter meters[2] {watchdog.meter(a), watchdog.meter(b)};
+    std::string word {};
+
+    for (size_t k = begin; k < end && ! aborted; k++)
+    {
+      size_t last = std::min<size_t>(64 * k + 64, dictionary.size());
+
+      for (int side = 0; side < 2; side++)
+      {
+        if (cached[side])
+        {
+          accepted[side].word(k, cached[side]->word(k));
+          continue;
+        }
+
+        uint64_t bits = 0;
+        for (size_t id = 64 * k; id < last; id++)
+        {
+          word.assign(dictionary.word(id));
+          bits |= (uint64_t) meters[side].evaluate(word, * histories[side]).accepted << (id % 64);
+        }
+
+        accepted[side].word(k, bits);
+        if (meters[side].quarantined()) aborted = true;
+      }
+
+      Job::checkpoint();
+      Job::advance(1);
+    }
+  }, 64);
+
+  if (aborted || watchdog.quarantined(* rules[0]) || watchdog.quarantined(* rules[1]))
+  {
+    return std::nullopt;
+  }
+
+  accepted[0] ^= accepted[1];
+  return std::move(accepted[0]);
+}
+
+std::ostream & RuleDiff::format(std::ostream & out) const
+{
+  if (m_compared == 0)
+  {
+    U_LOGW("Nothing has been compared yet.");
+    return out;
+  }
+
+  const std::string & a = m_names[0];
+  const std::string & b = m_names[1];
+
+  if (m_disagreements == 0)
+  {
+    U_LOGI(
+        "'", a, "' and '", b, "' agree on all ", m_words, " words ",
+        m_pure
+          ? "and, both being pure, under every history"
+          : "under the empty history and " + std::to_string(m_compared - 1) + " sampled histories of up to "
+            + std::to_string(m_compared - 1) + " guesses",
+        " (compared in ", std::fixed, std::setprecision(1), m_seconds * 1000, " ms).");
+    return out;
+  }
+
+  U_LOGI(
+      "'", a, "' and '", b, "' disagree on ", m_disagreements, " of ", m_words, " words ",
+      m_prefix[0].empty()
+        ? "from the first guess"
+        : "after " + std::to_string(m_prefix[0].size()) + (m_prefix[0].size() == 1 ? " guess" : " guesses"),
+      " (found in ", std::fixed, std::setprecision(1), m_seconds * 1000, " ms).");
+
+  size_t pad = 4;
+  for (const Guess & guess : m_prefix[0])
+  {
+    pad = std::max(pad, guess.word.size());
+  }
+
+  for (const std::string & word : m_examples)
+  {
+    pad = std::max(pad, word.size());
+  }
+
+  auto verdict = [](bool accepted) { return accepted ? "accepts" : "rejects"; };
+
+  if (! m_prefix[0].empty())
+  {
+    out << "history:\n";
+    for (size_t i = 0; i < m_prefix[0].size(); i++)
+    {
+      out
+        << "  " << std::setw(pad) << std::left << m_prefix[0][i].word << "  "
+        << a << " " << verdict(m_prefix[0][i].accepted) << ", " << b << " " << verdict(m_prefix[1][i].accepted) << "\n";
+    }
+  }
+
+  out << "shortest distinguishing words:\n";
+  for (size_t i = 0; i < m_examples.size(); i++)
+  {
+    out
+      << "  " << std::setw(pad) << std::left << m_examples[i] << "  "
+      << a << " " << verdict(m_accepted_by_a[i]) << ", " << b << " " << verdict(! m_accepted_by_a[i]) << "\n";
+  }
+
+  return out;
+}
+
+bool RuleDiff::run(const Rule & a, const Rule & b)
+{
+  const Dictionary & dictionary = Dictionary::instance();
+  Watchdog::Meter meters[2] {Watchdog::instance().meter(a), Watchdog::instance().meter(b)};
+  auto start = std::chrono::steady_clock::now();
+
+  m_names[0] = a.name();
+  m_names[1] = b.name();
+  m_pure = a.pure() && b.pure();
+  m_words = dictionary.size();
+  m_compared = 0;
+  m_disagreements = 0;
+  m_examples.clear();
+  m_accepted_by_a.clear();
+
+  // The n-th history plays n random words through both rules. Should the rules already disagree on one of
+  // them, the history stops short of it, and the dictionary pass below finds the disagreement.
+
+  std::optional<Bitmap> differ {};
+  History histories[2] {};
+
+  for (size_t n = 0; n <= (m_pure ? 0 : m_settings.histories); n++)
+  {
+    std::mt19937_64 rng {m_settings.seed + n};
+    const Rule * rules[2] {&a, &b};
+
+    for (int side = 0; side < 2; side++)
+    {
+      histories[side] = History {};
+      histories[side].reseed(m_settings.seed);
+      rules[side]->initialize(histories[side]);
+      m_prefix[side].clear();
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+      std::string word {dictionary.word(rng() % dictionary.size())};
+      Verdict verdicts[2] {meters[0].evaluate(word, histories[0]), meters[1].evaluate(word, histories[1])};
+      if (verdicts[0].accepted != verdicts[1].accepted) break;
+
+      for (int side = 0; side < 2; side++)
+      {
+        histories[side].push(Guess {word, verdicts[side].accepted}, verdicts[side].delta);
+        m_prefix[side].push_back(Guess {word, verdicts[side].accepted});
+      }
+    }
+
+    differ = disagreements(a, histories[0], b, histories[1]);
+    m_compared++;
+
+    if (! differ)
+    {
+      return false;
+    }
+
+    m_disagreements = differ->count();
+    if (m_disagreements > 0) break;
+  }
+
+  if (m_disagreements > 0)
+  {
+    std::vector<Dictionary::Id> ids {};
+    for (size_t id = differ->next(0); id < differ->size(); id = differ->next(id + 1))
+    {
+      ids.push_back(id);
+    }
+
+    auto shorter = [&](Dictionary::Id x, Dictionary::Id y)
+    {
+      std::string_view u = dictionary.word(x);
+      std::string_view v = dictionary.word(y);
+      return u.size() != v.size() ? u.size() < v.size() : u < v;
+    };
+
+    size_t shown = std::min(m_settings.examples, ids.size());
+    std::partial_sort(ids.begin(), ids.begin() + shown, ids.end(), shorter);
+
+    for (size_t i = 0; i < shown; i++)
+    {
+      std::string word {dictionary.word(ids[i])};
+      m_accepted_by_a.push_back(meters[0].evaluate(word, histories[0]).accepted);
+      m_examples.push_back(std::move(word));
+    }
+  }
+
+  m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
@@ -0,0 +1,75 @@
+
+#ifndef PQ_RULE_DIFF_H_
+#define PQ_RULE_DIFF_H_
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Bitmap.h"
+#include "History.h"
+#include "Rule.h"
+
+/**
+ *  Compares two rules over the dictionary, to tell whether a refactored rule still decides like the original,
+ *  or whether two rules duplicate each other.
+ *
+ *  The rules are compared under the empty history, then under sampled histories of one guess, two guesses and
+ *  so on, each played through both rules from the same seed. Every comparison evaluates both rules over the
+ *  dictionary in parallel into bitmaps, whose XOR holds the words they disagree on. The first history under
+ *  which they disagree ends the search, so it is the shortest one sampled, and its disagreements are reported
+ *  shortest words first. Pure rules do not depend on the history, so two of them are compared once, and their
+ *  cached bitmaps are used when there are any.
+ */ 
+class RuleDiff
+{
+  public:
+
+    /**
+     *  The knobs of a comparison.
+     */ 
+    struct Settings
+    {
+      size_t   histories {8};
+      size_t   examples  {10};
+      uint64_t seed      {1};
+    };
+
+    /**
+     *  Constructs a comparison with the given settings.
+     */ 
+    explicit RuleDiff(const Settings & settings);
+
+    /**
+     *  Prints whether the rules agree and, if not, the history and the words that tell them apart.
+     */ 
+    std::ostream & format(std::ostream & out) const;
+
+    /**
+     *  Compares the rules. Returns false if either got quarantined meanwhile.
+     */ 
+    bool run(const Rule & a, const Rule & b);
+
+  private:
+
+    /**
+     *  Evaluates both rules over the dictionary against their own histories and returns the bitmap of the words
+     *  they disagree on, or nothing if either got quarantined.
+     */ 
+    static std::optional<Bitmap> disagreements(const Rule & a, const History & ha, const Rule & b, const History & hb);
+
+    Settings                 m_settings;
+    std::string              m_names[2];
+    bool                     m_pure          {false};
+    size_t                   m_compared      {0};
+    size_t                   m_words         {0};
+    size_t                   m_disagreements {0};
+    std::vector<Guess>       m_prefix[2];
+    std::vector<std::string> m_examples;
+    std::vector<bool>        m_accepted_by_a;
+    double                   m_seconds       {0};
+};
+
+#endif
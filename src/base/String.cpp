@@ -1,10 +1,104 @@
 
-#include <fstream>
-#include <memory>
 #include <sstream>
-#include <unordered_set>
 
+#include "Category.h"
+#include "Dictionary.h"
+#include "EditIndex.h"
+#include "Error.h"
+#include "Pattern.h"
+#include "Phonetic.h"
 #include "String.h"
+#include "SubstringIndex.h"
+#include "Utf8.h"
+
+namespace
+{
+  thread_local const Features * t_features = nullptr;
+
+  /**
+   *  The set a category expression last stood for on this thread, and the category index it was resolved in.
+   */
+  struct Resolved
+  {
+    uint64_t        index {0};
+    std::string     name  {};
+    const WordSet * words {nullptr};
+  };
+
+  thread_local Resolved t_category {};
+
+  /**
+   *  Sums the letters of the lowercase word, a = 1 to z = 26, counting letters with diacritics as their base.
+   */
+  unsigned a1z26(const std::string & lowered)
+  {
+    unsigned sum = 0;
+
+    for (size_t at = 0; at < lowered.size(); )
+    {
+      char32_t c = (unsigned char) lowered[at] < 0x80 ? lowered[at++] : utf8_base(utf8_decode(lowered, at));
+      if ('a' <= c && c <= 'z') sum += c - 'a' + 1;
+    }
+
+    return sum;
+  }
+
+  /**
+   *  Returns the trimmed, lowercase form of the word, from the features in scope if the word is theirs.
+   */
+  std::string normalize(const std::string & word)
+  {
+    const Features * features = Features::find(word);
+    return features ? features->normalized : trim(lower(word));
+  }
+}
+
+Features::Features(const std::string & word)
+  : word {word}
+  , lowered {lower(word)}
+  , normalized {trim(lowered)}
+  , a1z26 {::a1z26(normalized)}
+{}
+
+const Features * Features::find(const std::string & word)
+{
+  return t_features && &t_features->word == &word ? t_features : nullptr;
+}
+
+Features::Scope::Scope(const Features & features)
+  : m_previous {t_features}
+{
+  t_features = &features;
+}
+
+Features::Scope::~Scope()
+{
+  t_features = m_previous;
+}
+
+const WordSet & category(const std::string & name)
+{
+  // Rules test one category over and over, so each thread keeps the set it last resolved, as the expression
+  // frame does, and only asks the index again (which locks for combined expressions) when either changes.
+
+  const CategoryIndex & index = Dictionary::instance().category_index();
+  Resolved & r = t_category;
+
+  if (r.index != index.id() || r.name != name)
+  {
+    r.index = 0;
+    r.words = index.resolve(name);
+    if (! r.words)
+    {
+      THROW_ERROR("No word category '", name, "'.");
+    }
+
+    r.index = index.id();
+    r.name = name;
+  }
+
+  return * r.words;
+}
 
 std::string charwise_filter(const std::string & word, std::function<bool (char)> test)
 {
@@ -23,14 +117,25 @@ std::string charwise_filter(const std::string & word, std::function<bool (char)>
 
 std::string charwise_transform(const std::string & word, std::function<std::string (char)> map)
 {
-  std::stringstream ss {};
+  std::string result {};
+  result.reserve(word.size());
 
   for (char c : word)
   {
-    ss << map(c);
+    result.append(map(c));
   }
 
-  return ss.str();
+  return result;
+}
+
+size_t count_containing(const std::string & fragment)
+{
+  return Dictionary::instance().substring_index().count_words(normalize(fragment));
+}
+
+size_t count_matching(const std::string & pattern)
+{
+  return Pattern::compile(pattern).matching(Dictionary::instance()).count();
 }
 
 unsigned count(const std::string & word, char ch)
@@ -48,23 +153,28 @@ unsigned count(const std::string & word, char ch)
   return count;
 }
 
-bool in_dictionary(const std::string & word)
+std::string encode(const std::string & word, const CodeTable & table)
 {
-  static std::unique_ptr<std::unordered_set<std::string>> dictionary;
-  if (! dictionary.get())
-  {
-    dictionary = std::make_unique<std::unordered_set<std::string>>();
+  std::string result (encoded_length(word, table), '\0');
+  encode(word, table, result.data(), result.size());
+  return result;
+}
 
-    std::fstream fs {"data/dictionary.txt"};
-    std::string line;
-    
-    while (fs >> line)
-    {
-      dictionary->insert(trim(lower(line)));  
-    }
-  }
+unsigned edit_distance(const std::string & a, const std::string & b)
+{
+  return a.size() <= b.size() ? EditPattern {a}.distance(b) : EditPattern {b}.distance(a);
+}
+
+bool in_category(const std::string & word, const std::string & name)
+{
+  const Dictionary & dictionary = Dictionary::instance();
+  Dictionary::Id id = dictionary.find(normalize(word));
+  return id != Dictionary::npos && category(name).contains(id);
+}
 
-  return dictionary->find(trim(lower(word))) != dictionary->end(); 
+bool in_dictionary(const std::string & word)
+{
+  return Dictionary::instance().contains(normalize(word));
 }
 
 std::string join(const std::vector<std::string> & words, const std::string & inner)
@@ -83,9 +193,47 @@ std::string join(const std::vector<std::string> & words, const std::string & inn
   return ss.str();
 }
 
+size_t length(const std::string & word)
+{
+  return utf8_clusters(word);
+}
+
+std::vector<std::string> letters(const std::string & word)
+{
+  std::vector<std::string> result {};
+
+  for (size_t at = 0, end; at < word.size(); at = end)
+  {
+    end = utf8_cluster(word, at);
+    result.push_back(word.substr(at, end - at));
+  }
+
+  return result;
+}
+
 std::string lower(const std::string & word)
 {
-  return charwise_transform(word, to_lower);
+  if (const Features * features = Features::find(word))
+  {
+    return features->lowered;
+  }
+
+  return utf8_fold(word);
+}
+
+bool matches(const std::string & word, const std::string & pattern)
+{
+  return Pattern::compile(pattern).matches(word);
+}
+
+bool rhymes(const std::string & a, const std::string & b)
+{
+  return Dictionary::instance().phonetic_index().same(PhoneticIndex::RHYME, normalize(a), normalize(b));
+}
+
+bool sounds_like(const std::string & a, const std::string & b)
+{
+  return Dictionary::instance().phonetic_index().same(PhoneticIndex::METAPHONE, normalize(a), normalize(b));
 }
 
 std::vector<std::string> split(const std::string & word, const std::string & delim)
@@ -106,24 +254,66 @@ std::vector<std::string> split(const std::string & word, const std::string & del
 
 unsigned sum_a1z26(const std::string & word)
 {
-  std::string intermediate = charwise_filter(lower(word), is_lower);
-  unsigned sum = 0;
-
-  for (char c : intermediate)
+  if (const Features * features = Features::find(word))
   {
-    sum += (c - 'a' + 1);
+    return features->a1z26;
   }
 
-  return sum;
+  return a1z26(lower(word));
 }
 
 std::string trim(const std::string & word)
 {
-  return charwise_filter(word, [](char c){ return c != ' ' && c != '\t' && c != '\n'; });
+  std::string result {};
+  result.reserve(word.size());
+
+  for (size_t at = 0; at < word.size(); )
+  {
+    if ((unsigned char) word[at] < 0x80)
+    {
+      if (! utf8_space(word[at])) result.push_back(word[at]);
+      at++;
+      continue;
+    }
+
+    // Byte order marks go too, as word lists saved by some editors start with one.
+
+    size_t begin = at;
+    char32_t c = utf8_decode(word, at);
+    if (! utf8_space(c) && c != 0xFEFF) result.append(word, begin, at - begin);
+  }
+
+  return result;
 }
 
 std::string upper(const std::string & word)
 {
-  return charwise_transform(word, to_upper);
+  return utf8_upper(word);
+}
+
+std::vector<std::string> words_containing(const std::string & fragment)
+{
+  const Dictionary & dictionary = Dictionary::instance();
+  std::vector<std::string> result {};
+
+  for (Dictionary::Id id : dictionary.substring_index().words(trim(lower(fragment))))
+  {
+    result.emplace_back(dictionary.word(id));
+  }
+
+  return result;
 }
 
+std::vector<std::string> words_matching(const std::string & pattern)
+{
+  const Dictionary & dictionary = Dictionary::instance();
+  Bitmap matched = Pattern::compile(pattern).matching(dictionary);
+  std::vector<std::string> result {};
+
+  for (size_t id = matched.next(0); id < matched.size(); id = matched.next(id + 1))
+  {
+    result.emplace_back(dictionary.word(id));
+  }
+
+  return result;
+}
@@ -2,8 +2,195 @@
 #ifndef PQ_STRING_H_
 #define PQ_STRING_H_
 
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
+
+class WordSet;
+
+/**
+ *  The image of one character under an encoding, at most five characters long.
+ */ 
+struct Code
+{
+  char          text[6];
+  unsigned char size;
+
+  constexpr std::string_view view() const
+  {
+    return std::string_view {text, size};
+  }
+};
+
+/**
+ *  A lookup table from every byte to its encoding.
+ */ 
+using CodeTable = std::array<Code, 256>;
+
+/**
+ *  Encodes every letter as its ASCII code and every other character as 0, each followed by a space.
+ */ 
+constexpr CodeTable ascii_table = []()
+{
+  CodeTable table {};
+
+  for (int c = 0; c < 256; c++)
+  {
+    Code & code = table[c];
+    bool alpha = ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+
+    if (! alpha)
+    {
+      code.text[code.size++] = '0';
+    }
+    else
+    {
+      if (c >= 100) code.text[code.size++] = '0' + c / 100;
+      code.text[code.size++] = '0' + c / 10 % 10;
+      code.text[code.size++] = '0' + c % 10;
+    }
+
+    code.text[code.size++] = ' ';
+  }
+
+  return table;
+}();
+
+/**
+ *  Encodes every letter as its morse code followed by a space, where '-' is a dot and '_' is a dash,
+ *  and drops every other character.
+ */ 
+constexpr CodeTable morse_table = []()
+{
+  constexpr std::string_view morse[26] = 
+    {"-_", "_---", "_-_-", "_--", "-", "--_-", "__-", "----", "--", "-___", "_-_", "-_--", "__", 
+      "_-", "___", "-__-", "__-_", "-_-", "---", "_", "--_", "---_", "-__", "_--_", "_-__", "__--"}; 
+
+  CodeTable table {};
+
+  for (int c = 0; c < 256; c++)
+  {
+    int letter = ('a' <= c && c <= 'z') ? c - 'a' : (('A' <= c && c <= 'Z') ? c - 'A' : -1);
+    if (letter < 0) continue;
+
+    Code & code = table[c];
+    for (char symbol : morse[letter])
+    {
+      code.text[code.size++] = symbol;
+    }
+    code.text[code.size++] = ' ';
+  }
+
+  return table;
+}();
+
+/**
+ *  Writes the encoding of the word under the given table into the buffer, which holds at least cap characters,
+ *  and returns the length of the full encoding. The output is cut off (and not null-terminated) if the encoding
+ *  is longer than cap.
+ */ 
+constexpr size_t encode (std::string_view word, const CodeTable & table, char * out, size_t cap)
+{
+  size_t len = 0;
+
+  for (unsigned char c : word)
+  {
+    const Code & code = table[c];
+
+    for (unsigned char k = 0; k < code.size; k++, len++)
+    {
+      if (len < cap) out[len] = code.text[k];
+    }
+  }
+
+  return len;
+}
+
+/**
+ *  Returns the FNV-1a hash of the encoding of the word under the given table, without materializing it.
+ */ 
+constexpr uint64_t encoded_hash (std::string_view word, const CodeTable & table)
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  for (unsigned char c : word)
+  {
+    for (char symbol : table[c].view())
+    {
+      hash = (hash ^ (unsigned char) symbol) * 1099511628211ull;
+    }
+  }
+
+  return hash;
+}
+
+/**
+ *  Returns the length of the encoding of the word under the given table.
+ */ 
+constexpr size_t encoded_length (std::string_view word, const CodeTable & table)
+{
+  size_t len = 0;
+
+  for (unsigned char c : word)
+  {
+    len += table[c].size;
+  }
+
+  return len;
+}
+
+/**
+ *  What the functions below derive from a word before looking at it, extracted once.
+ *
+ *  While a scope for the features is alive on a thread, the functions below that are given the features' very
+ *  word (the same string object, as when rules are evaluated on it) use them instead of lowercasing and trimming
+ *  the word again. This is how one word is evaluated against many rules while being normalized only once.
+ */ 
+struct Features
+{
+  /**
+   *  Extracts the features of the word.
+   */ 
+  explicit Features (const std::string & word);
+
+  /**
+   *  Returns the features in scope on this thread if the word is theirs, or null otherwise.
+   */ 
+  static const Features * find (const std::string & word);
+
+  /**
+   *  Puts the features in scope on the calling thread for as long as it lives.
+   */ 
+  class Scope
+  {
+    public:
+
+      explicit Scope (const Features & features);
+
+      ~Scope ();
+
+      Scope (const Scope &) = delete;
+      Scope & operator= (const Scope &) = delete;
+
+    private:
+
+      const Features * m_previous;
+  };
+
+  std::string word;
+  std::string lowered;
+  std::string normalized;
+  unsigned    a1z26;
+};
+
+/**
+ *  Returns the words of the named category, or of an expression combining categories such as
+ *  "colors|animals-verbs" (see Category.h). Throws an error if a category does not exist.
+ */ 
+const WordSet & category (const std::string & name);
 
 /**
  *  Returns a word consisting only of the letters that match the given filter.
@@ -16,11 +203,37 @@ std::string charwise_filter (const std::string & word, std::function<bool(char)>
  */ 
 std::string charwise_transform (const std::string & word, std::function<std::string(char)> map);
 
+/**
+ *  Counts the dictionary words that contain the given fragment.
+ */ 
+size_t count_containing (const std::string & fragment);
+
+/**
+ *  Counts the dictionary words that the pattern matches (see Pattern.h).
+ */ 
+size_t count_matching (const std::string & pattern);
+
 /**
  *  Counts the occurences of the given character in the word.
  */ 
 unsigned count (const std::string & word, char ch);
 
+/**
+ *  Returns the Levenshtein distance between the two words, counting code points (see EditPattern in EditIndex.h).
+ */ 
+unsigned edit_distance (const std::string & a, const std::string & b);
+
+/**
+ *  Returns the encoding of the word under the given table.
+ */ 
+std::string encode (const std::string & word, const CodeTable & table);
+
+/**
+ *  Determines if the word is in the named category, or in an expression combining categories.
+ *  Throws an error if a category does not exist.
+ */ 
+bool in_category (const std::string & word, const std::string & name);
+
 /**
  *  Determines if the word is found in the dictionary supplied in the data path.
  */ 
@@ -32,10 +245,37 @@ bool in_dictionary (const std::string & word);
 std::string join (const std::vector<std::string> & words, const std::string & inner);
 
 /**
- *  Sugar for charwise_transform(word, [](char c){ return to_lower(c); }).
+ *  Returns the number of letters in the word, counting a letter with its accents, or a flag, as one (see
+ *  utf8_clusters in Utf8.h).
+ */ 
+size_t length (const std::string & word);
+
+/**
+ *  Returns the letters of the word in order, each one the UTF-8 text of a grapheme cluster.
+ */ 
+std::vector<std::string> letters (const std::string & word);
+
+/**
+ *  Returns the word case folded and in NFC (see utf8_fold in Utf8.h). For ASCII words this is the lowercase.
  */ 
 std::string lower (const std::string & word);
 
+/**
+ *  Determines if the pattern matches the word (see Pattern.h). The pattern is compiled once and cached
+ *  on the calling thread, among the last few used, so matching with a fixed pattern does not allocate.
+ */ 
+bool matches (const std::string & word, const std::string & pattern);
+
+/**
+ *  Determines if the two words rhyme, that is if they have the same rhyming tail (see Phonetic.h).
+ */ 
+bool rhymes (const std::string & a, const std::string & b);
+
+/**
+ *  Determines if the two words have the same Metaphone key (see Phonetic.h).
+ */ 
+bool sounds_like (const std::string & a, const std::string & b);
+
 /**
  *  Splits the word on the given delimiter.
  */ 
@@ -44,20 +284,30 @@ std::vector<std::string> split (const std::string & word, const std::string & de
 /**
  *  Returns the sum of values of the letters in the trimmed, lowercase,
  *  alphabetically-filtered copy of the given word, where a = 1, b = 2,
- *  ..., z = 26.
+ *  ..., z = 26. Letters with diacritics count as their base letter.
  */ 
 unsigned sum_a1z26 (const std::string & word);
 
 /**
- *  Sugar for charwise_filter(word, [](char c){ return ! is_space(c); }).
+ *  Returns the word without any of its whitespace, ASCII or Unicode, or byte order marks.
  */ 
 std::string trim (const std::string & word);
 
 /**
- *  Sugar for charwise_transform(word, [](char c){ return to_upper(c); }).
+ *  Returns the word in uppercase and in NFC (see utf8_upper in Utf8.h).
  */ 
 std::string upper (const std::string & word);
 
+/**
+ *  Returns the dictionary words that contain the given fragment, in alphabetical order.
+ */ 
+std::vector<std::string> words_containing (const std::string & fragment);
+
+/**
+ *  Returns the dictionary words that the pattern matches, in alphabetical order.
+ */ 
+std::vector<std::string> words_matching (const std::string & pattern);
+
 /**
  *  Built-in charwisers.
  */ 
@@ -104,11 +354,11 @@ const std::function<bool(char)> is_upper = [](char c)
 
 /**
  *  Built-in mapper that takes every alphabetical character to its ASCII representation 
- *  and every other character to 0.
+ *  and every other character to 0. Prefer encode(word, ascii_table) for whole words.
  */ 
 const std::function<std::string(char)> to_ascii = [](char c) 
 { 
-  return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ? std::to_string((int) c) + " " : "0 "; 
+  return std::string {ascii_table[(unsigned char) c].view()};
 };
 
 /**
@@ -120,14 +370,12 @@ const std::function<std::string(char)> to_lower = [](char c)
 };
 
 /**
- *  Built-in mapper that takes every letter to its morse representation. 
+ *  Built-in mapper that takes every letter to its morse representation. Prefer encode(word, morse_table)
+ *  for whole words.
  */ 
 const std::function<std::string(char)> to_morse = [](char c)
 { 
-  static std::vector<std::string> morse = 
-    {"-_", "_---", "_-_-", "_--", "-", "--_-", "__-", "----", "--", "-___", "_-_", "-_--", "__", 
-      "_-", "___", "-__-", "__-_", "-_-", "---", "_", "--_", "---_", "-__", "_--_", "_-__", "__--"}; 
-  return ('a' <= c && c <= 'z') ? morse[c - 'a'] + " " : (('A' <= c && c <= 'z') ? morse[c - 'A'] + " " : ""); 
+  return std::string {morse_table[(unsigned char) c].view()};
 };
 
 /**
@@ -0,0 +1,245 @@
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Error.h"
+#include "SubstringIndex.h"
+
+namespace
+{
+  constexpr char magic[8] = {'P', 'Q', 'S', 'U', 'F', 'X', '0', '2'};
+}
+
+SubstringIndex::SubstringIndex(const Dictionary & dictionary)
+{
+  const std::string & text = dictionary.buffer();
+
+  Header header {};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.dictionary_hash = dictionary.hash();
+  header.words = dictionary.size();
+  header.suffixes = text.size() - dictionary.size();
+  header.text_length = text.size();
+
+  m_image.resize((image_size(header) + 7) / 8);
+  char * image = reinterpret_cast<char *>(m_image.data());
+  std::memcpy(image, &header, sizeof(Header));
+
+  uint32_t * offsets = reinterpret_cast<uint32_t *>(image + sizeof(Header));
+  uint32_t * suffixes = offsets + header.words + 1;
+  uint32_t * previous = suffixes + header.suffixes;
+  char * copy = reinterpret_cast<char *>(previous + header.suffixes);
+
+  for (Id id = 0; id <= header.words; id++)
+  {
+    offsets[id] = dictionary.offset(id);
+  }
+
+  std::memcpy(copy, text.data(), text.size());
+
+  size_t n = 0;
+  for (uint32_t pos = 0; pos < text.size(); pos++)
+  {
+    if (text[pos] != '\n') suffixes[n++] = pos;
+  }
+
+  // Every word ends in a newline, which sorts below every letter, so comparing bytes up to the first
+  // newline orders the cut-off suffixes correctly without ever reading into the next word.
+
+  auto common = [&](uint32_t a, uint32_t b)
+  {
+    size_t k = 0;
+    while (copy[a + k] == copy[b + k] && copy[a + k] != '\n') k++;
+    return k;
+  };
+
+  std::sort(suffixes, suffixes + n, [&](uint32_t a, uint32_t b)
+  {
+    size_t k = common(a, b);
+    unsigned char x = copy[a + k];
+    unsigned char y = copy[b + k];
+    return x != y ? x < y : a < b;
+  });
+
+  // Positions are stored one up, so that 0 stands for a suffix whose word has no earlier one.
+
+  std::vector<Id> owner(text.size());
+  for (Id id = 0; id < header.words; id++)
+  {
+    std::fill(owner.begin() + offsets[id], owner.begin() + offsets[id + 1], id);
+  }
+
+  std::vector<uint32_t> last(header.words, 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    Id id = owner[suffixes[i]];
+    previous[i] = last[id];
+    last[id] = i + 1;
+  }
+
+  attach(image);
+}
+
+SubstringIndex::~SubstringIndex()
+{
+  if (m_mapping)
+  {
+    munmap(m_mapping, m_mapping_length);
+  }
+}
+
+void SubstringIndex::attach(const char * image)
+{
+  m_header = reinterpret_cast<const Header *>(image);
+  m_offsets = reinterpret_cast<const uint32_t *>(image + sizeof(Header));
+  m_suffixes = m_offsets + m_header->words + 1;
+  m_previous = m_suffixes + m_header->suffixes;
+  m_text = reinterpret_cast<const char *>(m_previous + m_header->suffixes);
+}
+
+int SubstringIndex::compare(uint32_t position, std::string_view fragment) const
+{
+  for (size_t k = 0; k < fragment.size(); k++)
+  {
+    unsigned char x = m_text[position + k];
+    unsigned char y = fragment[k];
+
+    if (x != y) return x < y ? -1 : 1;
+  }
+
+  return 0;
+}
+
+size_t SubstringIndex::count(std::string_view fragment) const
+{
+  auto [begin, end] = range(fragment);
+  return end - begin;
+}
+
+size_t SubstringIndex::count_words(std::string_view fragment) const
+{
+  auto [begin, end] = range(fragment);
+  return std::count_if(m_previous + begin, m_previous + end, [begin](uint32_t p) { return p <= begin; });
+}
+
+size_t SubstringIndex::image_size(const Header & header)
+{
+  return sizeof(Header)
+    + sizeof(uint32_t) * (header.words + 1)
+    + sizeof(uint32_t) * header.suffixes
+    + sizeof(uint32_t) * header.suffixes
+    + header.text_length;
+}
+
+std::unique_ptr<SubstringIndex> SubstringIndex::map(const std::string & path, uint64_t dictionary_hash)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(Header))
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  void * mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  const Header * header = reinterpret_cast<const Header *>(mapping);
+  if (std::memcmp(header->magic, magic, sizeof(magic)) != 0
+      || header->dictionary_hash != dictionary_hash
+      || image_size(* header) != (size_t) info.st_size)
+  {
+    munmap(mapping, info.st_size);
+    return nullptr;
+  }
+
+  std::unique_ptr<SubstringIndex> index {new SubstringIndex {}};
+  index->m_mapping = mapping;
+  index->m_mapping_length = info.st_size;
+  index->attach(reinterpret_cast<const char *>(mapping));
+  return index;
+}
+
+std::pair<size_t, size_t> SubstringIndex::range(std::string_view fragment) const
+{
+  const uint32_t * first = m_suffixes;
+  const uint32_t * last = m_suffixes + m_header->suffixes;
+
+  if (fragment.empty() || fragment.find('\n') != std::string_view::npos)
+  {
+    return {0, 0};
+  }
+
+  const uint32_t * begin = std::partition_point(first, last, [&](uint32_t pos){ return compare(pos, fragment) < 0; });
+  const uint32_t * end = std::partition_point(begin, last, [&](uint32_t pos){ return compare(pos, fragment) == 0; });
+
+  return {begin - first, end - first};
+}
+
+void SubstringIndex::save(const std::string & path) const
+{
+  // Writing over the file in place would pull it from under the processes that have it mapped.
+
+  std::string temporary = path + "." + std::to_string(getpid());
+  std::error_code error {};
+
+  {
+    std::ofstream fs {temporary, std::ios::binary | std::ios::trunc};
+    fs.write(reinterpret_cast<const char *>(m_header), image_size(* m_header));
+
+    if (! fs)
+    {
+      std::filesystem::remove(temporary, error);
+      THROW_ERROR("Could not save the substring index to '", temporary, "'.");
+    }
+  }
+
+  std::filesystem::rename(temporary, path, error);
+  if (error)
+  {
+    std::filesystem::remove(temporary, error);
+    THROW_ERROR("Could not save the substring index to '", path, "'.");
+  }
+}
+
+size_t SubstringIndex::size() const
+{
+  return m_header->suffixes;
+}
+
+SubstringIndex::Id SubstringIndex::word_of(size_t i) const
+{
+  const uint32_t * end = m_offsets + m_header->words + 1;
+  return std::upper_bound(m_offsets, end, m_suffixes[i]) - m_offsets - 1;
+}
+
+std::vector<SubstringIndex::Id> SubstringIndex::words(std::string_view fragment) const
+{
+  auto [begin, end] = range(fragment);
+  std::vector<Id> ids {};
+
+  for (size_t i = begin; i < end; i++)
+  {
+    if (m_previous[i] <= begin) ids.push_back(word_of(i));
+  }
+
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
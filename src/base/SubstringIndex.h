@@ -0,0 +1,120 @@
+
+#ifndef PQ_SUBSTRING_INDEX_H_
+#define PQ_SUBSTRING_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Dictionary.h"
+
+/**
+ *  A suffix array over the dictionary's contiguous word buffer, answering "which words contain this substring".
+ *
+ *  Every suffix is cut off at the end of its word, so suffixes never span two words. Alongside the array, each
+ *  position keeps the previous position whose suffix starts in the same word: a word has exactly one occurrence
+ *  in a range whose previous occurrence lies before the range, so counting the distinct words in a range is
+ *  counting those. The array, that column, the word offsets and the text itself are laid out in one flat image,
+ *  which can be saved to disk and memory-mapped back without any parsing.
+ */ 
+class SubstringIndex
+{
+  public:
+
+    using Id = Dictionary::Id;
+
+    /**
+     *  Builds the index over the given dictionary. The index keeps its own copy of the text.
+     */ 
+    explicit SubstringIndex(const Dictionary & dictionary);
+
+    ~SubstringIndex();
+
+    SubstringIndex(const SubstringIndex &) = delete;
+    SubstringIndex & operator=(const SubstringIndex &) = delete;
+
+    /**
+     *  Memory-maps an index saved at the given path, returning null if the file is missing, malformed,
+     *  or was built over a dictionary with a different hash.
+     */ 
+    static std::unique_ptr<SubstringIndex> map(const std::string & path, uint64_t dictionary_hash);
+
+    /**
+     *  Returns the number of occurrences of the fragment across all words.
+     */ 
+    size_t count(std::string_view fragment) const;
+
+    /**
+     *  Returns the number of distinct words that contain the fragment.
+     */ 
+    size_t count_words(std::string_view fragment) const;
+
+    /**
+     *  Returns the half-open range of suffix array positions whose suffixes start with the fragment.
+     */ 
+    std::pair<size_t, size_t> range(std::string_view fragment) const;
+
+    /**
+     *  Saves the index to the given path, replacing the file at once so that processes which have it mapped
+     *  keep their copy; throws an error on failure.
+     */ 
+    void save(const std::string & path) const;
+
+    /**
+     *  Returns the number of suffixes.
+     */ 
+    size_t size() const;
+
+    /**
+     *  Returns the id of the word in which the i-th suffix starts.
+     */ 
+    Id word_of(size_t i) const;
+
+    /**
+     *  Returns the ids of all words containing the fragment, in ascending order.
+     */ 
+    std::vector<Id> words(std::string_view fragment) const;
+
+  private:
+
+    /**
+     *  The fixed-size header at the start of the flat image.
+     */ 
+    struct Header
+    {
+      char     magic[8];
+      uint64_t dictionary_hash;
+      uint64_t words;
+      uint64_t suffixes;
+      uint64_t text_length;
+    };
+
+    SubstringIndex() = default;
+
+    /**
+     *  Points the accessors at the sections of the flat image.
+     */ 
+    void attach(const char * image);
+
+    /**
+     *  Compares the suffix at the given text position against the fragment, looking at most at the fragment's length.
+     */ 
+    int compare(uint32_t position, std::string_view fragment) const;
+
+    static size_t image_size(const Header & header);
+
+    std::vector<uint64_t> m_image;
+    void *                m_mapping        {nullptr};
+    size_t                m_mapping_length {0};
+
+    const Header *        m_header         {nullptr};
+    const uint32_t *      m_offsets        {nullptr};
+    const uint32_t *      m_suffixes       {nullptr};
+    const uint32_t *      m_previous       {nullptr};
+    const char *          m_text           {nullptr};
+};
+
+#endif
@@ -0,0 +1,177 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+#include <random>
+
+#include "Agent.h"
+#include "Error.h"
+#include "Job.h"
+#include "Logging.h"
+#include "Parallel.h"
+#include "Tournament.h"
+
+Tournament::Tournament(const Settings & settings)
+  : m_settings {settings}
+{}
+
+std::ostream & Tournament::format(std::ostream & out) const
+{
+  if (m_outcomes.empty())
+  {
+    U_LOGW("No games have been played yet.");
+    return out;
+  }
+
+  size_t pad = 9;
+  for (const Outcome & outcome : m_outcomes)
+  {
+    pad = std::max(pad, outcome.rule.size());
+  }
+
+  U_LOGI("Tournament (", m_settings.games, " games per pairing, solved after ", m_settings.streak, 
+    " correct predictions in a row, at most ", m_settings.max_guesses, " guesses):");
+
+  out 
+    << std::setw(pad) << std::left << "RULE:" << " | "
+    << std::setw(8) << std::left << "AGENT:" << " | "
+    << std::setw(7) << std::right << "SOLVED" << " | "
+    << std::setw(7) << "MEAN" << " | "
+    << std::setw(7) << "P50" << " | "
+    << std::setw(7) << "P90" 
+    << "\n"
+    << std::setw(pad + 54) << std::setfill('-') << std::left << "-" 
+    << "\n"
+    << std::setfill(' ');
+
+  for (const Outcome & outcome : m_outcomes)
+  {
+    std::vector<size_t> solved {};
+    std::copy_if(outcome.guesses.begin(), outcome.guesses.end(), std::back_inserter(solved), [](size_t n){ return n > 0; });
+    std::sort(solved.begin(), solved.end());
+
+    out 
+      << std::setw(pad) << std::left << outcome.rule << " | "
+      << std::setw(8) << std::left << outcome.agent << " | "
+      << std::setw(6) << std::right << std::fixed << std::setprecision(1) 
+      << 100.0 * solved.size() / outcome.guesses.size() << "% | ";
+
+    if (solved.empty())
+    {
+      out << std::setw(7) << "-" << " | " << std::setw(7) << "-" << " | " << std::setw(7) << "-" << "\n";
+      continue;
+    }
+
+    double mean = std::accumulate(solved.begin(), solved.end(), 0.0) / solved.size();
+    out 
+      << std::setw(7) << mean << " | "
+      << std::setw(7) << solved[solved.size() / 2] << " | "
+      << std::setw(7) << solved[std::min(solved.size() - 1, solved.size() * 9 / 10)] 
+      << "\n";
+  }
+
+  out 
+    << "\n" << m_tests << " tests in " << std::setprecision(3) << m_seconds << "s ("
+    << std::setprecision(0) << m_tests / std::max(m_seconds, 1e-9) << " tests/s)\n\n"
+    << std::defaultfloat;
+
+  return out;
+}
+
+size_t Tournament::play(const Rule & rule, const std::string & name, uint64_t seed, size_t & tests) const
+{
+  const Dictionary & dictionary = Dictionary::instance();
+  std::unique_ptr<Agent> agent = Agent::make(name, dictionary);
+  std::mt19937_64 rng {seed};
+
+  History history;
+  history.reseed(seed);
+  rule.initialize(history);
+
+  size_t streak = 0;
+  for (size_t guesses = 1; guesses <= m_settings.max_guesses && guesses <= dictionary.size(); guesses++)
+  {
+    Dictionary::Id id = agent->choose(rng);
+    std::string word {dictionary.word(id)};
+
+    bool predicted = agent->predict(id);
+    Verdict verdict = rule.evaluate(word, history);
+    bool accepted = verdict.accepted;
+    tests++;
+
+    history.push(Guess {word, accepted}, verdict.delta);
+    agent->observe(id, accepted);
+
+    streak = predicted == accepted ? streak + 1 : 0;
+    if (streak >= m_settings.streak)
+    {
+      return guesses;
+    }
+  }
+
+  return 0;
+}
+
+void Tournament::run(const std::map<std::string, const Rule *> & table)
+{
+  const std::vector<std::string> & agents = Agent::names();
+
+  m_outcomes.clear();
+  for (auto [name, rule] : table)
+  {
+    for (const std::string & agent : agents)
+    {
+      m_outcomes.push_back(Outcome { name, agent, std::vector<size_t> (m_settings.games) });
+    }
+  }
+
+  std::vector<const Rule *> rules {};
+  for (auto [name, rule] : table)
+  {
+    rules.push_back(rule);
+  }
+
+  // One job per game; jobs are interleaved across pairings so that slow rules spread over all workers.
+
+  size_t pairings = m_outcomes.size();
+  size_t jobs = pairings * m_settings.games;
+  std::atomic<size_t> tests {0};
+
+  Dictionary::instance();
+  Job::expect(jobs);
+  auto start = std::chrono::steady_clock::now();
+
+  parallel_for(jobs, [&](size_t begin, size_t end, size_t)
+  {
+    size_t local = 0;
+
+    for (size_t job = begin; job < end; job++)
+    {
+      size_t pairing = job % pairings;
+      size_t game = job / pairings;
+      Outcome & outcome = m_outcomes[pairing];
+
+      uint64_t seed = m_settings.seed * 0x9e3779b97f4a7c15ull + job;
+      Job::checkpoint();
+
+      try
+      {
+        outcome.guesses[game] = play(* rules[pairing / agents.size()], outcome.agent, seed, local);
+      }
+      catch (std::exception & e)
+      {
+        // A rule or agent that throws, be it an Error or anything from the standard library, fails the game.
+        outcome.guesses[game] = 0;
+      }
+
+      Job::advance(1);
+    }
+
+    tests += local;
+  });
+
+  m_tests = tests;
+  m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
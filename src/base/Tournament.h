@@ -0,0 +1,75 @@
+
+#ifndef PQ_TOURNAMENT_H_
+#define PQ_TOURNAMENT_H_
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Rule.h"
+
+/**
+ *  Plays many simulated games of every agent against every rule, in parallel, and summarizes how many
+ *  guesses each agent needs to solve each rule.
+ *
+ *  Every game has its own history and agent, seeded from the tournament seed and the game's position, so a
+ *  tournament with the same settings always plays the same games.
+ */ 
+class Tournament
+{
+  public:
+
+    /**
+     *  The knobs of a tournament.
+     */ 
+    struct Settings
+    {
+      size_t   games       {100};
+      size_t   max_guesses {200};
+      size_t   streak      {10};
+      uint64_t seed        {1};
+    };
+
+    /**
+     *  The outcomes of all games of one agent against one rule; a game solved after n guesses records n,
+     *  and a game that was not solved, or that ended in an exception, records zero.
+     */ 
+    struct Outcome
+    {
+      std::string         rule;
+      std::string         agent;
+      std::vector<size_t> guesses;
+    };
+
+    /**
+     *  Constructs a tournament with the given settings.
+     */ 
+    explicit Tournament(const Settings & settings);
+
+    /**
+     *  Prints the guesses-to-solve distribution of every rule and agent, and the throughput.
+     */ 
+    std::ostream & format(std::ostream & out) const;
+
+    /**
+     *  Plays every game of every agent against every rule in the table.
+     */ 
+    void run(const std::map<std::string, const Rule *> & table);
+
+  private:
+
+    /**
+     *  Plays a single game and returns the number of guesses it took, or zero if it was not solved.
+     */ 
+    size_t play(const Rule & rule, const std::string & agent, uint64_t seed, size_t & tests) const;
+
+    Settings             m_settings;
+    std::vector<Outcome> m_outcomes;
+    size_t               m_tests   {0};
+    double               m_seconds {0};
+};
+
+#endif
+
@@ -0,0 +1,145 @@
+
+#include <cstring>
+#include <iterator>
+
+#include "Error.h"
+#include "Trace.h"
+
+namespace
+{
+  constexpr char magic[4] = {'P', 'Q', 'T', 'R'};
+  constexpr uint8_t version = 1;
+}
+
+Trace::Writer::Writer(const std::string & path)
+  : m_path {path}
+  , m_out {path, std::ios::binary | std::ios::trunc}
+{
+  m_out.write(magic, sizeof(magic));
+  m_out.put(version);
+
+  if (! m_out)
+  {
+    THROW_ERROR("Could not create the trace file '", path, "'.");
+  }
+}
+
+void Trace::Writer::flush()
+{
+  m_out.flush();
+}
+
+void Trace::Writer::line(const std::string & line)
+{
+  m_out.put(LINE);
+
+  uint64_t length = line.size();
+  while (length >= 0x80)
+  {
+    m_out.put((char) (length | 0x80));
+    length >>= 7;
+  }
+
+  m_out.put((char) length);
+  m_out.write(line.data(), line.size());
+}
+
+const std::string & Trace::Writer::path() const
+{
+  return m_path;
+}
+
+void Trace::Writer::seed(uint64_t seed)
+{
+  m_out.put(SEED);
+
+  for (int i = 0; i < 8; i++)
+  {
+    m_out.put((char) (seed >> (8 * i)));
+  }
+}
+
+void Trace::Writer::verdict(bool accepted)
+{
+  m_out.put(VERDICT);
+  m_out.put(accepted ? 1 : 0);
+}
+
+std::vector<Trace::Event> Trace::load(const std::string & path)
+{
+  std::ifstream in {path, std::ios::binary};
+  if (! in)
+  {
+    THROW_ERROR("Could not open the trace file '", path, "'.");
+  }
+
+  std::string data {std::istreambuf_iterator<char> {in}, std::istreambuf_iterator<char> {}};
+  if (data.size() < sizeof(magic) + 1 || std::memcmp(data.data(), magic, sizeof(magic)) != 0)
+  {
+    THROW_ERROR("'", path, "' is not a trace file.");
+  }
+
+  if ((uint8_t) data[sizeof(magic)] != version)
+  {
+    THROW_ERROR("The trace '", path, "' has version ", (int) (uint8_t) data[sizeof(magic)], "; expected ", (int) version, ".");
+  }
+
+  std::vector<Event> events {};
+  size_t at = sizeof(magic) + 1;
+
+  auto need = [&](size_t n)
+  {
+    if (data.size() - at < n)
+    {
+      THROW_ERROR("The trace '", path, "' is truncated at byte ", at, ".");
+    }
+  };
+
+  while (at < data.size())
+  {
+    Event event {(Kind) data[at++]};
+
+    switch (event.kind)
+    {
+      case LINE:
+        {
+          uint64_t length = 0;
+          for (int shift = 0; ; shift += 7)
+          {
+            need(1);
+            uint8_t byte = data[at++];
+            length |= (uint64_t) (byte & 0x7f) << shift;
+            if (! (byte & 0x80)) break;
+          }
+
+          need(length);
+          event.line = data.substr(at, length);
+          at += length;
+          break;
+        }
+      case SEED:
+        {
+          need(8);
+          for (int i = 0; i < 8; i++)
+          {
+            event.value |= (uint64_t) (uint8_t) data[at++] << (8 * i);
+          }
+          break;
+        }
+      case VERDICT:
+        {
+          need(1);
+          event.value = data[at++] != 0;
+          break;
+        }
+      default:
+        {
+          THROW_ERROR("The trace '", path, "' has an unknown event kind ", (int) event.kind, " at byte ", at - 1, ".");
+        }
+    }
+
+    events.push_back(std::move(event));
+  }
+
+  return events;
+}
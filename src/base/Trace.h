@@ -0,0 +1,88 @@
+
+#ifndef PQ_TRACE_H_
+#define PQ_TRACE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ *  A compact binary record of a session, for replaying it later.
+ *
+ *  A trace is the magic "PQTR" and a version byte, followed by events. Each event is a kind byte and a payload:
+ *  a command line is a varint length and that many bytes, a seed is 8 little-endian bytes, and a verdict is one
+ *  byte. Seeds and verdicts belong to the command line before them: the seed a new game drew, and the decision
+ *  the rule made on a guess.
+ */ 
+class Trace
+{
+  public:
+
+    enum Kind : uint8_t
+    {
+      LINE = 1,
+      SEED = 2,
+      VERDICT = 3
+    };
+
+    /**
+     *  One recorded event; only the field matching its kind is meaningful.
+     */ 
+    struct Event
+    {
+      Kind        kind;
+      std::string line;
+      uint64_t    value {0};
+    };
+
+    /**
+     *  Appends events to a trace file as they happen.
+     */ 
+    class Writer
+    {
+      public:
+
+        /**
+         *  Creates the trace file at the given path, replacing any existing file; throws an error on failure.
+         */ 
+        explicit Writer(const std::string & path);
+
+        /**
+         *  Pushes the events written so far to the file.
+         */ 
+        void flush();
+
+        /**
+         *  Records a command line.
+         */ 
+        void line(const std::string & line);
+
+        /**
+         *  Returns the path of the trace file.
+         */ 
+        const std::string & path() const;
+
+        /**
+         *  Records the seed drawn by the last command.
+         */ 
+        void seed(uint64_t seed);
+
+        /**
+         *  Records the decision made on the last guess.
+         */ 
+        void verdict(bool accepted);
+
+      private:
+
+        std::string   m_path;
+        std::ofstream m_out;
+    };
+
+    /**
+     *  Reads every event of the trace at the given path; throws an error if the file is missing or malformed.
+     */ 
+    static std::vector<Event> load(const std::string & path);
+};
+
+#endif
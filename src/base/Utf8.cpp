@@ -0,0 +1,573 @@
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "UnicodeTables.h"
+#include "Utf8.h"
+
+namespace
+{
+  constexpr char32_t replacement = 0xFFFD;
+  constexpr char32_t zero_width_joiner = 0x200D;
+
+  // Hangul syllables compose and decompose arithmetically from their leading consonant, vowel and trailing
+  // consonant jamo.
+
+  constexpr char32_t hangul_s = 0xAC00;
+  constexpr char32_t hangul_l = 0x1100;
+  constexpr char32_t hangul_v = 0x1161;
+  constexpr char32_t hangul_t = 0x11A7;
+  constexpr char32_t hangul_l_count = 19;
+  constexpr char32_t hangul_v_count = 21;
+  constexpr char32_t hangul_t_count = 28;
+  constexpr char32_t hangul_n_count = hangul_v_count * hangul_t_count;
+  constexpr char32_t hangul_s_count = hangul_l_count * hangul_n_count;
+
+  enum class Case
+  {
+    FOLD,
+    UPPER
+  };
+
+  /**
+   *  Returns the range of the table that holds the code point, or null.
+   */
+  template <typename Range>
+  const Range * find(std::span<const Range> table, char32_t c)
+  {
+    auto it = std::upper_bound(table.begin(), table.end(), c, [](char32_t c, const Range & range) { return c < range.first; });
+    return it != table.begin() && c <= (it - 1)->last ? &* (it - 1) : nullptr;
+  }
+
+  /**
+   *  Maps the case of the ASCII letters in the text into out, which has room for the text, 16 bytes at a time.
+   *  Returns false as soon as it meets a byte that is not ASCII, with out written in part.
+   */
+  bool ascii_case(std::string_view text, char * out, Case mapping)
+  {
+    const unsigned char first = mapping == Case::FOLD ? 'A' : 'a';
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i below = _mm_set1_epi8(first - 1);
+    const __m128i above = _mm_set1_epi8(first + 26);
+    const __m128i flip = _mm_set1_epi8(0x20);
+
+    auto block = [&](const char * from, char * to)
+    {
+      __m128i bytes = _mm_loadu_si128((const __m128i *) from);
+      if (_mm_movemask_epi8(bytes))
+      {
+        return false;
+      }
+
+      // Bytes above 0x7F would compare as negative, but there are none by now.
+
+      __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(bytes, below), _mm_cmplt_epi8(bytes, above));
+      _mm_storeu_si128((__m128i *) to, _mm_xor_si128(bytes, _mm_and_si128(letters, flip)));
+      return true;
+    };
+
+    for (; i + 16 <= text.size(); i += 16)
+    {
+      if (! block(text.data() + i, out + i)) return false;
+    }
+
+    // Most words are shorter than a block, so the rest is padded to one rather than finished byte by byte.
+
+    if (i < text.size())
+    {
+      char padded[16] {};
+      std::memcpy(padded, text.data() + i, text.size() - i);
+      if (! block(padded, padded)) return false;
+      std::memcpy(out + i, padded, text.size() - i);
+    }
+#else
+    for (; i < text.size(); i++)
+    {
+      unsigned char c = text[i];
+      if (c >= 0x80) return false;
+      out[i] = (unsigned) (c - first) < 26 ? c ^ 0x20 : c;
+    }
+#endif
+
+    return true;
+  }
+
+  uint8_t combining_class(char32_t c)
+  {
+    const PropertyRange * range = c < 0x300 ? nullptr : find<PropertyRange>(combining_classes, c);
+    return range ? range->value : 0;
+  }
+
+  /**
+   *  Returns the composition of the two code points, or 0 if they do not compose.
+   */
+  char32_t compose(char32_t a, char32_t b)
+  {
+    // Every code point that composes with one before it is past U+0300.
+
+    if (b < 0x300)
+    {
+      return 0;
+    }
+
+    if (a - hangul_l < hangul_l_count && b - hangul_v < hangul_v_count)
+    {
+      return hangul_s + ((a - hangul_l) * hangul_v_count + (b - hangul_v)) * hangul_t_count;
+    }
+
+    if (a - hangul_s < hangul_s_count && (a - hangul_s) % hangul_t_count == 0 && b - hangul_t - 1 < hangul_t_count - 1)
+    {
+      return a + (b - hangul_t);
+    }
+
+    static const std::vector<Decomposition> pairs = []()
+    {
+      std::vector<Decomposition> pairs {};
+      std::copy_if(std::begin(canonical_decompositions), std::end(canonical_decompositions), std::back_inserter(pairs),
+          [](const Decomposition & d) { return d.composes; });
+
+      std::sort(pairs.begin(), pairs.end(), [](const Decomposition & x, const Decomposition & y)
+      {
+        return x.first != y.first ? x.first < y.first : x.second < y.second;
+      });
+
+      return pairs;
+    }();
+
+    auto it = std::lower_bound(pairs.begin(), pairs.end(), std::make_pair(a, b), [](const Decomposition & d, std::pair<char32_t, char32_t> key)
+    {
+      return d.first != key.first ? d.first < key.first : d.second < key.second;
+    });
+
+    return it != pairs.end() && it->first == a && it->second == b ? it->composite : 0;
+  }
+
+  /**
+   *  Composes the canonically ordered code points in place, as the last step of NFC: each combining mark
+   *  composes with the last starter before it unless another mark of the same or a lower class comes between.
+   */
+  void compose(std::u32string & points)
+  {
+    if (points.empty())
+    {
+      return;
+    }
+
+    size_t starter = 0;
+    size_t end = 1;
+    int last = combining_class(points[0]) == 0 ? 0 : 256;
+
+    for (size_t i = 1; i < points.size(); i++)
+    {
+      char32_t c = points[i];
+      int cls = combining_class(c);
+      char32_t composite = compose(points[starter], c);
+
+      if (composite && (last < cls || last == 0))
+      {
+        points[starter] = composite;
+        continue;
+      }
+
+      if (cls == 0)
+      {
+        starter = end;
+      }
+
+      last = cls;
+      points[end++] = c;
+    }
+
+    points.resize(end);
+  }
+
+  /**
+   *  Decodes the code point at the offset and advances past it, or past one byte of a malformed sequence.
+   */
+  char32_t decode(std::string_view text, size_t & at, bool & valid)
+  {
+    constexpr char32_t least[] = {0, 0, 0x80, 0x800, 0x10000};
+
+    unsigned char lead = text[at];
+    valid = true;
+
+    if (lead < 0x80)
+    {
+      at++;
+      return lead;
+    }
+
+    size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+    if (length > 0 && lead <= 0xF4 && at + length <= text.size())
+    {
+      char32_t c = lead & (0x7F >> length);
+      size_t k = 1;
+
+      for (; k < length && ((unsigned char) text[at + k] & 0xC0) == 0x80; k++)
+      {
+        c = c << 6 | ((unsigned char) text[at + k] & 0x3F);
+      }
+
+      if (k == length && c >= least[length] && c <= 0x10FFFF && (c < 0xD800 || c >= 0xE000))
+      {
+        at += length;
+        return c;
+      }
+    }
+
+    valid = false;
+    at++;
+    return replacement;
+  }
+
+  const Decomposition * decomposition(char32_t c)
+  {
+    auto it = std::lower_bound(std::begin(canonical_decompositions), std::end(canonical_decompositions), c,
+        [](const Decomposition & d, char32_t c) { return d.composite < c; });
+
+    return it != std::end(canonical_decompositions) && it->composite == c ? it : nullptr;
+  }
+
+  /**
+   *  Appends the full canonical decomposition of the code point.
+   */
+  void decompose(char32_t c, std::u32string & out)
+  {
+    if (c - hangul_s < hangul_s_count)
+    {
+      char32_t s = c - hangul_s;
+      out.push_back(hangul_l + s / hangul_n_count);
+      out.push_back(hangul_v + s % hangul_n_count / hangul_t_count);
+      if (s % hangul_t_count) out.push_back(hangul_t + s % hangul_t_count);
+      return;
+    }
+
+    const Decomposition * d = c < 0xC0 ? nullptr : decomposition(c);
+    if (! d)
+    {
+      out.push_back(c);
+      return;
+    }
+
+    decompose(d->first, out);
+    if (d->second) decompose(d->second, out);
+  }
+
+  bool extends(char32_t c)
+  {
+    return c >= 0x300 && find<PropertyRange>(grapheme_extenders, c);
+  }
+
+  char32_t map(std::span<const CaseRange> table, char32_t c)
+  {
+    if (c < 0x80)
+    {
+      char32_t first = table.data() == case_folding ? 'A' : 'a';
+      return c - first < 26 ? c ^ 0x20 : c;
+    }
+
+    const CaseRange * range = find(table, c);
+    return range && (c - range->first) % range->stride == 0 ? c + range->delta : c;
+  }
+
+  /**
+   *  Sorts every run of combining marks by combining class, keeping marks of the same class in order.
+   */
+  void order(std::u32string & points)
+  {
+    for (size_t i = 0; i < points.size(); )
+    {
+      size_t j = i;
+      while (j < points.size() && combining_class(points[j]) != 0) j++;
+
+      if (j - i > 1)
+      {
+        std::stable_sort(points.begin() + i, points.begin() + j, [](char32_t x, char32_t y)
+        {
+          return combining_class(x) < combining_class(y);
+        });
+      }
+
+      i = std::max(j, i + 1);
+    }
+  }
+
+  bool regional_indicator(char32_t c)
+  {
+    return c >= 0x1F1E6 && c <= 0x1F1FF;
+  }
+
+  /**
+   *  Writes the text into out in the given case, and in NFC.
+   */
+  void transform(std::string_view text, std::string & out, Case mapping)
+  {
+    out.resize(text.size());
+    if (ascii_case(text, out.data(), mapping))
+    {
+      return;
+    }
+
+    if (! utf8_valid(text))
+    {
+      const unsigned char first = mapping == Case::FOLD ? 'A' : 'a';
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        unsigned char c = text[i];
+        out[i] = (unsigned) (c - first) < 26 ? c ^ 0x20 : c;
+      }
+
+      return;
+    }
+
+    // The code points are worked on in buffers kept per thread, so that this does not allocate once they have
+    // grown to the longest word.
+
+    thread_local std::u32string t_points {};
+    thread_local std::u32string t_decomposed {};
+
+    std::span<const CaseRange> table = mapping == Case::FOLD ? std::span<const CaseRange> {case_folding} : std::span<const CaseRange> {uppercase};
+    std::u32string & points = t_points;
+    char32_t highest = 0;
+
+    points.clear();
+
+    for (size_t at = 0; at < text.size(); )
+    {
+      points.push_back(utf8_decode(text, at));
+      highest = std::max(highest, points.back());
+    }
+
+    // Latin-1 text is in NFC, and its letters map to ones that are, so it is mapped as it is. Other text is
+    // decomposed first, so that letters whose case needs more than one code point (like 'İ', which folds to 'i'
+    // and a dot above) map through their base letter, and composed again afterwards.
+
+    bool normalize = highest >= 0x100;
+    if (normalize)
+    {
+      t_decomposed.clear();
+      for (char32_t c : points)
+      {
+        decompose(c, t_decomposed);
+      }
+
+      std::swap(points, t_decomposed);
+      order(points);
+    }
+
+    for (char32_t & c : points)
+    {
+      c = map(table, c);
+    }
+
+    if (normalize)
+    {
+      order(points);
+      compose(points);
+    }
+
+    out.clear();
+    out.reserve(text.size() + 8);
+
+    for (char32_t c : points)
+    {
+      utf8_encode(c, out);
+    }
+  }
+}
+
+bool utf8_ascii(std::string_view text)
+{
+  size_t i = 0;
+
+#ifdef __SSE2__
+  __m128i any = _mm_setzero_si128();
+  for (; i + 16 <= text.size(); i += 16)
+  {
+    any = _mm_or_si128(any, _mm_loadu_si128((const __m128i *) (text.data() + i)));
+  }
+
+  if (_mm_movemask_epi8(any))
+  {
+    return false;
+  }
+#endif
+
+  for (; i + 8 <= text.size(); i += 8)
+  {
+    uint64_t bytes;
+    std::memcpy(&bytes, text.data() + i, 8);
+    if (bytes & 0x8080808080808080ull) return false;
+  }
+
+  for (; i < text.size(); i++)
+  {
+    if ((unsigned char) text[i] >= 0x80) return false;
+  }
+
+  return true;
+}
+
+char32_t utf8_base(char32_t c)
+{
+  if (c - hangul_s < hangul_s_count)
+  {
+    return hangul_l + (c - hangul_s) / hangul_n_count;
+  }
+
+  for (const Decomposition * d; c >= 0xC0 && (d = decomposition(c)); )
+  {
+    c = d->first;
+  }
+
+  return map(case_folding, c);
+}
+
+size_t utf8_cluster(std::string_view text, size_t at)
+{
+  char32_t c = utf8_decode(text, at);
+
+  // Nothing extends a control character, nor an ASCII character followed by another.
+
+  if (c < 0x20 || c == 0x7F || (c < 0x80 && (at == text.size() || (unsigned char) text[at] < 0x80)))
+  {
+    return at;
+  }
+
+  bool flag = regional_indicator(c);
+
+  while (at < text.size())
+  {
+    size_t next = at;
+    char32_t d = utf8_decode(text, next);
+
+    if (! extends(d) && ! (c == zero_width_joiner && d >= 0x20) && ! (flag && regional_indicator(d)))
+    {
+      break;
+    }
+
+    flag = false;
+    c = d;
+    at = next;
+  }
+
+  return at;
+}
+
+size_t utf8_clusters(std::string_view text)
+{
+  if (utf8_ascii(text))
+  {
+    return text.size();
+  }
+
+  size_t clusters = 0;
+  for (size_t at = 0; at < text.size(); at = utf8_cluster(text, at))
+  {
+    clusters++;
+  }
+
+  return clusters;
+}
+
+char32_t utf8_decode(std::string_view text, size_t & at)
+{
+  bool valid;
+  return decode(text, at, valid);
+}
+
+void utf8_encode(char32_t c, std::string & out)
+{
+  if (c < 0x80)
+  {
+    out.push_back(c);
+  }
+  else if (c < 0x800)
+  {
+    out.push_back(0xC0 | c >> 6);
+    out.push_back(0x80 | (c & 0x3F));
+  }
+  else if (c < 0x10000)
+  {
+    out.push_back(0xE0 | c >> 12);
+    out.push_back(0x80 | (c >> 6 & 0x3F));
+    out.push_back(0x80 | (c & 0x3F));
+  }
+  else
+  {
+    out.push_back(0xF0 | c >> 18);
+    out.push_back(0x80 | (c >> 12 & 0x3F));
+    out.push_back(0x80 | (c >> 6 & 0x3F));
+    out.push_back(0x80 | (c & 0x3F));
+  }
+}
+
+void utf8_fold(std::string_view text, std::string & out)
+{
+  transform(text, out, Case::FOLD);
+}
+
+std::string utf8_fold(std::string_view text)
+{
+  std::string out {};
+  transform(text, out, Case::FOLD);
+  return out;
+}
+
+bool utf8_space(char32_t c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r') || c == 0x85 || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A)
+    || c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+void utf8_upper(std::string_view text, std::string & out)
+{
+  transform(text, out, Case::UPPER);
+}
+
+std::string utf8_upper(std::string_view text)
+{
+  std::string out {};
+  transform(text, out, Case::UPPER);
+  return out;
+}
+
+bool utf8_valid(std::string_view text)
+{
+  size_t at = 0;
+
+  while (at < text.size())
+  {
+#ifdef __SSE2__
+    // Runs of ASCII are skipped a block at a time, and only the sequences in between are decoded.
+
+    while (at + 16 <= text.size() && ! _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (text.data() + at))))
+    {
+      at += 16;
+    }
+
+    if (at == text.size())
+    {
+      break;
+    }
+#endif
+
+    bool valid;
+    decode(text, at, valid);
+
+    if (! valid)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,87 @@
+
+#ifndef PQ_UTF8_H_
+#define PQ_UTF8_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ *  UTF-8 text: validation, decoding, case mapping, normalization and grapheme clusters.
+ *
+ *  Words are usually ASCII, so every function first runs through the text 16 bytes at a time (with SSE2, where
+ *  available) and finishes there if no byte has its high bit set. Only then is the text decoded and mapped with
+ *  the tables in UnicodeTables.h: case mapping is the simple one (one code point to one code point), and text
+ *  is brought to NFC by decomposing it canonically, ordering combining marks and composing it again. Malformed
+ *  UTF-8 is left as it is, save for mapping the case of its ASCII letters.
+ *
+ *  Grapheme clusters follow the extended rules approximately: a cluster is a code point followed by the marks,
+ *  joiners, emoji modifiers and tags that extend it, together with whatever follows a zero width joiner, or a
+ *  pair of regional indicators (a flag). Every ASCII character is a cluster of its own.
+ */ 
+
+/**
+ *  Determines whether the text is all ASCII.
+ */ 
+bool utf8_ascii (std::string_view text);
+
+/**
+ *  Returns the base letter of the code point: the first code point of its full canonical decomposition, case
+ *  folded. The base letter of 'É' is 'e'.
+ */ 
+char32_t utf8_base (char32_t c);
+
+/**
+ *  Returns the end of the grapheme cluster that starts at the given offset, which must be in the text.
+ */ 
+size_t utf8_cluster (std::string_view text, size_t at);
+
+/**
+ *  Returns the number of grapheme clusters in the text: the number of letters, as a reader would count them.
+ */ 
+size_t utf8_clusters (std::string_view text);
+
+/**
+ *  Decodes the code point at the given offset and advances the offset past it. A malformed sequence decodes as
+ *  U+FFFD and is skipped one byte at a time.
+ */ 
+char32_t utf8_decode (std::string_view text, size_t & at);
+
+/**
+ *  Appends the encoding of the code point.
+ */ 
+void utf8_encode (char32_t c, std::string & out);
+
+/**
+ *  Writes the case folded NFC form of the text into out, reusing its storage.
+ */ 
+void utf8_fold (std::string_view text, std::string & out);
+
+/**
+ *  Returns the case folded NFC form of the text. Words that differ only in case or in how their accents are
+ *  encoded fold the same.
+ */ 
+std::string utf8_fold (std::string_view text);
+
+/**
+ *  Determines whether the code point is Unicode white space.
+ */ 
+bool utf8_space (char32_t c);
+
+/**
+ *  Writes the uppercase NFC form of the text into out, reusing its storage.
+ */ 
+void utf8_upper (std::string_view text, std::string & out);
+
+/**
+ *  Returns the uppercase NFC form of the text.
+ */ 
+std::string utf8_upper (std::string_view text);
+
+/**
+ *  Determines whether the text is well-formed UTF-8: no stray or missing continuation bytes, no overlong
+ *  encodings, no surrogates and nothing beyond U+10FFFF.
+ */ 
+bool utf8_valid (std::string_view text);
+
+#endif
@@ -0,0 +1,435 @@
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "Dictionary.h"
+#include "Logging.h"
+#include "String.h"
+#include "Watchdog.h"
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   *  Returns the histogram bucket of a latency: exact below 16 ns, then four buckets per power of two.
+   */
+  size_t bucket(uint64_t ns)
+  {
+    if (ns < 16) return ns;
+
+    size_t e = std::bit_width(ns) - 1;
+    return 16 + (e - 4) * 4 + ((ns >> (e - 2)) & 3);
+  }
+
+  /**
+   *  Returns the latency in the middle of a histogram bucket, in seconds.
+   */
+  double bucket_seconds(size_t b)
+  {
+    if (b < 16) return b * 1e-9;
+
+    size_t e = (b - 16) / 4 + 4;
+    uint64_t low = (uint64_t) (4 + (b - 16) % 4) << (e - 2);
+    return (low + (uint64_t {1} << (e - 3))) * 1e-9;
+  }
+
+  std::string format_seconds(double seconds)
+  {
+    std::ostringstream out {};
+    out << std::fixed << std::setprecision(1);
+
+    if (seconds < 1e-3) out << seconds * 1e6 << " us";
+    else if (seconds < 1) out << seconds * 1e3 << " ms";
+    else out << std::setprecision(2) << seconds << " s";
+
+    return out.str();
+  }
+
+  uint64_t since(Clock::time_point start)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+}
+
+/**
+ *  The latencies and strikes of one rule. Updated from any thread, including runners that were abandoned. The
+ *  histogram holds the calls that were timed, which in bulk passes are a sample of them.
+ */
+struct Watchdog::Record
+{
+  std::string                             name;
+  std::atomic<uint64_t>                   calls       {0};
+  std::array<std::atomic<uint64_t>, 256>  histogram   {};
+  std::atomic<uint64_t>                   max         {0};
+  std::atomic<uint64_t>                   overruns    {0};
+  std::atomic<uint64_t>                   strikes     {0};
+  std::atomic<bool>                       quarantined {false};
+
+  void add(size_t b, uint64_t count)
+  {
+    histogram[b].fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void add_max(uint64_t ns)
+  {
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (ns > seen && ! max.compare_exchange_weak(seen, ns, std::memory_order_relaxed));
+  }
+};
+
+/**
+ *  A thread that runs one evaluation at a time for evaluate. A runner whose call overran is retired, and its
+ *  thread exits once the call is over.
+ */
+struct Watchdog::Runner
+{
+  std::mutex              mutex;
+  std::condition_variable cv;
+  std::function<void()>   job;
+  bool                    done    {false};
+  bool                    retired {false};
+
+  static void serve(std::shared_ptr<Runner> runner)
+  {
+    std::unique_lock lock {runner->mutex};
+
+    while (true)
+    {
+      runner->cv.wait(lock, [&]() { return runner->job || runner->retired; });
+      if (! runner->job) return;
+
+      std::function<void()> job = std::move(runner->job);
+      runner->job = nullptr;
+
+      lock.unlock();
+      job();
+      lock.lock();
+
+      runner->done = true;
+      runner->cv.notify_all();
+      if (runner->retired) return;
+    }
+  }
+};
+
+Watchdog::Meter::Meter(Watchdog & watchdog, const Rule & rule)
+  : m_watchdog {watchdog}
+  , m_rule {rule}
+  , m_record {* watchdog.record(rule)}
+{}
+
+Watchdog::Meter::~Meter()
+{
+  m_record.calls.fetch_add(m_calls, std::memory_order_relaxed);
+
+  for (size_t b = 0; b < m_histogram.size(); b++)
+  {
+    if (m_histogram[b]) m_record.add(b, m_histogram[b]);
+  }
+}
+
+Verdict Watchdog::Meter::evaluate(const std::string & word, const History & history)
+{
+  if (m_calls++ % 16 != 0)
+  {
+    return m_rule.evaluate(word, history);
+  }
+
+  int64_t budget = m_watchdog.m_budget.load(std::memory_order_relaxed) * 1000;
+  Clock::time_point start = Clock::now();
+
+  // The clock read that starts this run of calls also ends the previous one.
+  if (m_calls > 1 && budget > 0 && start - m_run > std::chrono::nanoseconds {budget})
+  {
+    m_watchdog.strike(m_record);
+  }
+  m_run = start;
+
+  Verdict verdict = m_rule.evaluate(word, history);
+  uint64_t ns = since(start);
+
+  m_histogram[bucket(ns)]++;
+  if (ns > m_record.max.load(std::memory_order_relaxed)) m_record.add_max(ns);
+
+  return verdict;
+}
+
+bool Watchdog::Meter::quarantined() const
+{
+  return m_watchdog.m_budget.load(std::memory_order_relaxed) > 0 && m_record.quarantined.load();
+}
+
+Watchdog & Watchdog::instance()
+{
+  static Watchdog instance_ {};
+  return instance_;
+}
+
+Watchdog::~Watchdog()
+{
+  for (std::shared_ptr<Runner> & runner : m_idle)
+  {
+    std::lock_guard lock {runner->mutex};
+    runner->retired = true;
+    runner->cv.notify_all();
+  }
+}
+
+std::chrono::microseconds Watchdog::budget() const
+{
+  return std::chrono::microseconds {m_budget.load()};
+}
+
+void Watchdog::budget(std::chrono::microseconds budget)
+{
+  m_budget = std::max<int64_t>(0, budget.count());
+}
+
+std::optional<Verdict> Watchdog::evaluate(const Rule & rule, const std::string & word, const History & history)
+{
+  int64_t budget = m_budget.load();
+  if (budget <= 0)
+  {
+    return meter(rule).evaluate(word, history);
+  }
+
+  std::shared_ptr<Record> record = this->record(rule);
+
+  // The job owns everything it reads but the rule, which outlives it, so an abandoned runner never touches the
+  // caller's memory, nor the watchdog's once it is gone. Features in scope for the word are carried over to the
+  // runner.
+
+  struct Slot
+  {
+    Verdict               verdict;
+    std::exception_ptr    error;
+    std::atomic<uint32_t> waits {0};
+  };
+
+  auto slot = std::make_shared<Slot>();
+  const Features * scoped = Features::find(word);
+  std::optional<Features> features = scoped ? std::optional<Features> {* scoped} : std::nullopt;
+
+  std::function<void()> job = [slot, &rule, record, word, history, features]()
+  {
+    // The runner pins a dictionary of its own rather than adopting the caller's, since it may outlive the
+    // caller's pin if it is abandoned. Should a reload come between, the rule sees the new dictionary.
+
+    Dictionary::Pin pin {};
+    Dictionary::Waits waits {slot->waits};
+    Clock::time_point start = Clock::now();
+
+    try
+    {
+      if (features)
+      {
+        Features::Scope scope {* features};
+        slot->verdict = rule.evaluate(features->word, history);
+      }
+      else
+      {
+        slot->verdict = rule.evaluate(word, history);
+      }
+    }
+    catch (...)
+    {
+      slot->error = std::current_exception();
+    }
+
+    // A call that waited for the dictionary says nothing of how fast the rule is, so only its count is kept.
+
+    uint64_t ns = since(start);
+    record->calls++;
+    if (slot->waits.load() == 0)
+    {
+      record->add(bucket(ns), 1);
+      record->add_max(ns);
+    }
+  };
+
+  std::shared_ptr<Runner> runner {};
+  {
+    std::lock_guard lock {m_mutex};
+    if (! m_idle.empty())
+    {
+      runner = std::move(m_idle.back());
+      m_idle.pop_back();
+    }
+  }
+
+  if (! runner)
+  {
+    runner = std::make_shared<Runner>();
+    std::thread {Runner::serve, runner}.detach();
+  }
+
+  Clock::time_point deadline = Clock::now() + std::chrono::microseconds {budget};
+  {
+    std::unique_lock lock {runner->mutex};
+    runner->job = std::move(job);
+    runner->done = false;
+    runner->cv.notify_all();
+
+    // Time the runner spends waiting for the dictionary to load or an index to be built is not the rule's:
+    // while it waits, and once after any wait, the rule is given its whole budget again.
+
+    uint32_t seen = 0;
+    while (! runner->cv.wait_until(lock, deadline, [&]() { return runner->done; }))
+    {
+      uint32_t waits = slot->waits.load();
+      if (waits % 2 == 0 && waits == seen)
+      {
+        runner->retired = true;
+        lock.unlock();
+        strike(* record);
+        return std::nullopt;
+      }
+
+      seen = waits;
+      deadline = Clock::now() + std::chrono::microseconds {budget};
+    }
+  }
+
+  {
+    std::lock_guard lock {m_mutex};
+    m_idle.push_back(std::move(runner));
+  }
+
+  if (slot->error)
+  {
+    std::rethrow_exception(slot->error);
+  }
+
+  return std::move(slot->verdict);
+}
+
+std::ostream & Watchdog::format(std::ostream & out) const
+{
+  std::vector<Stats> all = stats();
+  if (all.empty())
+  {
+    return out << "No rule has been evaluated yet.\n";
+  }
+
+  size_t width = 4;
+  for (const Stats & s : all)
+  {
+    width = std::max(width, s.name.size());
+  }
+
+  out
+    << std::left << std::setw(width) << "rule" << std::right
+    << std::setw(12) << "calls" << std::setw(12) << "p50" << std::setw(12) << "p99"
+    << std::setw(12) << "max" << std::setw(10) << "overruns" << "\n";
+
+  for (const Stats & s : all)
+  {
+    out
+      << std::left << std::setw(width) << s.name << std::right
+      << std::setw(12) << s.calls << std::setw(12) << format_seconds(s.p50) << std::setw(12) << format_seconds(s.p99)
+      << std::setw(12) << format_seconds(s.max) << std::setw(10) << s.overruns
+      << (s.quarantined ? "  quarantined" : "") << "\n";
+  }
+
+  return out;
+}
+
+Watchdog::Meter Watchdog::meter(const Rule & rule)
+{
+  return Meter {* this, rule};
+}
+
+bool Watchdog::quarantined(const Rule & rule)
+{
+  return m_budget.load() > 0 && record(rule)->quarantined.load();
+}
+
+std::shared_ptr<Watchdog::Record> Watchdog::record(const Rule & rule)
+{
+  std::lock_guard lock {m_mutex};
+  std::shared_ptr<Record> & record = m_records[&rule];
+
+  if (! record)
+  {
+    record = std::make_shared<Record>();
+    record->name = rule.name();
+  }
+
+  return record;
+}
+
+void Watchdog::release(const Rule & rule)
+{
+  std::shared_ptr<Record> record = this->record(rule);
+  record->strikes = 0;
+  record->quarantined = false;
+}
+
+std::vector<Watchdog::Stats> Watchdog::stats() const
+{
+  std::vector<Stats> all {};
+  std::lock_guard lock {m_mutex};
+
+  for (auto & [rule, record] : m_records)
+  {
+    Stats s {record->name};
+    s.calls = record->calls;
+    s.overruns = record->overruns;
+    s.quarantined = m_budget.load() > 0 && record->quarantined;
+    s.max = record->max * 1e-9;
+
+    std::array<uint64_t, 256> counts {};
+    uint64_t timed = 0;
+    for (size_t b = 0; b < counts.size(); b++)
+    {
+      counts[b] = record->histogram[b].load(std::memory_order_relaxed);
+      timed += counts[b];
+    }
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); b++)
+    {
+      seen += counts[b];
+      if (counts[b] && s.p50 == 0 && seen * 2 >= timed) s.p50 = bucket_seconds(b);
+      if (counts[b] && s.p99 == 0 && seen * 100 >= timed * 99) s.p99 = bucket_seconds(b);
+    }
+
+    // Buckets are a quarter of a power of two wide, so their midpoint can lie past the slowest call.
+    s.p50 = std::min(s.p50, s.max);
+    s.p99 = std::min(s.p99, s.max);
+
+    all.push_back(s);
+  }
+
+  std::sort(all.begin(), all.end(), [](const Stats & a, const Stats & b) { return a.p99 > b.p99; });
+  return all;
+}
+
+void Watchdog::strike(Record & record)
+{
+  record.overruns++;
+  size_t strikes = ++record.strikes;
+
+  if (strikes >= m_strikes.load() && ! record.quarantined.exchange(true))
+  {
+    U_LOGW(
+        "Quarantined rule '", record.name, "' after ", strikes, strikes == 1 ? " call" : " calls", " over the ",
+        format_seconds(m_budget.load() * 1e-6), " budget; use `release ", record.name, "` to let it back in.");
+  }
+}
+
+size_t Watchdog::strikes() const
+{
+  return m_strikes.load();
+}
+
+void Watchdog::strikes(size_t strikes)
+{
+  m_strikes = std::max<size_t>(1, strikes);
+}
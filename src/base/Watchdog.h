@@ -0,0 +1,178 @@
+
+#ifndef PQ_WATCHDOG_H_
+#define PQ_WATCHDOG_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "History.h"
+#include "Rule.h"
+
+/**
+ *  Keeps rule evaluations within a time budget, and keeps rules that repeatedly overrun it out of the way.
+ *
+ *  A rule evaluated through evaluate runs on a runner thread while the caller waits for at most the budget. If
+ *  the budget runs out, the caller gets no verdict and moves on; the runner is abandoned, finishes the call on
+ *  its own and exits. A call cannot be stopped midway, but the caller is never held up for longer than the
+ *  budget. Bulk passes time their calls in place with a Meter instead: one call in sixteen is timed on its own,
+ *  and each run of sixteen calls is held to the budget as a whole, which costs two clock reads per run.
+ *
+ *  Every call's latency goes into a histogram for its rule. A call that overruns the budget is a strike
+ *  against the rule, and a rule with enough strikes is quarantined: sweeps and probes leave it out until it is
+ *  released. With the budget set to zero the watchdog is off, so evaluations run inline and nothing is
+ *  quarantined; replays run that way to stay deterministic.
+ */ 
+class Watchdog
+{
+    struct Record;
+
+  public:
+
+    /**
+     *  The latency record of one rule.
+     */ 
+    struct Stats
+    {
+      std::string name;
+      uint64_t    calls       {0};
+      uint64_t    overruns    {0};
+      bool        quarantined {false};
+      double      p50         {0};
+      double      p99         {0};
+      double      max         {0};
+    };
+
+    /**
+     *  Times the calls of one rule on one thread and adds them to the rule's record when destroyed. Overruns
+     *  count as strikes right away.
+     */ 
+    class Meter
+    {
+      public:
+
+        ~Meter();
+
+        Meter(const Meter &) = delete;
+        Meter & operator=(const Meter &) = delete;
+
+        /**
+         *  Evaluates the word on the calling thread and times the call.
+         */ 
+        Verdict evaluate(const std::string & word, const History & history);
+
+        /**
+         *  Determines whether the rule is quarantined, so that a pass over many words can stop early.
+         */ 
+        bool quarantined() const;
+
+      private:
+
+        friend class Watchdog;
+
+        Meter(Watchdog & watchdog, const Rule & rule);
+
+        Watchdog &                            m_watchdog;
+        const Rule &                          m_rule;
+        Record &                              m_record;
+        std::array<uint32_t, 256>             m_histogram {};
+        uint64_t                              m_calls     {0};
+        std::chrono::steady_clock::time_point m_run       {};
+    };
+
+    /**
+     *  Gets the watchdog shared by every session.
+     */ 
+    static Watchdog & instance();
+
+    ~Watchdog();
+
+    Watchdog(const Watchdog &) = delete;
+    Watchdog & operator=(const Watchdog &) = delete;
+
+    /**
+     *  Returns the per-call budget; zero means the watchdog is off.
+     */ 
+    std::chrono::microseconds budget() const;
+
+    /**
+     *  Sets the per-call budget; zero turns the watchdog off.
+     */ 
+    void budget(std::chrono::microseconds budget);
+
+    /**
+     *  Evaluates the word within the budget, returning no verdict if the budget ran out first. Time the rule
+     *  spends waiting for the dictionary to load or for one of its indexes to be built does not count against
+     *  the budget. Exceptions thrown by the rule are rethrown.
+     */ 
+    std::optional<Verdict> evaluate(const Rule & rule, const std::string & word, const History & history);
+
+    /**
+     *  Prints the latency record of every rule evaluated so far, slowest first.
+     */ 
+    std::ostream & format(std::ostream & out) const;
+
+    /**
+     *  Returns a meter for timing calls of the rule on the calling thread.
+     */ 
+    Meter meter(const Rule & rule);
+
+    /**
+     *  Determines whether the rule is quarantined. Nothing is while the watchdog is off.
+     */ 
+    bool quarantined(const Rule & rule);
+
+    /**
+     *  Lifts the rule's quarantine and clears its strikes.
+     */ 
+    void release(const Rule & rule);
+
+    /**
+     *  Returns the latency records of every rule evaluated so far, slowest first.
+     */ 
+    std::vector<Stats> stats() const;
+
+    /**
+     *  Returns the number of overruns after which a rule is quarantined.
+     */ 
+    size_t strikes() const;
+
+    /**
+     *  Sets the number of overruns after which a rule is quarantined.
+     */ 
+    void strikes(size_t strikes);
+
+  private:
+
+    struct Runner;
+
+    Watchdog() = default;
+
+    /**
+     *  Returns the record of the rule, creating it on first use. Records live as long as the watchdog, or as
+     *  any runner still evaluating the rule.
+     */ 
+    std::shared_ptr<Record> record(const Rule & rule);
+
+    /**
+     *  Counts an overrun against the rule, quarantining it once it has enough strikes.
+     */ 
+    void strike(Record & record);
+
+    std::atomic<int64_t>                                   m_budget  {250000}; // microseconds
+    std::atomic<size_t>                                    m_strikes {3};
+
+    mutable std::mutex                                     m_mutex;
+    std::map<const Rule *, std::shared_ptr<Record>>        m_records;
+    std::vector<std::shared_ptr<Runner>>                   m_idle;
+};
+
+#endif
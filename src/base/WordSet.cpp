@@ -0,0 +1,301 @@
+
+#include <algorithm>
+#include <iterator>
+
+#include "WordSet.h"
+
+namespace
+{
+  constexpr size_t container_words = 65536 / 64;
+}
+
+WordSet::WordSet(std::vector<uint32_t> ids)
+{
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  for (size_t i = 0; i < ids.size(); )
+  {
+    Container container {};
+    container.key = ids[i] >> 16;
+
+    for (; i < ids.size() && (ids[i] >> 16) == container.key; i++)
+    {
+      container.array.push_back(ids[i] & 0xffff);
+    }
+
+    container.cardinality = container.array.size();
+    container.normalize();
+    m_containers.push_back(std::move(container));
+  }
+}
+
+Bitmap WordSet::bitmap(size_t size) const
+{
+  Bitmap bitmap {size};
+
+  for (const Container & container : m_containers)
+  {
+    size_t base = size_t {container.key} << 16;
+
+    if (container.bits.empty())
+    {
+      for (uint16_t low : container.array)
+      {
+        bitmap.set(base + low);
+      }
+    }
+    else
+    {
+      for (size_t k = 0; k < container_words && base / 64 + k < bitmap.words(); k++)
+      {
+        bitmap.word(base / 64 + k, container.bits[k]);
+      }
+    }
+  }
+
+  return bitmap;
+}
+
+size_t WordSet::bytes() const
+{
+  size_t bytes = m_containers.capacity() * sizeof(Container);
+
+  for (const Container & container : m_containers)
+  {
+    bytes += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+  }
+
+  return bytes;
+}
+
+WordSet::Container WordSet::combine(const Container & a, const Container & b, Combination combination)
+{
+  Container result {};
+  result.key = a.key;
+
+  if (a.bits.empty() && b.bits.empty())
+  {
+    // Two arrays merge in one pass.
+
+    auto out = std::back_inserter(result.array);
+    switch (combination)
+    {
+      case Combination::UNION:        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out); break;
+      case Combination::INTERSECTION: std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out); break;
+      case Combination::DIFFERENCE:   std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out); break;
+    }
+
+    result.cardinality = result.array.size();
+  }
+  else if (combination != Combination::UNION && (a.bits.empty() || b.bits.empty()))
+  {
+    // An array is filtered through the other side, which is cheaper than expanding it. Intersection commutes,
+    // so the array can be on either side; a difference needs it on the left.
+
+    bool keep = combination == Combination::INTERSECTION;
+    const Container & array = a.bits.empty() ? a : b;
+    const Container & other = a.bits.empty() ? b : a;
+
+    if (combination == Combination::DIFFERENCE && ! a.bits.empty())
+    {
+      result.bits = a.bits;
+      for (uint16_t low : b.array)
+      {
+        result.bits[low / 64] &= ~(uint64_t {1} << (low % 64));
+      }
+
+      result.cardinality = a.cardinality;
+      for (uint16_t low : b.array)
+      {
+        result.cardinality -= a.contains(low);
+      }
+    }
+    else
+    {
+      std::copy_if(array.array.begin(), array.array.end(), std::back_inserter(result.array),
+          [&](uint16_t low) { return other.contains(low) == keep; });
+      result.cardinality = result.array.size();
+    }
+  }
+  else
+  {
+    // Otherwise both are combined as bitmaps, a word at a time.
+
+    std::vector<uint64_t> x = a.words();
+    std::vector<uint64_t> y = b.words();
+
+    for (size_t k = 0; k < container_words; k++)
+    {
+      switch (combination)
+      {
+        case Combination::UNION:        x[k] |= y[k]; break;
+        case Combination::INTERSECTION: x[k] &= y[k]; break;
+        case Combination::DIFFERENCE:   x[k] &= ~y[k]; break;
+      }
+
+      result.cardinality += __builtin_popcountll(x[k]);
+    }
+
+    result.bits = std::move(x);
+  }
+
+  result.normalize();
+  return result;
+}
+
+WordSet & WordSet::combine(const WordSet & other, Combination combination)
+{
+  std::vector<Container> combined {};
+  auto a = m_containers.begin();
+  auto b = other.m_containers.begin();
+
+  while (a != m_containers.end() || b != other.m_containers.end())
+  {
+    bool left = a != m_containers.end() && (b == other.m_containers.end() || a->key < b->key);
+    bool right = b != other.m_containers.end() && (a == m_containers.end() || b->key < a->key);
+
+    if (left)
+    {
+      if (combination != Combination::INTERSECTION) combined.push_back(std::move(* a));
+      ++a;
+    }
+    else if (right)
+    {
+      if (combination == Combination::UNION) combined.push_back(* b);
+      ++b;
+    }
+    else
+    {
+      Container container = combine(* a, * b, combination);
+      if (container.cardinality > 0) combined.push_back(std::move(container));
+      ++a;
+      ++b;
+    }
+  }
+
+  m_containers = std::move(combined);
+  return * this;
+}
+
+bool WordSet::contains(uint32_t id) const
+{
+  uint16_t key = id >> 16;
+  auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+      [](const Container & container, uint16_t key) { return container.key < key; });
+
+  return it != m_containers.end() && it->key == key && it->contains(id & 0xffff);
+}
+
+size_t WordSet::count() const
+{
+  size_t count = 0;
+  for (const Container & container : m_containers)
+  {
+    count += container.cardinality;
+  }
+
+  return count;
+}
+
+bool WordSet::empty() const
+{
+  return m_containers.empty();
+}
+
+std::vector<uint32_t> WordSet::ids() const
+{
+  std::vector<uint32_t> ids {};
+  ids.reserve(count());
+
+  for (const Container & container : m_containers)
+  {
+    uint32_t base = uint32_t {container.key} << 16;
+
+    if (container.bits.empty())
+    {
+      for (uint16_t low : container.array)
+      {
+        ids.push_back(base + low);
+      }
+    }
+    else
+    {
+      for (size_t k = 0; k < container_words; k++)
+      {
+        for (uint64_t bits = container.bits[k]; bits; bits &= bits - 1)
+        {
+          ids.push_back(base + 64 * k + __builtin_ctzll(bits));
+        }
+      }
+    }
+  }
+
+  return ids;
+}
+
+WordSet & WordSet::operator|=(const WordSet & other)
+{
+  return combine(other, Combination::UNION);
+}
+
+WordSet & WordSet::operator&=(const WordSet & other)
+{
+  return combine(other, Combination::INTERSECTION);
+}
+
+WordSet & WordSet::operator-=(const WordSet & other)
+{
+  return combine(other, Combination::DIFFERENCE);
+}
+
+bool WordSet::Container::contains(uint16_t low) const
+{
+  if (bits.empty())
+  {
+    return std::binary_search(array.begin(), array.end(), low);
+  }
+
+  return bits[low / 64] >> (low % 64) & 1;
+}
+
+void WordSet::Container::normalize()
+{
+  if (bits.empty() && cardinality > array_limit)
+  {
+    bits = words();
+    array = std::vector<uint16_t> {};
+  }
+  else if (! bits.empty() && cardinality <= array_limit)
+  {
+    std::vector<uint16_t> values {};
+    values.reserve(cardinality);
+
+    for (size_t k = 0; k < container_words; k++)
+    {
+      for (uint64_t word = bits[k]; word; word &= word - 1)
+      {
+        values.push_back(64 * k + __builtin_ctzll(word));
+      }
+    }
+
+    array = std::move(values);
+    bits = std::vector<uint64_t> {};
+  }
+}
+
+std::vector<uint64_t> WordSet::Container::words() const
+{
+  if (! bits.empty())
+  {
+    return bits;
+  }
+
+  std::vector<uint64_t> words (container_words);
+  for (uint16_t low : array)
+  {
+    words[low / 64] |= uint64_t {1} << (low % 64);
+  }
+
+  return words;
+}
@@ -0,0 +1,127 @@
+
+#ifndef PQ_WORD_SET_H_
+#define PQ_WORD_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Bitmap.h"
+
+/**
+ *  A compressed set of dictionary word ids, laid out like a roaring bitmap.
+ *
+ *  Ids are split by their upper 16 bits into chunks of 65536, and each chunk that holds any id is a container
+ *  of its own: a sorted array of the lower 16 bits while it holds at most 4096 ids, and a 65536-bit bitmap
+ *  beyond that, which is then the smaller of the two. A set of a hundred words thus takes a few hundred bytes,
+ *  while a set of half the dictionary takes no more than a dense bitmap.
+ *
+ *  Membership costs a search among at most a handful of containers and then either one bit test or a binary
+ *  search of at most twelve steps. Union, intersection and difference work container by container: merging
+ *  sorted arrays, filtering an array through a bitmap, or combining bitmaps 64 bits at a time.
+ */ 
+class WordSet
+{
+  public:
+
+    /**
+     *  Constructs the empty set.
+     */ 
+    WordSet() = default;
+
+    /**
+     *  Constructs the set of the given ids, which may come in any order and repeat.
+     */ 
+    explicit WordSet(std::vector<uint32_t> ids);
+
+    /**
+     *  Expands the set into a dense bitmap of the given size, for passes over the whole dictionary. Every id
+     *  must be below the size.
+     */ 
+    Bitmap bitmap(size_t size) const;
+
+    /**
+     *  Returns the number of bytes the containers take.
+     */ 
+    size_t bytes() const;
+
+    /**
+     *  Determines whether the set holds the id.
+     */ 
+    bool contains(uint32_t id) const;
+
+    /**
+     *  Returns the number of ids in the set.
+     */ 
+    size_t count() const;
+
+    /**
+     *  Determines whether the set is empty.
+     */ 
+    bool empty() const;
+
+    /**
+     *  Returns the ids in the set, in increasing order.
+     */ 
+    std::vector<uint32_t> ids() const;
+
+    /**
+     *  Combines the sets: union, intersection, and difference.
+     */ 
+    WordSet & operator|=(const WordSet & other);
+    WordSet & operator&=(const WordSet & other);
+    WordSet & operator-=(const WordSet & other);
+
+    friend WordSet operator|(WordSet a, const WordSet & b) { return a |= b; }
+    friend WordSet operator&(WordSet a, const WordSet & b) { return a &= b; }
+    friend WordSet operator-(WordSet a, const WordSet & b) { return a -= b; }
+
+  private:
+
+    enum class Combination
+    {
+      UNION,
+      INTERSECTION,
+      DIFFERENCE
+    };
+
+    /**
+     *  The ids sharing their upper 16 bits, by their lower 16 bits: a sorted array up to array_limit of them,
+     *  and a bitmap of 1024 words beyond.
+     */ 
+    struct Container
+    {
+      static constexpr size_t array_limit = 4096;
+
+      uint16_t              key         {0};
+      uint32_t              cardinality {0};
+      std::vector<uint16_t> array;
+      std::vector<uint64_t> bits;
+
+      bool contains(uint16_t low) const;
+
+      /**
+       *  Switches to the representation that suits the cardinality.
+       */ 
+      void normalize();
+
+      /**
+       *  Returns the container as a bitmap, whatever its representation.
+       */ 
+      std::vector<uint64_t> words() const;
+    };
+
+    /**
+     *  Combines two containers with the same key.
+     */ 
+    static Container combine(const Container & a, const Container & b, Combination combination);
+
+    /**
+     *  Combines the other set into this one.
+     */ 
+    WordSet & combine(const WordSet & other, Combination combination);
+
+    std::vector<Container> m_containers; // sorted by key, none empty
+};
+
+#endif